@@ -0,0 +1,506 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// one-pass adaptive Huffman coding (FGK) for streams with no code table
+//----------------------------------------------------------------------------
+
+#include "Adaptive.hh"
+#include "StreamCodec.hh"
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+AdaptiveTree::AdaptiveTree(int bits)
+{
+  rescale_bits = bits;
+  reset();
+}
+
+//----------------------------------------------------------------------------
+
+// root with ADAPTIVE_END and ADAPTIVE_ESCAPE under it, each seen once
+
+void AdaptiveTree::reset()
+{
+  int s;
+
+  for (s = 0; s < ADAPTIVE_SYMBOLS; s++)
+    leaf[s] = -1;
+
+  nodes[0].weight = 2;
+  nodes[0].parent = -1;
+  nodes[0].child = 1;
+  nodes[0].is_leaf = false;
+
+  nodes[1].weight = nodes[2].weight = 1;
+  nodes[1].parent = nodes[2].parent = 0;
+  nodes[1].is_leaf = nodes[2].is_leaf = true;
+  nodes[1].child = ADAPTIVE_END;
+  nodes[2].child = ADAPTIVE_ESCAPE;
+  leaf[ADAPTIVE_END] = 1;
+  leaf[ADAPTIVE_ESCAPE] = 2;
+
+  next_free = 3;
+  rebuilds = 0;
+}
+
+//----------------------------------------------------------------------------
+
+// code of symbol s (which must have a leaf), first bit in the highest
+// of len bits.  first children are always odd-numbered
+
+void AdaptiveTree::code(int s, unsigned long long & bits, int & len)
+{
+  int node;
+
+  bits = 0;
+  len = 0;
+  for (node = leaf[s]; node != 0; node = nodes[node].parent) {
+    if ((node & 1) == 0)
+      bits |= 1ULL << len;
+    len++;
+  }
+}
+
+//----------------------------------------------------------------------------
+
+// count one more s, adding its leaf first if it's new
+
+void AdaptiveTree::update(int s)
+{
+  int node, leader;
+
+  if (nodes[0].weight >= (1 << rescale_bits))
+    rebuild();
+  if (leaf[s] < 0)
+    add_symbol(s);
+
+  for (node = leaf[s]; node != -1; node = nodes[node].parent) {
+    nodes[node].weight++;
+    for (leader = node; leader > 0 && nodes[leader - 1].weight < nodes[node].weight; leader--)
+      ;
+    if (leader != node) {
+      swap_nodes(node, leader);
+      node = leader;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+
+// the lightest node is always a leaf: it moves down to be the first child
+// of where it was, and s gets the second child with weight 0
+
+void AdaptiveTree::add_symbol(int s)
+{
+  int lightest;
+
+  lightest = next_free - 1;
+
+  nodes[next_free] = nodes[lightest];
+  nodes[next_free].parent = lightest;
+  leaf[nodes[next_free].child] = next_free;
+
+  nodes[next_free + 1].weight = 0;
+  nodes[next_free + 1].parent = lightest;
+  nodes[next_free + 1].child = s;
+  nodes[next_free + 1].is_leaf = true;
+  leaf[s] = next_free + 1;
+
+  nodes[lightest].child = next_free;
+  nodes[lightest].is_leaf = false;
+
+  next_free += 2;
+}
+
+//----------------------------------------------------------------------------
+
+// nodes i and j trade places, subtrees and all; each keeps the parent of
+// the place it moves to
+
+void AdaptiveTree::swap_nodes(int i, int j)
+{
+  AdaptiveNode temp;
+
+  if (nodes[i].is_leaf)
+    leaf[nodes[i].child] = j;
+  else
+    nodes[nodes[i].child].parent = nodes[nodes[i].child + 1].parent = j;
+
+  if (nodes[j].is_leaf)
+    leaf[nodes[j].child] = i;
+  else
+    nodes[nodes[j].child].parent = nodes[nodes[j].child + 1].parent = i;
+
+  temp = nodes[i];
+  nodes[i] = nodes[j];
+  nodes[i].parent = temp.parent;
+  temp.parent = nodes[j].parent;
+  nodes[j] = temp;
+}
+
+//----------------------------------------------------------------------------
+
+// halve every leaf's weight (rounding up, so none drops to 0) and build
+// the tree again: leaves packed at the end in their order, which is by
+// weight already, then each pair from the end gets a parent, which is
+// slotted in ahead of the lighter nodes not yet paired
+
+void AdaptiveTree::rebuild()
+{
+  int i, j, k, weight;
+
+  j = next_free - 1;
+  for (i = j; i >= 0; i--)
+    if (nodes[i].is_leaf) {
+      nodes[j] = nodes[i];
+      nodes[j].weight = (nodes[j].weight + 1) / 2;
+      j--;
+    }
+
+  for (i = next_free - 2; j >= 0; i -= 2, j--) {
+    weight = nodes[i].weight + nodes[i + 1].weight;
+    for (k = j + 1; weight < nodes[k].weight; k++)
+      ;
+    k--;
+    memmove(&nodes[j], &nodes[j + 1], (k - j) * sizeof(AdaptiveNode));
+    nodes[k].weight = weight;
+    nodes[k].child = i;
+    nodes[k].is_leaf = false;
+  }
+
+  for (i = next_free - 1; i >= 0; i--)
+    if (nodes[i].is_leaf)
+      leaf[nodes[i].child] = i;
+    else
+      nodes[nodes[i].child].parent = nodes[nodes[i].child + 1].parent = i;
+  nodes[0].parent = -1;
+
+  rebuilds++;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+AdaptiveEncoder::AdaptiveEncoder(ostream & out, int rescale_bits) : tree(rescale_bits), outStream(out), bits(pending)
+{
+  started = finished = false;
+  bytes_in = bytes_out = 0;
+  flushed_bits = 0;
+}
+
+//----------------------------------------------------------------------------
+
+// an encoder that goes out of scope still leaves a complete stream behind
+
+AdaptiveEncoder::~AdaptiveEncoder()
+{
+  finish();
+}
+
+//----------------------------------------------------------------------------
+
+// a symbol the tree hasn't seen goes out as ESCAPE and its 8 bits
+
+void AdaptiveEncoder::put_symbol(int s)
+{
+  unsigned long long code;
+  int len;
+
+  if (!tree.has(s)) {
+    tree.code(ADAPTIVE_ESCAPE, code, len);
+    code = (code << 8) | s;
+    len += 8;
+  }
+  else
+    tree.code(s, code, len);
+
+  if (len > 32) {
+    bits.put((unsigned int) (code >> 32), len - 32);
+    len = 32;
+  }
+  bits.put((unsigned int) code, len);
+
+  tree.update(s);
+}
+
+//----------------------------------------------------------------------------
+
+bool AdaptiveEncoder::write_output()
+{
+  if (!started) {
+    started = true;
+    outStream.put((char) ADAPTIVE_MAGIC);
+    outStream.put((char) tree.rescale_bits);
+    bytes_out += 2;
+  }
+
+  outStream.write(pending.data(), pending.length());
+  bytes_out += pending.length();
+  pending.clear();
+
+  return !outStream.fail();
+}
+
+//----------------------------------------------------------------------------
+
+bool AdaptiveEncoder::write(const char *data, size_t n)
+{
+  size_t i;
+
+  if (finished)
+    return false;
+
+  for (i = 0; i < n; i++)
+    if (!H.is_bad_ascii_code((int) data[i]))
+      put_symbol((unsigned char) data[i]);
+  bytes_in += n;
+
+  if (pending.length() >= ADAPTIVE_OUTPUT_BYTES)
+    return write_output();
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// code ADAPTIVE_FLUSH and pad to a byte boundary, unless nothing's been
+// coded since the last time, and push everything out
+
+bool AdaptiveEncoder::flush()
+{
+  if (finished)
+    return true;
+
+  if (bits.total_bits > flushed_bits) {
+    put_symbol(ADAPTIVE_FLUSH);
+    bits.flush();
+    flushed_bits = bits.total_bits;
+  }
+  if (!write_output())
+    return false;
+
+  outStream.flush();
+  return !outStream.fail();
+}
+
+//----------------------------------------------------------------------------
+
+bool AdaptiveEncoder::finish()
+{
+  if (finished)
+    return true;
+
+  put_symbol(ADAPTIVE_END);
+  bits.flush();
+  finished = true;
+  if (!write_output())
+    return false;
+
+  outStream.flush();
+  return !outStream.fail();
+}
+
+//----------------------------------------------------------------------------
+
+// compress everything from inStream, then finish the stream.  whatever is
+// already waiting in inStream is taken at once, and the output flushed
+// whenever there's nothing more
+
+bool AdaptiveEncoder::copy_from(istream & inStream)
+{
+  char buffer[STREAM_COPY_BUFFER_SIZE];
+  streamsize n;
+
+  while (inStream.peek() != EOF) {
+    n = inStream.readsome(buffer, STREAM_COPY_BUFFER_SIZE);
+    if (n <= 0) {
+      buffer[0] = inStream.get();
+      n = 1;
+    }
+    if (!write(buffer, n))
+      return false;
+    if (inStream.rdbuf()->in_avail() <= 0 && !flush())
+      return false;
+  }
+
+  return finish();
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+AdaptiveDecoder::AdaptiveDecoder(istream & in) : inStream(in)
+{
+  started = done = error = false;
+  bytes_in = bytes_out = 0;
+  byte = bits_left = 0;
+}
+
+//----------------------------------------------------------------------------
+
+bool AdaptiveDecoder::fail(string message)
+{
+  cerr << "adaptive decompression error: " << message << endl;   // stdout may be the data
+  this->message = message;
+  error = true;
+  done = true;
+
+  return false;
+}
+
+//----------------------------------------------------------------------------
+
+// -1 at the end of the input
+
+int AdaptiveDecoder::next_bit()
+{
+  int c;
+
+  if (bits_left == 0) {
+    if ((c = inStream.get()) == EOF)
+      return -1;
+    byte = c;
+    bits_left = 8;
+    bytes_in++;
+  }
+
+  return (byte >> --bits_left) & 1;
+}
+
+//----------------------------------------------------------------------------
+
+// walk down to a leaf, read an escaped symbol's 8 bits, and count it just
+// as the encoder did.  -1 on error
+
+int AdaptiveDecoder::next_symbol()
+{
+  int node, bit, s, i;
+
+  for (node = 0; !tree.is_leaf(node); node = tree.child(node, bit))
+    if ((bit = next_bit()) < 0) {
+      fail("stream ends without end marker");
+      return -1;
+    }
+
+  s = tree.symbol(node);
+  if (s == ADAPTIVE_ESCAPE) {
+    for (s = i = 0; i < 8; i++) {
+      if ((bit = next_bit()) < 0) {
+        fail("stream ends without end marker");
+        return -1;
+      }
+      s = (s << 1) | bit;
+    }
+    if (s >= ADAPTIVE_SYMBOLS || tree.has(s)) {
+      fail("bad escaped symbol");
+      return -1;
+    }
+  }
+
+  tree.update(s);
+  return s;
+}
+
+//----------------------------------------------------------------------------
+
+// next decoded char, ADAPTIVE_FLUSH where the encoder flushed, or -1 at
+// the end of the stream (or on error)
+
+int AdaptiveDecoder::next_char()
+{
+  int s, bits;
+
+  if (done)
+    return -1;
+
+  if (!started) {
+    if (inStream.get() != ADAPTIVE_MAGIC) {
+      fail("not an adaptive stream");
+      return -1;
+    }
+    bits = inStream.get();
+    if (bits < ADAPTIVE_MIN_RESCALE_BITS || bits > ADAPTIVE_MAX_RESCALE_BITS) {
+      fail("bad rescale bits");
+      return -1;
+    }
+    tree.rescale_bits = bits;
+    bytes_in += 2;
+    started = true;
+  }
+
+  s = next_symbol();
+  if (s == ADAPTIVE_FLUSH)
+    bits_left = 0;
+  else if (s == ADAPTIVE_END) {
+    done = true;
+    return -1;
+  }
+  else if (s >= 0)
+    bytes_out++;
+
+  return s;
+}
+
+//----------------------------------------------------------------------------
+
+// next decoded char, or -1 at the end of the stream (or on error)
+
+int AdaptiveDecoder::get()
+{
+  int c;
+
+  while ((c = next_char()) == ADAPTIVE_FLUSH)
+    ;
+
+  return c;
+}
+
+//----------------------------------------------------------------------------
+
+// decoded chars go out in STREAM_COPY_BUFFER_SIZE pieces, and at once
+// wherever the encoder flushed, before waiting on more input.  there's no
+// checksum, so the end marker has to be the end of the input too: damage
+// that decodes to an early end marker is caught that way
+
+bool AdaptiveDecoder::copy_to(ostream & outStream)
+{
+  string buffer;
+  int c;
+
+  buffer.reserve(STREAM_COPY_BUFFER_SIZE);
+
+  while (!outStream.fail() && (c = next_char()) >= 0) {
+    if (c == ADAPTIVE_FLUSH) {
+      outStream.write(buffer.data(), buffer.length());
+      outStream.flush();
+      buffer.clear();
+      continue;
+    }
+    buffer += (char) c;
+    if (buffer.length() == STREAM_COPY_BUFFER_SIZE) {
+      outStream.write(buffer.data(), buffer.length());
+      buffer.clear();
+    }
+  }
+
+  outStream.write(buffer.data(), buffer.length());
+  outStream.flush();
+
+  if (!error && !outStream.fail() && inStream.peek() != EOF)
+    fail("data after end marker");
+
+  return !error && !outStream.fail();
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// does this input start with ADAPTIVE_MAGIC?  doesn't consume anything
+
+bool is_adaptive_format(istream & inStream)
+{
+  return inStream.peek() == ADAPTIVE_MAGIC;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,160 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// one-pass adaptive Huffman coding (FGK) for streams with no code table
+//----------------------------------------------------------------------------
+
+#ifndef ADAPTIVE_HH
+#define ADAPTIVE_HH
+
+#include "Huffman.hh"
+#include "BitIO.hh"
+
+//----------------------------------------------------------------------------
+
+#define ADAPTIVE_MAGIC                 0xF1    // neither an old-style table size nor STREAM_MAGIC[0]
+#define ADAPTIVE_END                   NUM_ASCII          // end of stream
+#define ADAPTIVE_FLUSH                 (NUM_ASCII + 1)    // the rest of this byte is padding
+#define ADAPTIVE_ESCAPE                (NUM_ASCII + 2)    // 8 bits of a symbol not seen yet follow
+#define ADAPTIVE_SYMBOLS               (NUM_ASCII + 3)
+#define ADAPTIVE_MAX_NODES             (2 * ADAPTIVE_SYMBOLS - 1)
+#define ADAPTIVE_MIN_RESCALE_BITS      8
+#define ADAPTIVE_MAX_RESCALE_BITS      24
+#define DEFAULT_ADAPTIVE_RESCALE_BITS  16
+#define ADAPTIVE_OUTPUT_BYTES          (64 * 1024)   // the encoder writes once this much is waiting
+
+//----------------------------------------------------------------------------
+
+// compress() needs two passes, one to count and one to code, and a code
+// table up front; neither works on a live stream.  here encoder and
+// decoder both start from the same tiny tree and update it the same way
+// after every symbol, so the codes follow the counts so far and nothing
+// but the coded symbols is ever sent.
+//
+// the tree keeps the sibling property (Gallager): numbered from the root
+// down, weights never increase, and the two children of a node are
+// always numbered child, child + 1.  counting a symbol walks from its
+// leaf to the root adding 1, first swapping each node with the
+// lowest-numbered node of its old weight so the order still holds (FGK).
+// nodes are plain structs in one array, so a swap is a struct copy plus
+// fixing four links, and the codes are read off the node numbers: the
+// second child is 1, the first 0.
+//
+// the tree starts with just ADAPTIVE_END and ADAPTIVE_ESCAPE.  a symbol
+// seen for the first time is sent as ESCAPE and its 8 bits, and then
+// gets a leaf of its own, split off the lightest leaf.
+//
+// once the root's weight reaches 2^rescale_bits every weight is halved
+// and the tree rebuilt from them.  that bounds the weights, so codes are
+// at most about 1.44 * rescale_bits long and every update is bounded too,
+// and lets the codes follow text whose statistics drift.  fewer bits
+// adapt faster, more get closer to a static table on steady text
+
+class AdaptiveNode
+{
+public:
+  int weight;
+  int parent;                // -1 for the root
+  int child;                 // first child, or the symbol of a leaf
+  bool is_leaf;
+};
+
+class AdaptiveTree
+{
+public:
+
+  AdaptiveTree(int = DEFAULT_ADAPTIVE_RESCALE_BITS);
+  void reset();
+  bool has(int s) { return leaf[s] >= 0; }
+  void code(int, unsigned long long &, int &);
+  void update(int);
+
+  // walking down, for the decoder.  the root is node 0
+
+  bool is_leaf(int node) { return nodes[node].is_leaf; }
+  int child(int node, int bit) { return nodes[node].child + bit; }
+  int symbol(int node) { return nodes[node].child; }
+
+  int rescale_bits;
+  int rebuilds;              // times the weights have been halved
+
+private:
+
+  void add_symbol(int);
+  void swap_nodes(int, int);
+  void rebuild();
+
+  AdaptiveNode nodes[ADAPTIVE_MAX_NODES];
+  int leaf[ADAPTIVE_SYMBOLS];    // node of each symbol, -1 if not seen yet
+  int next_free;
+};
+
+//----------------------------------------------------------------------------
+
+// the stream is ADAPTIVE_MAGIC, a byte of rescale_bits, the coded chars
+// and ADAPTIVE_END.  flush() codes ADAPTIVE_FLUSH and pads out the byte so
+// everything so far can be decoded at once; copy_from() does that each
+// time the input has nothing more ready, so a reader on a pipe sees chars
+// as soon as they're written.  bad chars are dropped, as compress() does
+
+class AdaptiveEncoder
+{
+public:
+
+  AdaptiveEncoder(ostream &, int = DEFAULT_ADAPTIVE_RESCALE_BITS);
+  ~AdaptiveEncoder();
+  bool write(const char *, size_t);
+  bool flush();
+  bool finish();
+  bool copy_from(istream &);
+
+  long long bytes_in, bytes_out;
+  AdaptiveTree tree;
+
+private:
+
+  void put_symbol(int);
+  bool write_output();
+
+  ostream & outStream;
+  Huffman H;                 // for is_bad_ascii_code()
+  string pending;            // coded bytes not written yet
+  BitWriter bits;
+  bool started, finished;
+  long long flushed_bits;    // bits.total_bits at the last flush
+};
+
+//----------------------------------------------------------------------------
+
+class AdaptiveDecoder
+{
+public:
+
+  AdaptiveDecoder(istream &);
+  int get();
+  bool copy_to(ostream &);
+  bool failed() { return error; }
+
+  long long bytes_in, bytes_out;
+  AdaptiveTree tree;
+  string message;            // why it failed
+
+private:
+
+  int next_bit();
+  int next_symbol();
+  int next_char();
+  bool fail(string);
+
+  istream & inStream;
+  int byte, bits_left;
+  bool started, done, error;
+};
+
+//----------------------------------------------------------------------------
+
+bool is_adaptive_format(istream &);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,279 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// adding to the end of a .huf file without recompressing what's there
+//----------------------------------------------------------------------------
+
+#include "Append.hh"
+#include "SyncDecode.hh"
+#include "Verify.hh"
+#include "Adaptive.hh"
+#include "Convert.hh"
+
+#include <sstream>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+FileAppender::FileAppender()
+{
+  block_size = DEFAULT_STREAM_BLOCK_SIZE;
+  lz_level = 0;
+  lz_window_bits = DEFAULT_LZ_WINDOW_BITS;
+  split_level = 0;
+  columns = false;
+  bwt = false;
+  num_threads = thread::hardware_concurrency();
+
+  bytes_in = bytes_out = 0;
+  blocks = reused_tables = 0;
+  converted = false;
+}
+
+//----------------------------------------------------------------------------
+
+void FileAppender::configure(StreamEncoder & encoder)
+{
+  if (lz_level > 0)
+    encoder.set_lz(lz_level, lz_window_bits);
+  else if (bwt)
+    encoder.set_bwt(max(1, num_threads));
+  else if (split_level > 0)
+    encoder.set_split(split_level);
+  encoder.set_columns(columns);
+  encoder.set_reuse_tables(true);
+}
+
+//----------------------------------------------------------------------------
+
+// walk the block headers of the stream file open on fd, skipping the
+// payloads, to the (current) end marker.  last_table gets the code lengths
+// of the last Huffman block, empty if there isn't one
+
+bool FileAppender::find_end(int fd, long long & end_pos, vector <int> & last_table)
+{
+  string header(MAX_BLOCK_HEADER_BYTES, 0);
+  struct stat st;
+  BlockHeader h;
+  long long pos;
+  ssize_t got;
+
+  last_table.clear();
+  if (fstat(fd, &st) < 0) {
+    message = strerror(errno);
+    return false;
+  }
+
+  pos = STREAM_MAGIC_BYTES;
+  while (1) {
+    got = pread(fd, &header[0], MAX_BLOCK_HEADER_BYTES, pos);
+    if (got <= 0) {
+      message = "stream ends without end marker";
+      return false;
+    }
+    if (header[0] == BLOCK_END)
+      break;
+    if (header[0] == BLOCK_APPENDED) {
+      pos++;
+      continue;
+    }
+    if (!parse_block_header((const unsigned char *) header.data(), got, h, message) ||
+        !resolve_block_table(h, last_table, message))
+      return false;
+    pos += h.header_bytes + h.payload_length;
+    if (pos > st.st_size) {
+      message = "truncated block payload";
+      return false;
+    }
+  }
+
+  end_pos = pos;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// write old_text and then everything from inStream to a new block stream
+// file, and rename it over filename
+
+bool FileAppender::rewrite(string filename, const string & old_text, istream & inStream)
+{
+  string temp_filename = filename + ".append.tmp";
+  ofstream outStream;
+  bool ok;
+  int fd;
+
+  outStream.open(temp_filename.c_str(), ios::binary | ios::trunc);
+  if (outStream.fail()) {
+    message = "can't create " + temp_filename;
+    return false;
+  }
+
+  {
+    StreamEncoder encoder(outStream, block_size);
+    configure(encoder);
+    ok = encoder.write(old_text.data(), old_text.length()) && encoder.copy_from(inStream);
+    bytes_in = encoder.bytes_in - old_text.length();
+    bytes_out = encoder.bytes_out;
+    blocks = encoder.blocks;
+    reused_tables = encoder.reused_tables;
+  }
+  outStream.close();
+
+  fd = open(temp_filename.c_str(), O_RDONLY);
+  ok = ok && !outStream.fail() && fd >= 0 && fsync(fd) == 0;
+  if (fd >= 0)
+    close(fd);
+
+  if (!ok || rename(temp_filename.c_str(), filename.c_str()) < 0) {
+    message = "can't write " + temp_filename;
+    unlink(temp_filename.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// does data read as an -ascii .huf file?  convert_to_binary() checks the
+// table and that the rest is all '0' and '1', in one pass
+
+static bool is_ascii_huf(const string & data)
+{
+  istringstream inStream(data);
+  NullStream discard;
+  string why;
+
+  return convert_to_binary(inStream, discard, why);
+}
+
+//----------------------------------------------------------------------------
+
+// add everything from inStream to the end of filename
+
+bool FileAppender::append(string filename, istream & inStream)
+{
+  SyncDecodeResult result;
+  vector <int> last_table;
+  struct stat by_fd, by_name;
+  string data, text;
+  char magic[STREAM_MAGIC_BYTES];
+  unsigned char appended = BLOCK_APPENDED;
+  long long end_pos;
+  fstream outStream;
+  ssize_t n;
+  bool ok;
+  int fd;
+
+  bytes_in = bytes_out = 0;
+  blocks = reused_tables = 0;
+  converted = false;
+  message.clear();
+
+  // open and lock.  if another append renamed a new file over this one
+  // while we waited for the lock, start again with the new one
+
+  while (1) {
+    fd = open(filename.c_str(), O_RDWR);
+    if (fd < 0 && errno == ENOENT)
+      return rewrite(filename, "", inStream);
+    if (fd < 0 || flock(fd, LOCK_EX) < 0) {
+      message = strerror(errno);
+      if (fd >= 0)
+        close(fd);
+      return false;
+    }
+    if (fstat(fd, &by_fd) == 0 && stat(filename.c_str(), &by_name) == 0 && by_fd.st_ino == by_name.st_ino)
+      break;
+    close(fd);
+  }
+
+  // an adaptive file is one coded stream with the end marker inside its
+  // last byte, so there's nowhere to add to
+
+  n = pread(fd, magic, STREAM_MAGIC_BYTES, 0);
+  if (n > 0 && (unsigned char) magic[0] == ADAPTIVE_MAGIC) {
+    message = "adaptive files can't be appended to; decompress and compress it again";
+    close(fd);
+    return false;
+  }
+
+  // old-style file: decode it all, once.  an -ascii one has to be
+  // caught before the string decoder, which would take it for binary
+  // and never finish
+
+  if (n != STREAM_MAGIC_BYTES || memcmp(magic, STREAM_MAGIC, STREAM_MAGIC_BYTES)) {
+    ok = read_whole_file(filename, data);
+    if (ok && !sync_decode_legacy(data, text, num_threads, result)) {
+      if (is_ascii_huf(data)) {
+        message = "-ascii files can't be appended to; -convert binary first";
+        close(fd);
+        return false;
+      }
+      ok = result.header_ok && !result.table_ok;
+      if (ok) {
+        istringstream encoded(data);
+        ostringstream decoded;
+        Huffman H;
+        ok = H.decompress_stream(encoded, decoded, true);
+        text = decoded.str();
+      }
+    }
+    if (!ok)
+      message = "not a block stream or old-style binary .huf file";
+    else
+      converted = ok = rewrite(filename, text, inStream);
+    close(fd);
+    return ok;
+  }
+
+  // block stream: new blocks and end marker go after the old end marker,
+  // writing over whatever an unfinished append left there
+
+  if (!find_end(fd, end_pos, last_table) || ftruncate(fd, end_pos + 1) < 0) {
+    if (message.empty())
+      message = strerror(errno);
+    close(fd);
+    return false;
+  }
+
+  outStream.open(filename.c_str(), ios::in | ios::out | ios::binary);
+  outStream.seekp(end_pos + 1);
+  {
+    StreamEncoder encoder(outStream, block_size);
+    configure(encoder);
+    encoder.resume(last_table);
+    ok = encoder.copy_from(inStream);
+    bytes_in = encoder.bytes_in;
+    bytes_out = encoder.bytes_out;
+    blocks = encoder.blocks;
+    reused_tables = encoder.reused_tables;
+  }
+  outStream.close();
+  ok = ok && !outStream.fail();
+
+  // commit: the new blocks are on disk before the old end marker goes
+
+  if (ok && blocks > 0)
+    ok = fsync(fd) == 0 && pwrite(fd, &appended, 1, end_pos) == 1 && fsync(fd) == 0;
+
+  // nothing to add, or writing failed: the file stays as it was
+
+  else if (ftruncate(fd, end_pos + 1) < 0)
+    ok = false;
+
+  if (!ok)
+    message = "write failed";
+  close(fd);
+
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
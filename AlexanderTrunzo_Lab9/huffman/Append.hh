@@ -0,0 +1,67 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// adding to the end of a .huf file without recompressing what's there
+//----------------------------------------------------------------------------
+
+#ifndef APPEND_HH
+#define APPEND_HH
+
+#include "StreamCodec.hh"
+
+//----------------------------------------------------------------------------
+
+// new data goes on the end of a block stream file as new blocks.  each
+// one reuses the code table of the last Huffman block already in the file
+// (BLOCK_HUFFMAN_SAME) if that's no bigger than carrying a fresh table,
+// so a file whose statistics don't change stops paying for tables.
+//
+// finding the end reads only block headers, never payloads, and nothing
+// already in the file is rewritten, so the cost is the new data plus one
+// header per existing block.  the append is committed atomically: the new
+// blocks and a new end marker are written after the old end marker and
+// synced, and only then is the old end marker overwritten with
+// BLOCK_APPENDED, a single byte.  until that byte is written every reader
+// stops at the old end marker, so a crash loses the append but never the
+// file, and the next append writes over the leftovers.  appends to the
+// same file are serialized with flock().
+//
+// an old-style .huf file (one table in the header, padding in the last
+// byte) can't be added to in place.  it is decoded and rewritten once, as
+// a block stream, into a temporary file that is renamed over the
+// original; after that, appends are cheap.  adaptive and -ascii files
+// are refused.  a file that doesn't exist yet is created
+
+class FileAppender
+{
+public:
+
+  FileAppender();
+  bool append(string, istream &);
+
+  int block_size;            // as for StreamEncoder
+  int lz_level;              // 0: no LZ stage
+  int lz_window_bits;
+  int split_level;           // 0: fixed-size blocks
+  bool columns;              // per-column tables for tab-delimited text
+  bool bwt;                  // BWT stage ahead of the Huffman coder
+  int num_threads;           // for decoding an old-style file, and for BWT blocks
+
+  // what the last append() did
+
+  long long bytes_in, bytes_out;
+  int blocks;
+  int reused_tables;
+  bool converted;            // the file was old-style and has been rewritten
+  string message;            // why it failed
+
+private:
+
+  bool find_end(int, long long &, vector <int> &);
+  bool rewrite(string, const string &, istream &);
+  void configure(StreamEncoder &);
+};
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,685 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// file reads and writes that overlap with compression
+//----------------------------------------------------------------------------
+
+#include "AsyncIO.hh"
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#if defined(SYS_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING
+#endif
+#endif
+
+//----------------------------------------------------------------------------
+
+#define IO_POOL_BUFFERS                (2 * IO_QUEUE_DEPTH)   // in flight, plus as many waiting for the codec
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+IOBufferPool::IOBufferPool(int n)
+{
+  void *p;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    if (posix_memalign(&p, IO_ALIGNMENT, IO_BUFFER_BYTES))
+      throw bad_alloc();
+    all.push_back((char *) p);
+  }
+  free_buffers = all;
+}
+
+IOBufferPool::~IOBufferPool()
+{
+  int i;
+
+  for (i = 0; i < all.size(); i++)
+    free(all[i]);
+}
+
+// wait for a buffer to come back if they're all in use
+
+char *IOBufferPool::get()
+{
+  unique_lock <mutex> guard(lock);
+  char *p;
+
+  while (free_buffers.empty())
+    available.wait(guard);
+  p = free_buffers.back();
+  free_buffers.pop_back();
+
+  return p;
+}
+
+void IOBufferPool::put(char *p)
+{
+  lock_guard <mutex> guard(lock);
+
+  free_buffers.push_back(p);
+  available.notify_one();
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// one read or write.  requests are numbered in the order they're
+// submitted, and request k uses slot k % IO_QUEUE_DEPTH
+
+class IORequest
+{
+public:
+  char *buffer;
+  int length;
+  long long offset;
+  bool done;
+  int result;                // bytes, or -errno
+};
+
+// up to IO_QUEUE_DEPTH requests on one fd, through an io_uring set up with
+// the raw system calls (there's no liburing here), or, if the kernel
+// won't give us one, done right away with pread/pwrite
+
+class IOQueue
+{
+public:
+
+  IOQueue(int, long long, bool, bool);
+  ~IOQueue();
+  bool uring() { return ring_fd >= 0; }
+  int in_flight() { return next - first; }
+  IORequest & head() { return slots[first % IO_QUEUE_DEPTH]; }
+  void submit(char *, int, long long);
+  void wait();
+  void retire() { first++; }
+
+private:
+
+  void complete(int, int);
+  void finish_short(IORequest &);
+
+  int fd;
+  long long file_size;       // reads stop here
+  bool writing;
+  IORequest slots[IO_QUEUE_DEPTH];
+  long long first, next;     // requests [first, next) are in flight or not yet retired
+
+  int ring_fd;
+#ifdef HAVE_IO_URING
+  void *sq_ring, *cq_ring;
+  size_t sq_ring_bytes, cq_ring_bytes;
+  struct io_uring_sqe *sqes;
+  size_t sqes_bytes;
+  unsigned *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_cqe *cqes;
+#endif
+};
+
+//----------------------------------------------------------------------------
+
+IOQueue::IOQueue(int file, long long size, bool is_write, bool use_uring)
+{
+  fd = file;
+  file_size = size;
+  writing = is_write;
+  first = next = 0;
+  ring_fd = -1;
+
+#ifdef HAVE_IO_URING
+  struct io_uring_params p;
+
+  if (!use_uring)
+    return;
+
+  memset(&p, 0, sizeof(p));
+  ring_fd = syscall(SYS_io_uring_setup, IO_QUEUE_DEPTH, &p);
+  if (ring_fd < 0)
+    return;
+
+  sq_ring_bytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cq_ring_bytes = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    sq_ring_bytes = cq_ring_bytes = max(sq_ring_bytes, cq_ring_bytes);
+  sqes_bytes = p.sq_entries * sizeof(struct io_uring_sqe);
+
+  sq_ring = mmap(NULL, sq_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    cq_ring = sq_ring;
+  else
+    cq_ring = mmap(NULL, cq_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+  sqes = (struct io_uring_sqe *) mmap(NULL, sqes_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+
+  if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+    if (sq_ring != MAP_FAILED)
+      munmap(sq_ring, sq_ring_bytes);
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+      munmap(cq_ring, cq_ring_bytes);
+    if (sqes != MAP_FAILED)
+      munmap(sqes, sqes_bytes);
+    close(ring_fd);
+    ring_fd = -1;
+    return;
+  }
+
+  sq_tail = (unsigned *) ((char *) sq_ring + p.sq_off.tail);
+  sq_mask = (unsigned *) ((char *) sq_ring + p.sq_off.ring_mask);
+  sq_array = (unsigned *) ((char *) sq_ring + p.sq_off.array);
+  cq_head = (unsigned *) ((char *) cq_ring + p.cq_off.head);
+  cq_tail = (unsigned *) ((char *) cq_ring + p.cq_off.tail);
+  cq_mask = (unsigned *) ((char *) cq_ring + p.cq_off.ring_mask);
+  cqes = (struct io_uring_cqe *) ((char *) cq_ring + p.cq_off.cqes);
+#endif
+}
+
+// callers wait for everything in flight before this, since the kernel
+// may still be using the buffers
+
+IOQueue::~IOQueue()
+{
+#ifdef HAVE_IO_URING
+  if (ring_fd < 0)
+    return;
+  munmap(sqes, sqes_bytes);
+  if (cq_ring != sq_ring)
+    munmap(cq_ring, cq_ring_bytes);
+  munmap(sq_ring, sq_ring_bytes);
+  close(ring_fd);
+#endif
+}
+
+//----------------------------------------------------------------------------
+
+// the kernel may move less than asked for (a read can stop at a page
+// boundary if the file is growing, a write if the disk fills); do the rest
+// here.  a read that stops at end of file just stops
+
+void IOQueue::finish_short(IORequest & r)
+{
+  ssize_t n;
+
+  while (r.result >= 0 && r.result < r.length && (writing || r.offset + r.result < file_size)) {
+    if (writing)
+      n = pwrite(fd, r.buffer + r.result, r.length - r.result, r.offset + r.result);
+    else
+      n = pread(fd, r.buffer + r.result, r.length - r.result, r.offset + r.result);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      r.result = -errno;
+    else if (n == 0) {
+      if (writing)
+        r.result = -EIO;
+      break;
+    }
+    else
+      r.result += n;
+  }
+}
+
+void IOQueue::complete(int slot, int result)
+{
+  IORequest & r = slots[slot];
+
+  r.result = result;
+  finish_short(r);
+  r.done = true;
+}
+
+//----------------------------------------------------------------------------
+
+void IOQueue::submit(char *buffer, int length, long long offset)
+{
+  int slot = next % IO_QUEUE_DEPTH;
+  IORequest & r = slots[slot];
+
+  r.buffer = buffer;
+  r.length = length;
+  r.offset = offset;
+  r.done = false;
+  r.result = 0;
+  next++;
+
+#ifdef HAVE_IO_URING
+  if (ring_fd >= 0) {
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    struct io_uring_sqe *sqe = &sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = writing ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long) buffer;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = slot;
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    while (syscall(SYS_io_uring_enter, ring_fd, 1, 0, 0, NULL, 0) < 0)
+      if (errno != EINTR) {
+        complete(slot, -errno);
+        return;
+      }
+    return;
+  }
+#endif
+
+  complete(slot, 0);
+}
+
+// wait until at least one more request has finished.  kernels that have
+// io_uring but not IORING_OP_READ/WRITE (before 5.6) say EINVAL; those
+// requests are done again by hand
+
+void IOQueue::wait()
+{
+#ifdef HAVE_IO_URING
+  unsigned cq_next;
+  struct io_uring_cqe *cqe;
+
+  if (ring_fd < 0 || head().done)
+    return;
+
+  while (1) {
+    cq_next = *cq_head;
+    if (cq_next != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+      break;
+    if (syscall(SYS_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+      complete(first % IO_QUEUE_DEPTH, -errno);
+      return;
+    }
+  }
+
+  cqe = &cqes[cq_next & *cq_mask];
+  complete(cqe->user_data, cqe->res == -EINVAL ? 0 : cqe->res);
+  __atomic_store_n(cq_head, cq_next + 1, __ATOMIC_RELEASE);
+#endif
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// O_DIRECT if asked for and the file system allows it (tmpfs doesn't)
+
+static int open_file(string filename, int mode, bool & direct)
+{
+  int fd = -1;
+
+#ifdef O_DIRECT
+  if (direct) {
+    fd = open(filename.c_str(), mode | O_DIRECT, 0666);
+    if (fd >= 0 || errno != EINVAL)
+      return fd;
+  }
+#endif
+
+  direct = false;
+  return open(filename.c_str(), mode, 0666);
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+AsyncFileReader::AsyncFileReader()
+{
+  fd = -1;
+  file_size = 0;
+  direct = error = uring = stop = done = false;
+  pool = NULL;
+  current = NULL;
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+  close();
+}
+
+//----------------------------------------------------------------------------
+
+bool AsyncFileReader::open(string filename, int flags)
+{
+  struct stat st;
+
+  close();
+
+  direct = (flags & IO_DIRECT) != 0;
+  fd = open_file(filename, O_RDONLY, direct);
+  if (fd < 0)
+    return false;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+
+  file_size = st.st_size;
+  error = stop = done = false;
+  uring = (flags & IO_URING) != 0;
+  pool = new IOBufferPool(IO_POOL_BUFFERS);
+  current = NULL;
+  setg(NULL, NULL, NULL);
+  reader = thread(&AsyncFileReader::run, this);
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+bool AsyncFileReader::stopping()
+{
+  lock_guard <mutex> guard(lock);
+
+  return stop;
+}
+
+// the reader thread: keep IO_QUEUE_DEPTH reads in flight, and hand the
+// buffers over in file order as they finish
+
+void AsyncFileReader::run()
+{
+  IOQueue queue(fd, file_size, false, uring);
+  long long offset = 0;
+  int length;
+  bool failed = false;
+
+  uring = queue.uring();
+
+  while (1) {
+    while (!failed && !stopping() && queue.in_flight() < IO_QUEUE_DEPTH && offset < file_size) {
+      length = (int) min((long long) IO_BUFFER_BYTES, file_size - offset);
+      if (direct)
+        length = (length + IO_ALIGNMENT - 1) & ~(IO_ALIGNMENT - 1);
+      queue.submit(pool->get(), length, offset);
+      offset += length;
+    }
+    if (queue.in_flight() == 0)
+      break;
+
+    queue.wait();
+    while (queue.in_flight() > 0 && queue.head().done) {
+      IORequest & r = queue.head();
+      lock_guard <mutex> guard(lock);
+      if (r.result < 0 || failed || stop) {
+        failed = failed || r.result < 0;
+        pool->put(r.buffer);
+      }
+      else
+        ready.push_back(make_pair(r.buffer, (int) min((long long) r.result, file_size - r.offset)));
+      queue.retire();
+      changed.notify_one();
+    }
+  }
+
+  lock_guard <mutex> guard(lock);
+  error = error || failed;
+  done = true;
+  changed.notify_one();
+}
+
+//----------------------------------------------------------------------------
+
+// the codec has used up the current buffer: give it back and wait for the
+// next one
+
+int AsyncFileReader::underflow()
+{
+  unique_lock <mutex> guard(lock);
+
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+
+  if (current != NULL) {
+    pool->put(current);
+    current = NULL;
+  }
+  if (pool == NULL)
+    return traits_type::eof();
+
+  while (ready.empty() && !done)
+    changed.wait(guard);
+  if (ready.empty()) {
+    setg(NULL, NULL, NULL);
+    return traits_type::eof();
+  }
+
+  current = ready.front().first;
+  setg(current, current, current + ready.front().second);
+  ready.pop_front();
+
+  return traits_type::to_int_type(*gptr());
+}
+
+//----------------------------------------------------------------------------
+
+// may be called before the whole file has been read
+
+bool AsyncFileReader::close()
+{
+  bool ok;
+
+  if (fd < 0)
+    return true;
+
+  {
+    lock_guard <mutex> guard(lock);
+    stop = true;
+    if (current != NULL)
+      pool->put(current);
+    while (!ready.empty()) {
+      pool->put(ready.front().first);
+      ready.pop_front();
+    }
+    current = NULL;
+  }
+  reader.join();
+
+  while (!ready.empty()) {
+    pool->put(ready.front().first);
+    ready.pop_front();
+  }
+  delete pool;
+  pool = NULL;
+  setg(NULL, NULL, NULL);
+
+  ::close(fd);
+  fd = -1;
+  ok = !error;
+
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+AsyncFileWriter::AsyncFileWriter()
+{
+  fd = -1;
+  direct = error = uring = done = false;
+  pool = NULL;
+  current = NULL;
+  bytes_written = 0;
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+  close();
+}
+
+//----------------------------------------------------------------------------
+
+bool AsyncFileWriter::open(string filename, int flags)
+{
+  close();
+
+  direct = (flags & IO_DIRECT) != 0;
+  fd = open_file(filename, O_WRONLY | O_CREAT | O_TRUNC, direct);
+  if (fd < 0)
+    return false;
+
+  error = done = false;
+  uring = (flags & IO_URING) != 0;
+  bytes_written = 0;
+  pool = new IOBufferPool(IO_POOL_BUFFERS);
+  current = pool->get();
+  setp(current, current + IO_BUFFER_BYTES);
+  writer = thread(&AsyncFileWriter::run, this);
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// the writer thread: take full buffers as the codec hands them over and
+// keep up to IO_QUEUE_DEPTH writes in flight, each buffer going back to
+// the pool when its write finishes
+
+void AsyncFileWriter::run()
+{
+  IOQueue queue(fd, 0, true, uring);
+  long long offset = 0;
+  pair <char *, int> next;
+  bool failed = false, finished = false;
+  int length;
+
+  uring = queue.uring();
+
+  while (1) {
+    {
+      unique_lock <mutex> guard(lock);
+      while (queue.in_flight() == 0 && queued.empty() && !done)
+        changed.wait(guard);
+      finished = done && queued.empty();
+      while (queue.in_flight() < IO_QUEUE_DEPTH && !queued.empty()) {
+        next = queued.front();
+        queued.pop_front();
+        guard.unlock();
+        length = next.second;
+        if (direct) {
+          length = (length + IO_ALIGNMENT - 1) & ~(IO_ALIGNMENT - 1);
+          memset(next.first + next.second, 0, length - next.second);
+        }
+        if (failed)
+          pool->put(next.first);
+        else {
+          queue.submit(next.first, length, offset);
+          offset += length;
+        }
+        guard.lock();
+      }
+      finished = done && queued.empty();
+    }
+
+    if (queue.in_flight() == 0) {
+      if (finished)
+        break;
+      continue;
+    }
+
+    queue.wait();
+    while (queue.in_flight() > 0 && queue.head().done) {
+      failed = failed || queue.head().result < 0;
+      pool->put(queue.head().buffer);
+      queue.retire();
+    }
+    if (failed) {
+      lock_guard <mutex> guard(lock);
+      error = true;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+
+// queue the current buffer (full, or the last one) for writing
+
+void AsyncFileWriter::hand_off()
+{
+  int n = pptr() - pbase();
+
+  bytes_written += n;
+  {
+    lock_guard <mutex> guard(lock);
+    queued.push_back(make_pair(current, n));
+    changed.notify_one();
+  }
+  current = NULL;
+  setp(NULL, NULL);
+}
+
+int AsyncFileWriter::overflow(int c)
+{
+  bool failed;
+
+  if (pool == NULL)
+    return traits_type::eof();
+  {
+    lock_guard <mutex> guard(lock);
+    failed = error;
+  }
+  if (failed)
+    return traits_type::eof();
+
+  hand_off();
+  current = pool->get();
+  setp(current, current + IO_BUFFER_BYTES);
+
+  if (!traits_type::eq_int_type(c, traits_type::eof()))
+    return sputc(traits_type::to_char_type(c));
+  return traits_type::not_eof(c);
+}
+
+//----------------------------------------------------------------------------
+
+// write what's left and wait for all of it.  an O_DIRECT file was padded
+// to a whole block, so cut it back to what was really written
+
+bool AsyncFileWriter::close()
+{
+  bool ok;
+
+  if (fd < 0)
+    return true;
+
+  if (pptr() > pbase())
+    hand_off();
+  else if (current != NULL) {
+    pool->put(current);
+    current = NULL;
+    setp(NULL, NULL);
+  }
+  {
+    lock_guard <mutex> guard(lock);
+    done = true;
+    changed.notify_one();
+  }
+  writer.join();
+
+  delete pool;
+  pool = NULL;
+
+  ok = !error;
+  if (direct && ftruncate(fd, bytes_written) < 0)
+    ok = false;
+  if (::close(fd) < 0)
+    ok = false;
+  fd = -1;
+  error = !ok;
+
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,166 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// file reads and writes that overlap with compression
+//----------------------------------------------------------------------------
+
+#ifndef ASYNCIO_HH
+#define ASYNCIO_HH
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <iostream>
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+
+#define IO_BUFFER_BYTES                (1024 * 1024)
+#define IO_QUEUE_DEPTH                 4       // buffers being read or written at once
+#define IO_ALIGNMENT                   4096    // O_DIRECT needs addresses, offsets and lengths aligned to this
+#define IO_DIRECT_MIN_BYTES            (256LL * 1024 * 1024)   // smaller files stay in the page cache
+
+#define IO_URING                       1       // submit through io_uring if the kernel has it, else pread/pwrite
+#define IO_DIRECT                      2       // open with O_DIRECT (bypass the page cache) if the file system allows
+
+//----------------------------------------------------------------------------
+
+// a three-stage pipeline: a reader thread fills buffers from the input
+// file, the codec (the caller's thread) works through them as an
+// istream and fills output buffers as an ostream, and a writer thread
+// drains those to the output file.  so reading the next buffer, coding
+// this one and writing the last one all happen at once, and a run takes
+// about as long as the slowest of the three instead of their sum.
+//
+// buffers are IO_BUFFER_BYTES, IO_ALIGNMENT-aligned, and come from a
+// fixed pool per file that they go back to once used, so nothing is
+// allocated per buffer and a stage that gets ahead waits for the others.
+// each thread keeps up to IO_QUEUE_DEPTH requests in flight on its own
+// io_uring; without io_uring (old kernel, or seccomp) the same thread does
+// plain blocking pread/pwrite, which still overlaps with the codec.
+//
+// with IO_DIRECT the page cache is skipped, which only pays off for
+// files much bigger than memory.  the last block of an O_DIRECT write is
+// padded to IO_ALIGNMENT and the file truncated to its real length on
+// close().  flush() does not push out a partial buffer (that would
+// misalign the next write); everything is on its way only after close()
+
+class IOBufferPool
+{
+public:
+
+  IOBufferPool(int);
+  ~IOBufferPool();
+  char *get();
+  void put(char *);
+
+private:
+
+  vector <char *> all, free_buffers;
+  mutex lock;
+  condition_variable available;
+};
+
+//----------------------------------------------------------------------------
+
+class AsyncFileReader : public streambuf
+{
+public:
+
+  AsyncFileReader();
+  ~AsyncFileReader();
+  bool open(string, int = IO_URING);
+  bool close();
+  bool failed() { return error; }
+  bool used_uring() { return uring; }
+  long long size() { return file_size; }
+
+protected:
+
+  int underflow();
+
+private:
+
+  void run();
+  bool stopping();
+
+  int fd;
+  long long file_size;
+  bool direct, error, uring, stop;
+  IOBufferPool *pool;
+  thread reader;
+  mutex lock;
+  condition_variable changed;
+  deque <pair <char *, int> > ready;     // filled buffers in file order, and how much is in each
+  bool done;                             // the reader has queued the last buffer
+  char *current;                         // buffer being read by the codec
+};
+
+//----------------------------------------------------------------------------
+
+class AsyncFileWriter : public streambuf
+{
+public:
+
+  AsyncFileWriter();
+  ~AsyncFileWriter();
+  bool open(string, int = IO_URING);
+  bool close();
+  bool failed() { return error; }
+  bool used_uring() { return uring; }
+
+protected:
+
+  int overflow(int);
+
+private:
+
+  void hand_off();
+  void run();
+
+  int fd;
+  bool direct, error, uring;
+  IOBufferPool *pool;
+  thread writer;
+  mutex lock;
+  condition_variable changed;
+  deque <pair <char *, int> > queued;    // full buffers in file order, and how much is in each
+  bool done;                             // no more buffers are coming
+  char *current;                         // buffer being filled by the codec
+  long long bytes_written;
+};
+
+//----------------------------------------------------------------------------
+
+// the same, looking like ifstream and ofstream
+
+class AsyncInput : public istream
+{
+public:
+  AsyncInput() : istream(&buffer) { }
+  bool open(string filename, int flags = IO_URING) { if (buffer.open(filename, flags)) return true; setstate(ios::failbit); return false; }
+  bool close() { return buffer.close(); }
+  bool used_uring() { return buffer.used_uring(); }
+  long long size() { return buffer.size(); }
+private:
+  AsyncFileReader buffer;
+};
+
+class AsyncOutput : public ostream
+{
+public:
+  AsyncOutput() : ostream(&buffer) { }
+  bool open(string filename, int flags = IO_URING) { if (buffer.open(filename, flags)) return true; setstate(ios::failbit); return false; }
+  bool close() { return buffer.close() && !fail(); }
+  bool used_uring() { return buffer.used_uring(); }
+private:
+  AsyncFileWriter buffer;
+};
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,379 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// Burrows-Wheeler, move-to-front and zero-run transform ahead of the Huffman coder
+//----------------------------------------------------------------------------
+
+#include "BWT.hh"
+#include "StreamCodec.hh"
+#include "BitIO.hh"
+
+//----------------------------------------------------------------------------
+
+// SA-IS (Nong, Zhang and Chan).  suffixes are S-type if they sort before
+// the one after them, L-type if after; an S-type suffix right after an
+// L-type one is LMS.  sorting just the LMS suffixes is enough to "induce"
+// the order of all the others in two sweeps, and the LMS suffixes are
+// sorted by naming their substrings and recursing on the names, which is
+// at most half as long.  s[n - 1] must be a sentinel smaller than every
+// other symbol, and symbols are 0..K-1
+
+static inline bool is_lms(const vector <bool> & t, int i)
+{
+  return i > 0 && t[i] && !t[i - 1];
+}
+
+// start (or one past the end) of each symbol's bucket in SA
+
+static void sais_buckets(const int *s, int n, int K, vector <int> & bucket, bool end)
+{
+  int i, c, sum, count;
+
+  bucket.assign(K, 0);
+  for (i = 0; i < n; i++)
+    bucket[s[i]]++;
+
+  sum = 0;
+  for (c = 0; c < K; c++) {
+    count = bucket[c];
+    sum += count;
+    bucket[c] = end ? sum : sum - count;
+  }
+}
+
+// L-type suffixes left to right from the bucket starts, then S-type ones
+// right to left from the bucket ends
+
+static void sais_induce(const int *s, int *SA, int n, int K, const vector <bool> & t, vector <int> & bucket)
+{
+  int i, j;
+
+  sais_buckets(s, n, K, bucket, false);
+  for (i = 0; i < n; i++) {
+    j = SA[i] - 1;
+    if (SA[i] > 0 && !t[j])
+      SA[bucket[s[j]]++] = j;
+  }
+
+  sais_buckets(s, n, K, bucket, true);
+  for (i = n - 1; i >= 0; i--) {
+    j = SA[i] - 1;
+    if (SA[i] > 0 && t[j])
+      SA[--bucket[s[j]]] = j;
+  }
+}
+
+static void sais(const int *s, int *SA, int n, int K)
+{
+  vector <bool> t(n);
+  vector <int> bucket;
+  int *s1;
+  int i, j, d, n1, name, prev, pos;
+  bool diff;
+
+  if (n == 1) {
+    SA[0] = 0;
+    return;
+  }
+
+  t[n - 1] = true;
+  t[n - 2] = false;
+  for (i = n - 3; i >= 0; i--)
+    t[i] = s[i] < s[i + 1] || (s[i] == s[i + 1] && t[i + 1]);
+
+  // 1. LMS suffixes in any order at their bucket ends, then induce: the
+  // LMS substrings come out sorted
+
+  sais_buckets(s, n, K, bucket, true);
+  fill(SA, SA + n, -1);
+  for (i = 1; i < n; i++)
+    if (is_lms(t, i))
+      SA[--bucket[s[i]]] = i;
+  sais_induce(s, SA, n, K, t, bucket);
+
+  // name them, equal substrings getting equal names.  names go in the
+  // top half of SA by position, then are packed to the end
+
+  n1 = 0;
+  for (i = 0; i < n; i++)
+    if (is_lms(t, SA[i]))
+      SA[n1++] = SA[i];
+  fill(SA + n1, SA + n, -1);
+
+  name = 0;
+  prev = -1;
+  for (i = 0; i < n1; i++) {
+    pos = SA[i];
+    diff = false;
+    for (d = 0; d < n; d++) {
+      if (prev == -1 || s[pos + d] != s[prev + d] || t[pos + d] != t[prev + d]) {
+        diff = true;
+        break;
+      }
+      if (d > 0 && (is_lms(t, pos + d) || is_lms(t, prev + d)))
+        break;
+    }
+    if (diff) {
+      name++;
+      prev = pos;
+    }
+    SA[n1 + pos / 2] = name - 1;
+  }
+  for (i = j = n - 1; i >= n1; i--)
+    if (SA[i] >= 0)
+      SA[j--] = SA[i];
+
+  // 2. sort the LMS suffixes: directly if the names are all different,
+  // else by recursing on the string of names
+
+  s1 = SA + n - n1;
+  if (name < n1)
+    sais(s1, SA, n1, name);
+  else
+    for (i = 0; i < n1; i++)
+      SA[s1[i]] = i;
+
+  // 3. sorted LMS suffixes at their bucket ends, and induce the rest
+
+  for (i = 1, j = 0; i < n; i++)
+    if (is_lms(t, i))
+      s1[j++] = i;
+  for (i = 0; i < n1; i++)
+    SA[i] = s1[SA[i]];
+  fill(SA + n1, SA + n, -1);
+
+  sais_buckets(s, n, K, bucket, true);
+  for (i = n1 - 1; i >= 0; i--) {
+    j = SA[i];
+    SA[i] = -1;
+    SA[--bucket[s[j]]] = j;
+  }
+  sais_induce(s, SA, n, K, t, bucket);
+}
+
+//----------------------------------------------------------------------------
+
+// rows are the rotations of the chars plus a sentinel that sorts first,
+// so they sort just like the suffixes.  row 0 is always the sentinel's;
+// the primary index is the row of the whole block, where the sentinel is
+// the last char
+
+unsigned int bwt_forward(const char *data, int n, string & last)
+{
+  vector <int> s(n + 1), SA(n + 1);
+  unsigned int primary;
+  int i, j;
+
+  for (i = 0; i < n; i++)
+    s[i] = (unsigned char) data[i] + 1;
+  s[n] = 0;
+  sais(&s[0], &SA[0], n + 1, 257);
+
+  last.resize(n);
+  primary = 0;
+  for (i = j = 0; i <= n; i++)
+    if (SA[i] == 0)
+      primary = i;
+    else
+      last[j++] = data[SA[i] - 1];
+
+  return primary;
+}
+
+//----------------------------------------------------------------------------
+
+// next[i] is the row of the rotation that starts one char later than row
+// i's, found by counting: the k-th row starting with c is the k-th row
+// ending in it.  following next from row 0 spells the block out, first
+// char of each row in turn
+
+bool bwt_inverse(const char *last, int n, unsigned int primary, char *out)
+{
+  vector <unsigned int> next(n + 1);
+  vector <unsigned char> first(n + 1);
+  unsigned int start[256];
+  unsigned int row;
+  int i, c, sum;
+
+  if (n == 0)
+    return primary == 0;
+  if (primary < 1 || primary > n)
+    return false;
+
+  memset(start, 0, sizeof(start));
+  for (i = 0; i < n; i++)
+    start[(unsigned char) last[i]]++;
+  sum = 1;
+  for (c = 0; c < 256; c++) {
+    i = start[c];
+    start[c] = sum;
+    sum += i;
+  }
+
+  next[0] = primary;
+  for (i = 0; i < n; i++) {
+    c = (unsigned char) last[i];
+    row = start[c]++;
+    next[row] = i < primary ? i : i + 1;
+    first[row] = c;
+  }
+
+  row = next[0];
+  for (i = 0; i < n; i++) {
+    out[i] = (char) first[row];
+    row = next[row];
+  }
+
+  return row == 0;
+}
+
+//----------------------------------------------------------------------------
+
+// zero run of length r in bijective base 2, least significant digit first
+
+static void append_zero_run(int r, vector <unsigned char> & symbols)
+{
+  r--;
+  while (1) {
+    symbols.push_back(r & 1 ? BWT_RUNB : BWT_RUNA);
+    if (r < 2)
+      break;
+    r = (r - 2) / 2;
+  }
+}
+
+//----------------------------------------------------------------------------
+
+void bwt_encode_block(const char *data, int n, string & out, int & payload_start)
+{
+  vector <unsigned char> symbols;
+  vector <int> counts(BWT_SYMBOLS, 0);
+  CodeTable T(BWT_SYMBOLS);
+  unsigned char mtf[NUM_ASCII];
+  string last;
+  unsigned int primary;
+  int i, v, c, run;
+
+  primary = bwt_forward(data, n, last);
+
+  // move-to-front, with zero runs
+
+  for (c = 0; c < NUM_ASCII; c++)
+    mtf[c] = c;
+  symbols.reserve(n);
+  run = 0;
+
+  for (i = 0; i < n; i++) {
+    c = (unsigned char) last[i];
+    if (mtf[0] == c) {
+      run++;
+      continue;
+    }
+    if (run > 0) {
+      append_zero_run(run, symbols);
+      run = 0;
+    }
+    for (v = 1; mtf[v] != c; v++)
+      ;
+    memmove(mtf + 1, mtf, v);
+    mtf[0] = c;
+    symbols.push_back(v + 1);
+  }
+  if (run > 0)
+    append_zero_run(run, symbols);
+
+  for (i = 0; i < symbols.size(); i++)
+    counts[symbols[i]]++;
+  T.from_counts(counts, MAX_STREAM_CODE_LENGTH);
+
+  append_u32(out, primary);
+  lz_append_table(out, T);
+
+  payload_start = out.length();
+  BitWriter w(out);
+
+  for (i = 0; i < symbols.size(); i++)
+    w.put(T.code_bits[symbols[i]], T.code_length[symbols[i]]);
+
+  w.flush();
+}
+
+//----------------------------------------------------------------------------
+
+// undo the zero runs and move-to-front as the symbols are decoded, then
+// the BWT.  a zero run is only known to be over when a non-run symbol
+// comes, or when it reaches the end of the block
+
+bool bwt_decode_block(vector <int> & lengths, unsigned int primary, const unsigned char *payload,
+                      size_t payload_length, char *out, int n, string & message)
+{
+  CodeTable T(BWT_SYMBOLS);
+  DecodeTable D;
+  unsigned char mtf[NUM_ASCII];
+  string last;
+  long long run, digit;
+  int o, v, c, sym;
+
+  T.from_code_lengths(lengths);
+  if (!D.build(T)) {
+    message = "BWT code table is not a prefix code";
+    return false;
+  }
+
+  for (c = 0; c < NUM_ASCII; c++)
+    mtf[c] = c;
+  last.resize(n);
+
+  BitReader in(payload, payload_length);
+  o = 0;
+  run = 0;
+  digit = 1;
+  sym = 0;
+
+  while (o + run < n) {
+
+    sym = D.decode(in);
+    if (sym < 0)
+      break;
+
+    if (sym <= BWT_RUNB) {
+      run += (sym + 1) * digit;
+      digit *= 2;
+      continue;
+    }
+
+    if (run > 0) {
+      memset(&last[o], mtf[0], run);
+      o += run;
+      run = 0;
+      digit = 1;
+    }
+
+    v = sym - 1;
+    c = mtf[v];
+    memmove(mtf + 1, mtf, v);
+    mtf[0] = c;
+    last[o++] = (char) c;
+  }
+
+  if (sym < 0 || o + run != n) {
+    message = sym < 0 ? "invalid code in BWT block payload" : "BWT block has too many chars";
+    return false;
+  }
+  if (run > 0)
+    memset(&last[o], mtf[0], run);
+
+  if (in.bits_consumed() > 8LL * payload_length || (in.bits_consumed() + 7) / 8 != payload_length) {
+    message = "block payload length doesn't match its contents";
+    return false;
+  }
+
+  if (!bwt_inverse(last.data(), n, primary, out)) {
+    message = "bad BWT primary index";
+    return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,65 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// Burrows-Wheeler, move-to-front and zero-run transform ahead of the Huffman coder
+//----------------------------------------------------------------------------
+
+#ifndef BWT_HH
+#define BWT_HH
+
+#include "Huffman.hh"
+#include "CodeTable.hh"
+
+//----------------------------------------------------------------------------
+
+#define BWT_RUNA                       0
+#define BWT_RUNB                       1
+#define BWT_SYMBOLS                    (NUM_ASCII + 1)   // RUNA, RUNB, MTF positions 1..127
+#define BWT_FIXED_HEADER_BYTES         18      // through the table size byte
+#define DEFAULT_BWT_BLOCK_SIZE         (900 * 1024)
+
+//----------------------------------------------------------------------------
+
+// order-0 Huffman only sees how often each char comes up, not what it
+// follows, so the repeated words and runs of spaces in text are lost on
+// it.  a BWT block is rearranged first so that those turn into runs the
+// Huffman coder can use:
+//
+//   1. Burrows-Wheeler: the chars are sorted by the text that follows
+//      them (a suffix array, built in linear time with SA-IS), and the
+//      char before each sorted suffix is kept.  chars that come before
+//      the same context end up next to each other, so the output is
+//      mostly long runs of a few chars.  the row where the whole block
+//      starts (the primary index) goes in the header so it can be undone
+//   2. move-to-front: each char becomes its position in a list of chars
+//      ordered by how recently they were seen, so runs turn into zeros
+//      and the rest into small numbers
+//   3. zero runs: a run of r zeros is written as r in bijective base 2
+//      with the digits RUNA (1) and RUNB (2), least significant first,
+//      like bzip2; MTF position v > 0 is symbol v + 1
+//
+// the symbols get one canonical Huffman table, in the header after the
+// primary index.  chars must be ASCII (the stream encoder drops bad chars
+// before this), so MTF positions fit in 7 bits.  a block's transforms are
+// independent of every other block, so the encoder does several at once
+// on separate threads, and so does a decoder reading a file
+
+// BWT of the n chars into last (n chars, the sentinel row left out);
+// returns the primary index
+
+unsigned int bwt_forward(const char *, int, string &);
+
+// and back: n chars of last and the primary index into out.  false if
+// they can't be the BWT of anything
+
+bool bwt_inverse(const char *, int, unsigned int, char *);
+
+// all three stages on n chars, appending [primary index][table][payload]
+// to out.  payload_start is set to where the payload begins in out
+
+void bwt_encode_block(const char *, int, string &, int &);
+bool bwt_decode_block(vector <int> &, unsigned int, const unsigned char *, size_t, char *, int, string &);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
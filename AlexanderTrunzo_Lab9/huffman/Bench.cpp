@@ -0,0 +1,634 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// micro-benchmarks for the codec's inner loops
+//----------------------------------------------------------------------------
+
+#include "Bench.hh"
+#include "BitPack.hh"
+#include "CodeTable.hh"
+#include "StreamCodec.hh"
+#include "Protocol.hh"
+#include "CodeBook.hh"
+#include "RecordCodec.hh"
+#include "PerfCounters.hh"
+#include "SyncDecode.hh"
+#include "Adaptive.hh"
+
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+string bench_input(vector <string> & filenames)
+{
+  ifstream inStream;
+  ostringstream contents;
+  string raw, chars;
+  Huffman H;
+  unsigned int seed;
+  int i;
+
+  for (i = 0; i < filenames.size(); i++) {
+    inStream.open(filenames[i].c_str(), ios::binary);
+    if (inStream.fail()) {
+      cout << "Failed to open input file " << filenames[i] << endl;
+      exit(1);
+    }
+    contents << inStream.rdbuf();
+    inStream.close();
+  }
+  raw = contents.str();
+
+  for (i = 0; i < raw.length(); i++)
+    if (!H.is_bad_ascii_code((int) raw[i]))
+      chars += raw[i];
+
+  // no files: words of skewed letters, so the codes have varied lengths
+
+  if (chars.empty()) {
+    seed = 12345;
+    while (chars.length() < BENCH_SYNTHETIC_CHARS) {
+      seed = seed * 1103515245 + 12345;
+      i = (seed >> 16) % 64;
+      if (i < 10)
+        chars += ' ';
+      else if (i == 10)
+        chars += '\n';
+      else
+        chars += (char) ('a' + (i * i) % 26);
+    }
+  }
+
+  return chars;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool bench_kernels(vector <string> & filenames, ostream & outStream)
+{
+  vector <BitPackKernels *> targets;
+  BitPackKernels *K;
+  string chars, payload, ascii, encoded, decoded, repacked, unpacked;
+  CodeTable T;
+  DecodeTable D;
+  Huffman H;
+  double pack_rate, unpack_rate, check_rate, encode_rate, decode_rate;
+  bool ok, checked;
+  int i;
+
+  chars = bench_input(filenames);
+
+  H.compute_frequencies(chars.data(), chars.length());
+  H.build_code_table();
+  T.from_compression_map(H.compression_map);
+  T.limit_code_lengths(MAX_STREAM_CODE_LENGTH, H.char_counter);
+  D.build(T);
+
+  // reference results from the scalar kernels
+
+  targets = bitpack_targets();
+  targets[0]->encode(chars.data(), chars.length(), &T.code_length[0], &T.code_bits[0], payload);
+  ascii.resize(8 * payload.length());
+  targets[0]->unpack_ascii((const unsigned char *) payload.data(), payload.length(), &ascii[0]);
+
+  outStream << "kernels: " << chars.length() << " chars, " << payload.length() << " payload bytes, "
+            << "selected " << bitpack().name << endl;
+  outStream << setw(8) << "target" << setw(12) << "pack" << setw(12) << "unpack" << setw(12) << "check"
+            << setw(12) << "encode" << setw(12) << "decode" << "   (MB/s: packed bytes for pack/unpack/check, chars for encode/decode)\n";
+
+  ok = true;
+  decoded.resize(chars.length());
+  repacked.resize(payload.length());
+  unpacked.resize(ascii.length());
+
+  for (i = 0; i < targets.size(); i++) {
+    K = targets[i];
+
+    pack_rate = time_kernel([&]() { K->pack_ascii(ascii.data(), payload.length(), (unsigned char *) &repacked[0]); },
+                            payload.length());
+    unpack_rate = time_kernel([&]() { K->unpack_ascii((const unsigned char *) payload.data(), payload.length(), &unpacked[0]); },
+                              payload.length());
+    check_rate = time_kernel([&]() { checked = K->check_ascii(ascii.data(), ascii.length()) == ascii.length(); },
+                             payload.length());
+    encode_rate = time_kernel([&]() { encoded.clear(); K->encode(chars.data(), chars.length(), &T.code_length[0], &T.code_bits[0], encoded); },
+                              chars.length());
+    decode_rate = time_kernel([&]() { K->decode(&D.entries[0], D.primary_bits, (const unsigned char *) payload.data(),
+                                                payload.length(), &decoded[0], chars.length()); },
+                              chars.length());
+
+    outStream << setw(8) << K->name << fixed << setprecision(1)
+              << setw(12) << pack_rate << setw(12) << unpack_rate << setw(12) << check_rate
+              << setw(12) << encode_rate << setw(12) << decode_rate;
+
+    if (!checked || repacked != payload || unpacked != ascii || encoded != payload || decoded != chars) {
+      outStream << "   MISMATCH";
+      ok = false;
+    }
+    outStream << endl;
+  }
+
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+
+bool bench_stress(vector <string> & filenames, int max_threads, ostream & outStream)
+{
+  CodeBookPtr book;
+  vector <string> payloads;
+  vector <size_t> starts, sizes;
+  vector <int> counts(NUM_ASCII, 0);
+  vector <long long> thread_counts;
+  string chars;
+  double start, elapsed, rate, base_rate;
+  long long messages, decoded_chars;
+  atomic <bool> stop, failed;
+  size_t i, n;
+  int t, k;
+
+  chars = bench_input(filenames);
+  for (i = 0; i < chars.length(); i++)
+    counts[(unsigned char) chars[i]]++;
+  book = CodeBook::from_counts(counts);
+  if (!book) {
+    outStream << "stress: couldn't build a code book\n";
+    return false;
+  }
+
+  for (i = 0; i < chars.length(); i += BENCH_MESSAGE_CHARS) {
+    n = min((size_t) BENCH_MESSAGE_CHARS, chars.length() - i);
+    payloads.push_back("");
+    book->encode(chars.data() + i, n, payloads.back());
+    starts.push_back(i);
+    sizes.push_back(n);
+  }
+
+  outStream << "stress: " << payloads.size() << " messages of " << BENCH_MESSAGE_CHARS
+            << " chars, one shared code book, " << bitpack().name << " kernels\n";
+  outStream << setw(8) << "threads" << setw(14) << "messages/s" << setw(10) << "MB/s"
+            << setw(10) << "speedup" << endl;
+
+  base_rate = 0;
+  failed = false;
+  max_threads = max(1, max_threads);
+
+  for (t = 1; ; t = min(2 * t, max_threads)) {
+    vector <thread> workers;
+
+    thread_counts.assign(t, 0);
+    stop = false;
+
+    // each thread has its own reference to the book and its own output
+    // buffer, and decodes every t-th message
+
+    for (k = 0; k < t; k++)
+      workers.push_back(thread([&, k]() {
+        CodeBookPtr my_book(book);
+        string scratch(BENCH_MESSAGE_CHARS, 0);
+        long long done;
+        size_t m;
+
+        // counted locally, so threads don't write to a shared cache line
+
+        done = 0;
+        for (m = k; !stop; m += t) {
+          if (m >= payloads.size())
+            m = k % payloads.size();
+          if (my_book->decode((const unsigned char *) payloads[m].data(), payloads[m].length(), &scratch[0], sizes[m]) < 0
+              || memcmp(scratch.data(), chars.data() + starts[m], sizes[m]))
+            failed = true;
+          done++;
+        }
+        thread_counts[k] = done;
+      }));
+
+    start = now_microseconds();
+    this_thread::sleep_for(chrono::milliseconds((int) (1000 * BENCH_MIN_SECONDS)));
+    stop = true;
+    for (k = 0; k < t; k++)
+      workers[k].join();
+    elapsed = (now_microseconds() - start) / 1e6;
+
+    messages = 0;
+    for (k = 0; k < t; k++)
+      messages += thread_counts[k];
+    decoded_chars = messages * (chars.length() / (double) payloads.size());
+    rate = messages / elapsed;
+    if (t == 1)
+      base_rate = rate;
+
+    outStream << setw(8) << t << fixed << setprecision(0) << setw(14) << rate
+              << setprecision(1) << setw(10) << decoded_chars / elapsed / 1e6
+              << setprecision(2) << setw(10) << rate / base_rate << endl;
+
+    if (t == max_threads)
+      break;
+  }
+
+  if (failed)
+    outStream << "MISMATCH: a decoded message differs from the original\n";
+  if (book.use_count() != 1)
+    outStream << "LEAK: code book still has " << book.use_count() - 1 << " other owners\n";
+
+  return !failed && book.use_count() == 1;
+}
+
+//----------------------------------------------------------------------------
+
+bool bench_records(vector <string> & filenames, ostream & outStream)
+{
+  vector <string> records, decoded;
+  RecordReader reader;
+  string chars, batch, record, message;
+  long long raw_bytes, sample_bytes, single_bytes;
+  double encode_rate, decode_rate, start, elapsed;
+  unsigned int seed;
+  size_t i, j, samples, fetches;
+  bool ok;
+
+  chars = bench_input(filenames);
+  for (i = 0; i < chars.length(); i = j + 1) {
+    for (j = i; j < chars.length() && chars[j] != '\n'; j++)
+      ;
+    records.push_back(chars.substr(i, j - i));
+  }
+
+  raw_bytes = 0;
+  for (i = 0; i < records.size(); i++)
+    raw_bytes += records[i].length();
+
+  // what the same records cost compressed one at a time (from a sample)
+
+  samples = min(records.size(), (size_t) 1000);
+  sample_bytes = single_bytes = 0;
+  for (i = 0; i < samples; i++) {
+    sample_bytes += records[i].length();
+    istringstream in(records[i]);
+    ostringstream out;
+    Huffman H;
+    H.compress_stream(in, out, true);
+    single_bytes += out.str().length();
+  }
+
+  if (!encode_records(records, batch) || !reader.open(batch, message)) {
+    outStream << "records: " << message << endl;
+    return false;
+  }
+  ok = reader.decode_all(decoded) && decoded == records;
+
+  encode_rate = time_kernel([&]() { encode_records(records, batch); }, records.size());
+  decode_rate = time_kernel([&]() { reader.decode_all(decoded); }, records.size());
+
+  // random single-record fetches
+
+  seed = 1;
+  fetches = 0;
+  start = now_microseconds();
+  do {
+    for (i = 0; i < 1000; i++) {
+      seed = seed * 1103515245 + 12345;
+      if (!reader.get((seed >> 8) % records.size(), record))
+        ok = false;
+    }
+    fetches += 1000;
+    elapsed = now_microseconds() - start;
+  } while (elapsed < 1e6 * BENCH_MIN_SECONDS);
+
+  outStream << fixed << setprecision(1);
+  outStream << "records: " << records.size() << " records, " << raw_bytes << " bytes, "
+            << (double) raw_bytes / records.size() << " bytes/record\n";
+  outStream << "  one batch:    " << batch.length() << " bytes (" << 100.0 * batch.length() / raw_bytes << "%)\n";
+  outStream << "  one by one:   " << (double) single_bytes / samples << " bytes/record (.huf, "
+            << 100.0 * single_bytes / max(1LL, sample_bytes) << "%)\n";
+  outStream << setprecision(0);
+  outStream << "  encode:       " << encode_rate * 1e6 << " records/s\n";
+  outStream << "  decode all:   " << decode_rate * 1e6 << " records/s\n";
+  outStream << setprecision(3);
+  outStream << "  random fetch: " << elapsed / fetches << " us/record\n";
+
+  if (!ok)
+    outStream << "MISMATCH: decoded records differ from the originals\n";
+
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+
+// one phase: run f for at least BENCH_MIN_SECONDS with the counters (if
+// any) running, and print one row, per run and per input byte
+
+template <class F> static void time_phase(const char *phase, F f, size_t bytes, PerfCounters *perf, ostream & outStream)
+{
+  double start, elapsed, per_byte;
+  long long runs, v;
+  int i;
+
+  if (perf != NULL)
+    perf->start();
+  start = now_microseconds();
+  runs = 0;
+  do {
+    f();
+    runs++;
+    elapsed = (now_microseconds() - start) / 1e6;
+  } while (elapsed < BENCH_MIN_SECONDS);
+  if (perf != NULL)
+    perf->stop();
+
+  per_byte = 1.0 / ((double) runs * bytes);
+
+  outStream << left << setw(8) << phase << right << fixed << setprecision(1)
+            << setw(10) << runs * (double) bytes / elapsed / 1e6;
+
+  if (perf == NULL) {
+    outStream << endl;
+    return;
+  }
+
+  for (i = 0; i < NUM_PERF_COUNTERS; i++) {
+    v = perf->value(i);
+    if (v < 0)
+      outStream << setw(14) << "-";
+    else
+      outStream << setw(14) << setprecision(3) << v * per_byte;
+  }
+  if (perf->value(PERF_CYCLES) > 0 && perf->value(PERF_INSTRUCTIONS) >= 0)
+    outStream << setw(8) << setprecision(2) << (double) perf->value(PERF_INSTRUCTIONS) / perf->value(PERF_CYCLES);
+  else
+    outStream << setw(8) << "-";
+  outStream << endl;
+}
+
+//----------------------------------------------------------------------------
+
+bool bench_phases(vector <string> & filenames, bool use_perf, int table_bits, ostream & outStream)
+{
+  PerfCounters *perf = NULL;
+  string chars, payload, decoded;
+  CodeTable T;
+  DecodeTable D;
+  Huffman H, built;
+  int i;
+
+  chars = bench_input(filenames);
+
+  H.compute_frequencies(chars.data(), chars.length());
+  H.build_code_table();
+  T.from_compression_map(H.compression_map);
+  T.limit_code_lengths(MAX_STREAM_CODE_LENGTH, H.char_counter);
+  if (!D.build(T, table_bits)) {
+    outStream << "phases: couldn't build a decode table\n";
+    return false;
+  }
+  bitpack().encode(chars.data(), chars.length(), &T.code_length[0], &T.code_bits[0], payload);
+  decoded.resize(chars.length());
+
+  outStream << "phases: " << chars.length() << " chars, " << bitpack().name << " kernels, "
+            << table_bits << "-bit decode table (" << D.entries.size() * sizeof(unsigned int) / 1024.0 << " KB)\n";
+
+  if (use_perf) {
+    perf = new PerfCounters();
+    if (!perf->why.empty())
+      outStream << "counters: " << perf->why << endl;
+    if (!perf->available()) {
+      delete perf;
+      perf = NULL;
+    }
+  }
+
+  outStream << left << setw(8) << "phase" << right << setw(10) << "MB/s";
+  if (perf != NULL) {
+    for (i = 0; i < NUM_PERF_COUNTERS; i++)
+      outStream << setw(14) << PerfCounters::name(i);
+    outStream << setw(8) << "IPC" << "   (counts per input byte)";
+  }
+  outStream << endl;
+
+  time_phase("histo", [&]() { H.reset(); H.compute_frequencies(chars.data(), chars.length()); },
+             chars.length(), perf, outStream);
+  time_phase("tree", [&]() { built.reset(); built.char_counter = H.char_counter; built.num_chars = H.num_chars;
+                             built.build_code_table(); },
+             chars.length(), perf, outStream);
+  time_phase("encode", [&]() { payload.clear();
+                               bitpack().encode(chars.data(), chars.length(), &T.code_length[0], &T.code_bits[0], payload); },
+             chars.length(), perf, outStream);
+  time_phase("decode", [&]() { bitpack().decode(&D.entries[0], D.primary_bits, (const unsigned char *) payload.data(),
+                                                payload.length(), &decoded[0], chars.length()); },
+             chars.length(), perf, outStream);
+
+  delete perf;
+
+  if (decoded != chars) {
+    outStream << "MISMATCH: decoded text differs from the input\n";
+    return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+bool bench_sync(vector <string> & filenames, int max_threads, ostream & outStream)
+{
+  SyncDecodeResult result;
+  istringstream chars_in;
+  ostringstream compressed, decoded;
+  string chars, data, out;
+  double start, rate, base_rate;
+  bool ok;
+  int t;
+
+  chars = bench_input(filenames);
+
+  Huffman H;
+  chars_in.str(chars);
+  H.compress_stream(chars_in, compressed, true);
+  data = compressed.str();
+
+  outStream << "sync: " << chars.length() << " chars, " << data.length() << " bytes as an old-style .huf file\n";
+
+  // the decoder decompress() used to have, run once
+
+  Huffman old;
+  istringstream data_in(data);
+  start = now_microseconds();
+  ok = old.decompress_stream(data_in, decoded, true) && decoded.str() == chars;
+  outStream << "string map decoder: " << fixed << setprecision(1)
+            << data.length() / (now_microseconds() - start) << " MB/s" << (ok ? "" : "  MISMATCH") << endl;
+
+  outStream << setw(8) << "threads" << setw(8) << "chunks" << setw(10) << "resynced" << setw(10) << "redecoded"
+            << setw(12) << "sync bits" << setw(10) << "MB/s" << setw(10) << "speedup" << endl;
+
+  base_rate = 0;
+  max_threads = max(1, max_threads);
+
+  for (t = 1; ; t = min(2 * t, max_threads)) {
+    result = SyncDecodeResult();
+    if (!sync_decode_legacy(data, out, t, result) || out != chars) {
+      outStream << setw(8) << t << "  MISMATCH: " << (result.ok ? "output differs from the original" : result.message) << endl;
+      ok = false;
+    }
+    else {
+      rate = time_kernel([&]() { SyncDecodeResult r; sync_decode_legacy(data, out, t, r); }, data.length());
+      if (t == 1)
+        base_rate = rate;
+      outStream << setw(8) << t << setw(8) << result.chunks << setw(10) << result.resynced << setw(10) << result.redecoded
+                << setw(12) << result.sync_bits << fixed << setprecision(1) << setw(10) << rate
+                << setprecision(2) << setw(10) << rate / base_rate << endl;
+    }
+
+    if (t == max_threads)
+      break;
+  }
+
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+
+// chars as BENCH_LATENCY_MESSAGE_CHARS-char messages, each flushed and then
+// read back on the decoder, which shares encoder's stream as the wire.
+// returns microseconds per message; messages is how many were sent
+
+template <class E, class D> static double message_latency(E & encoder, D & decoder, const string & chars, int & messages, bool & ok)
+{
+  double start;
+  size_t pos;
+  int i;
+
+  start = now_microseconds();
+  messages = 0;
+  for (pos = 0; pos + BENCH_LATENCY_MESSAGE_CHARS <= chars.length() && messages < BENCH_LATENCY_MESSAGES;
+       pos += BENCH_LATENCY_MESSAGE_CHARS) {
+    encoder.write(chars.data() + pos, BENCH_LATENCY_MESSAGE_CHARS);
+    encoder.flush();
+    for (i = 0; i < BENCH_LATENCY_MESSAGE_CHARS; i++)
+      if (decoder.get() != (unsigned char) chars[pos + i])
+        ok = false;
+    messages++;
+  }
+
+  return (now_microseconds() - start) / max(1, messages);
+}
+
+//----------------------------------------------------------------------------
+
+static void print_rate_row(ostream & outStream, const char *name, size_t bytes, size_t n, double encode_rate, double decode_rate)
+{
+  outStream << setw(14) << name << setw(12) << bytes << fixed << setprecision(1) << setw(8) << 100.0 * bytes / max((size_t) 1, n)
+            << setw(14) << encode_rate << setw(14) << decode_rate << endl;
+}
+
+//----------------------------------------------------------------------------
+
+bool bench_adaptive(vector <string> & filenames, int rescale_bits, ostream & outStream)
+{
+  SyncDecodeResult result;
+  string chars, legacy, stream, adaptive, out;
+  double encode_rate, decode_rate, start, two_pass_ms, latency;
+  int messages, rebuilds;
+  bool ok;
+
+  chars = bench_input(filenames);
+  ok = true;
+
+  outStream << "adaptive: " << chars.length() << " chars, rescaling at 2^" << rescale_bits << endl;
+  outStream << setw(14) << "" << setw(12) << "bytes" << setw(8) << "%" << setw(14) << "encode MB/s" << setw(14) << "decode MB/s" << endl;
+
+  // two passes and a table up front
+
+  encode_rate = time_kernel([&]() {
+      istringstream in(chars);
+      ostringstream compressed;
+      Huffman H;
+      H.compress_stream(in, compressed, true);
+      legacy = compressed.str();
+    }, chars.length());
+  ok = sync_decode_legacy(legacy, out, 1, result) && out == chars && ok;
+  decode_rate = time_kernel([&]() { SyncDecodeResult r; sync_decode_legacy(legacy, out, 1, r); }, chars.length());
+  print_rate_row(outStream, "two-pass", legacy.length(), chars.length(), encode_rate, decode_rate);
+
+  // a table per block
+
+  encode_rate = time_kernel([&]() {
+      ostringstream compressed;
+      StreamEncoder encoder(compressed);
+      encoder.write(chars.data(), chars.length());
+      encoder.finish();
+      stream = compressed.str();
+    }, chars.length());
+  decode_rate = time_kernel([&]() {
+      istringstream in(stream);
+      ostringstream decoded;
+      StreamDecoder decoder(in);
+      decoder.copy_to(decoded);
+      out = decoded.str();
+    }, chars.length());
+  ok = out == chars && ok;
+  print_rate_row(outStream, "block stream", stream.length(), chars.length(), encode_rate, decode_rate);
+
+  // no table at all
+
+  encode_rate = time_kernel([&]() {
+      ostringstream compressed;
+      AdaptiveEncoder encoder(compressed, rescale_bits);
+      encoder.write(chars.data(), chars.length());
+      encoder.finish();
+      adaptive = compressed.str();
+      rebuilds = encoder.tree.rebuilds;
+    }, chars.length());
+  decode_rate = time_kernel([&]() {
+      istringstream in(adaptive);
+      ostringstream decoded;
+      AdaptiveDecoder decoder(in);
+      decoder.copy_to(decoded);
+      out = decoded.str();
+    }, chars.length());
+  ok = out == chars && ok;
+  print_rate_row(outStream, "adaptive", adaptive.length(), chars.length(), encode_rate, decode_rate);
+  outStream << setw(14) << "" << "  (" << rebuilds << " rescales)\n";
+
+  // latency: each message flushed and decoded before the next
+
+  outStream << BENCH_LATENCY_MESSAGE_CHARS << "-char messages, each flushed:\n";
+  outStream << setw(14) << "" << setw(12) << "bytes/msg" << setw(12) << "us/msg" << endl;
+  {
+    stringstream wire;
+    StreamEncoder encoder(wire);
+    StreamDecoder decoder(wire);
+    latency = message_latency(encoder, decoder, chars, messages, ok);
+    outStream << setw(14) << "block stream" << fixed << setprecision(1) << setw(12) << (double) encoder.bytes_out / max(1, messages)
+              << setprecision(2) << setw(12) << latency << endl;
+  }
+  {
+    stringstream wire;
+    AdaptiveEncoder encoder(wire, rescale_bits);
+    AdaptiveDecoder decoder(wire);
+    latency = message_latency(encoder, decoder, chars, messages, ok);
+    outStream << setw(14) << "adaptive" << fixed << setprecision(1) << setw(12) << (double) encoder.bytes_out / max(1, messages)
+              << setprecision(2) << setw(12) << latency << endl;
+  }
+
+  start = now_microseconds();
+  {
+    istringstream in(chars);
+    ostringstream compressed;
+    Huffman H;
+    H.compress_stream(in, compressed, true);
+  }
+  two_pass_ms = (now_microseconds() - start) / 1000;
+  outStream << setw(14) << "two-pass" << "  nothing until all " << chars.length() << " chars are in, then "
+            << setprecision(1) << two_pass_ms << " ms to compress them\n";
+
+  if (!ok)
+    outStream << "MISMATCH: decoded chars differ from the originals\n";
+
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
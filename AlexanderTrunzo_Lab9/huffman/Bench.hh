@@ -0,0 +1,91 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// micro-benchmarks for the codec's inner loops
+//----------------------------------------------------------------------------
+
+#ifndef BENCH_HH
+#define BENCH_HH
+
+#include "Huffman.hh"
+#include "Protocol.hh"
+
+//----------------------------------------------------------------------------
+
+#define BENCH_MIN_SECONDS              0.25    // run each kernel at least this long
+#define BENCH_SYNTHETIC_CHARS          (4 * 1024 * 1024)
+#define BENCH_MESSAGE_CHARS            256     // size of each payload in the stress test
+#define BENCH_LATENCY_MESSAGE_CHARS    64      // size of each flushed message in the adaptive test
+#define BENCH_LATENCY_MESSAGES         20000
+
+//----------------------------------------------------------------------------
+
+// the chars of the given files (bad chars dropped, as compress() would),
+// or synthetic text if there are none
+
+string bench_input(vector <string> &);
+
+// run f over and over for at least min_seconds; returns MB/s given the
+// bytes one run processes
+
+template <class F> double time_kernel(F f, size_t bytes, double min_seconds = BENCH_MIN_SECONDS)
+{
+  double start, elapsed;
+  long long runs;
+
+  start = now_microseconds();
+  runs = 0;
+  do {
+    f();
+    runs++;
+    elapsed = (now_microseconds() - start) / 1e6;
+  } while (elapsed < min_seconds);
+
+  return runs * (double) bytes / elapsed / 1e6;
+}
+
+// "kernels": MB/s of every bit packing kernel on each target this machine
+// supports, after checking that all targets give identical results
+
+bool bench_kernels(vector <string> &, ostream &);
+
+// "stress": the input cut into small messages, all coded with one shared
+// CodeBook, decoded over and over on 1, 2, 4 ... up to the given number
+// of threads at once.  every decode is checked, and messages/s, MB/s and
+// the speedup over one thread are printed
+
+bool bench_stress(vector <string> &, int, ostream &);
+
+// "records": every line of the input as a record, in one batch.  size
+// against compressing records one by one, batch encode and decode rates,
+// and the time to fetch one record at random
+
+bool bench_records(vector <string> &, ostream &);
+
+// "phases": the codec split into histogram, tree (code table) build,
+// encode and decode, each timed on its own.  with perf, hardware counters
+// are read around each phase as well (see PerfCounters.hh); the decode
+// table is built with the given number of primary bits
+
+bool bench_phases(vector <string> &, bool, int, ostream &);
+
+// "sync": the input compressed as an old-style .huf file, decoded once
+// the old way (string map) and then by sync_decode_legacy() on 1, 2, 4
+// ... up to the given number of threads, with how many chunks had to
+// catch up or be decoded again.  every decode is checked against the
+// original
+
+bool bench_sync(vector <string> &, int, ostream &);
+
+// "adaptive": the one-pass adaptive coder (see Adaptive.hh), rescaling at
+// the given bits, against the two-pass old-style coder and the block
+// stream.  size, encode and decode MB/s of the whole input, then small
+// messages each flushed and decoded on the spot: bytes and microseconds
+// per message.  the two-pass coder can't send anything until it has seen
+// all the input, so its latency is the time to compress the lot
+
+bool bench_adaptive(vector <string> &, int, ostream &);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,138 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// bit-level output and input on memory buffers
+//----------------------------------------------------------------------------
+
+#ifndef BITIO_HH
+#define BITIO_HH
+
+#include <string>
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+
+// bits are packed MSB first, the same order compress() uses when it turns
+// its queue of '0'/'1' characters into bytes, so a code's first bit is the
+// high bit of its byte.  both classes keep up to 64 bits in a register
+// instead of going through strings
+
+class BitWriter
+{
+public:
+
+  BitWriter(string & out) : output(out) { bits = 0; count = 0; total_bits = 0; }
+
+  // append the low len bits of code (len <= 32)
+
+  inline void put(unsigned int code, int len)
+  {
+    bits = (bits << len) | code;
+    count += len;
+    total_bits += len;
+    while (count >= 8) {
+      count -= 8;
+      output += (char) (bits >> count);
+    }
+  }
+
+  // pad the last partial byte with 0's on the right
+
+  void flush()
+  {
+    if (count > 0) {
+      output += (char) (bits << (8 - count));
+      count = 0;
+    }
+  }
+
+  long long total_bits;      // bits put so far, not counting padding
+
+private:
+
+  string & output;
+  unsigned long long bits;   // pending bits, right-justified
+  int count;                 // how many of them
+};
+
+//----------------------------------------------------------------------------
+
+// reads past the end of the buffer as 0 bits; callers that care compare
+// bits_consumed() against the real length
+
+class BitReader
+{
+public:
+
+  BitReader(const unsigned char *data, size_t len)
+  {
+    pos = data;
+    end = data + len;
+    bits = 0;
+    count = 0;
+    consumed = 0;
+  }
+
+  // top up the register to at least 57 bits
+
+  inline void refill()
+  {
+    while (count <= 56) {
+      if (pos < end)
+        bits |= (unsigned long long) *pos++ << (56 - count);
+      count += 8;
+    }
+  }
+
+  // next n bits (1 <= n <= 32) without consuming them.  call refill() first
+
+  inline unsigned int peek(int n) { return (unsigned int) (bits >> (64 - n)); }
+
+  inline void consume(int n)
+  {
+    bits <<= n;
+    count -= n;
+    consumed += n;
+  }
+
+  inline unsigned int get(int n)
+  {
+    unsigned int value;
+
+    refill();
+    value = peek(n);
+    consume(n);
+    return value;
+  }
+
+  long long bits_consumed() { return consumed; }
+
+private:
+
+  const unsigned char *pos, *end;
+  unsigned long long bits;   // next bits of input, left-justified
+  int count;                 // how many of them are valid
+  long long consumed;
+};
+
+//----------------------------------------------------------------------------
+
+// little-endian integers in headers
+
+inline void append_u32(string & out, unsigned int value)
+{
+  out += (char) (value & 0xff);
+  out += (char) ((value >> 8) & 0xff);
+  out += (char) ((value >> 16) & 0xff);
+  out += (char) ((value >> 24) & 0xff);
+}
+
+inline unsigned int read_u32(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,424 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// bit packing kernels with run-time CPU dispatch
+//----------------------------------------------------------------------------
+
+#include "BitPack.hh"
+#include "CodeTable.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BITPACK_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+//----------------------------------------------------------------------------
+
+#define ASCII_ZEROS                    0x3030303030303030ULL   // eight '0's
+#define LOW_BIT_OF_EACH_BYTE           0x0101010101010101ULL
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// scalar
+
+static void pack_ascii_scalar(const char *bits, size_t n, unsigned char *out)
+{
+  unsigned int b;
+  size_t i;
+  int j;
+
+  for (i = 0; i < n; i++, bits += 8) {
+    b = 0;
+    for (j = 0; j < 8; j++)
+      b = (b << 1) | (bits[j] == '1');
+    out[i] = b;
+  }
+}
+
+static void unpack_ascii_scalar(const unsigned char *in, size_t n, char *bits)
+{
+  size_t i;
+  int j;
+
+  for (i = 0; i < n; i++, bits += 8)
+    for (j = 0; j < 8; j++)
+      bits[j] = (in[i] >> (7 - j)) & 1 ? '1' : '0';
+}
+
+// chars that are all '0' or '1' differ from eight '0's only in the low
+// bit of each byte
+
+static inline __attribute__((always_inline)) size_t check_ascii_loop(const char *bits, size_t n)
+{
+  unsigned long long w;
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    memcpy(&w, bits + i, 8);
+    if ((w ^ ASCII_ZEROS) & ~LOW_BIT_OF_EACH_BYTE)
+      break;
+  }
+
+  for (; i < n; i++)
+    if (bits[i] != '0' && bits[i] != '1')
+      return i;
+
+  return n;
+}
+
+static size_t check_ascii_scalar(const char *bits, size_t n)
+{
+  return check_ascii_loop(bits, n);
+}
+
+//----------------------------------------------------------------------------
+
+// the encode and decode loops are written once and instantiated per
+// target below; everything here inlines into its caller, so the compiler
+// generates code for the caller's instruction set
+
+static inline __attribute__((always_inline)) void store_u32_msb_first(unsigned char *p, unsigned int w)
+{
+  w = __builtin_bswap32(w);
+  memcpy(p, &w, 4);
+}
+
+static inline __attribute__((always_inline))
+long long encode_loop(const char *data, size_t n, const int *code_length, const unsigned int *code_bits, string & out)
+{
+  unsigned long long bits;
+  unsigned char *p, *start;
+  long long total;
+  size_t i, base;
+  int c, len, count;
+
+  // codes are at most 32 bits, so 4 bytes per char is always enough
+
+  base = out.size();
+  out.resize(base + 4 * n + 8);
+  start = p = (unsigned char *) &out[base];
+
+  bits = 0;
+  count = 0;
+  total = 0;
+
+  for (i = 0; i < n; i++) {
+    c = (unsigned char) data[i];
+    len = code_length[c];
+    bits = (bits << len) | code_bits[c];
+    count += len;
+    if (count >= 32) {
+      count -= 32;
+      store_u32_msb_first(p, (unsigned int) (bits >> count));
+      p += 4;
+      total += 32;
+    }
+  }
+
+  // last partial word, padded with 0's on the right to a whole byte
+
+  total += count;
+  if (count > 0)
+    bits <<= 64 - count;
+  while (count > 0) {
+    *p++ = (unsigned char) (bits >> 56);
+    bits <<= 8;
+    count -= 8;
+  }
+
+  out.resize(base + (p - start));
+
+  return total;
+}
+
+// the register holds the next input bits left-justified.  while 8 bytes
+// remain, refill with one unaligned load: bytes already partly in the
+// register are loaded again, which is harmless since they're OR'd into
+// the same positions
+
+static inline __attribute__((always_inline))
+long long decode_loop(const unsigned int *entries, int primary_bits,
+                      const unsigned char *payload, size_t payload_length, char *out, size_t n)
+{
+  const unsigned char *pos, *end;
+  unsigned long long bits, w;
+  unsigned int e;
+  long long consumed;
+  size_t i;
+  int count, len;
+
+  pos = payload;
+  end = payload + payload_length;
+  bits = 0;
+  count = 0;
+  consumed = 0;
+
+  for (i = 0; i < n; i++) {
+
+    if (end - pos >= 8) {
+      memcpy(&w, pos, 8);
+      bits |= __builtin_bswap64(w) >> count;
+      pos += (63 - count) >> 3;
+      count |= 56;
+    }
+    else
+      while (count <= 56) {
+        if (pos < end)
+          bits |= (unsigned long long) *pos++ << (56 - count);
+        count += 8;
+      }
+
+    e = entries[bits >> (64 - primary_bits)];
+    if (e & DECODE_LINK) {
+      bits <<= primary_bits;
+      count -= primary_bits;
+      consumed += primary_bits;
+      e = entries[(e >> 8) + (unsigned int) (bits >> (64 - (e & DECODE_LENGTH_MASK)))];
+    }
+
+    len = e & DECODE_LENGTH_MASK;
+    if (len == 0)
+      return -1;
+    bits <<= len;
+    count -= len;
+    consumed += len;
+    out[i] = (char) (e >> 8);
+  }
+
+  return consumed;
+}
+
+//----------------------------------------------------------------------------
+
+static long long encode_scalar(const char *data, size_t n, const int *code_length, const unsigned int *code_bits, string & out)
+{
+  return encode_loop(data, n, code_length, code_bits, out);
+}
+
+static long long decode_scalar(const unsigned int *entries, int primary_bits,
+                               const unsigned char *payload, size_t payload_length, char *out, size_t n)
+{
+  return decode_loop(entries, primary_bits, payload, payload_length, out, n);
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#ifdef BITPACK_X86
+
+// BMI2: pext gathers the low bit of each of 8 chars into a byte, pdep
+// spreads a byte back out.  the byte swap puts the first char in the high
+// bit, to match the MSB-first order
+
+__attribute__((target("bmi2")))
+static void pack_ascii_bmi2(const char *bits, size_t n, unsigned char *out)
+{
+  unsigned long long w;
+  size_t i;
+
+  for (i = 0; i < n; i++, bits += 8) {
+    memcpy(&w, bits, 8);
+    out[i] = (unsigned char) _pext_u64(__builtin_bswap64(w), LOW_BIT_OF_EACH_BYTE);
+  }
+}
+
+__attribute__((target("bmi2")))
+static void unpack_ascii_bmi2(const unsigned char *in, size_t n, char *bits)
+{
+  unsigned long long w;
+  size_t i;
+
+  for (i = 0; i < n; i++, bits += 8) {
+    w = __builtin_bswap64(_pdep_u64(in[i], LOW_BIT_OF_EACH_BYTE)) | ASCII_ZEROS;
+    memcpy(bits, &w, 8);
+  }
+}
+
+__attribute__((target("bmi2")))
+static size_t check_ascii_bmi2(const char *bits, size_t n)
+{
+  return check_ascii_loop(bits, n);
+}
+
+__attribute__((target("bmi2")))
+static long long encode_bmi2(const char *data, size_t n, const int *code_length, const unsigned int *code_bits, string & out)
+{
+  return encode_loop(data, n, code_length, code_bits, out);
+}
+
+__attribute__((target("bmi2")))
+static long long decode_bmi2(const unsigned int *entries, int primary_bits,
+                             const unsigned char *payload, size_t payload_length, char *out, size_t n)
+{
+  return decode_loop(entries, primary_bits, payload, payload_length, out, n);
+}
+
+//----------------------------------------------------------------------------
+
+// AVX2, 32 chars <-> 4 bytes per step.  packing: reverse each group of 8
+// chars, compare with '1', and movemask.  unpacking: copy each byte to 8
+// lanes, test one bit per lane, and turn all-ones lanes into '1'.
+// checking: compare with '0' and '1', and movemask the two together
+
+__attribute__((target("avx2")))
+static void pack_ascii_avx2(const char *bits, size_t n, unsigned char *out)
+{
+  const __m256i reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                           7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  const __m256i ones = _mm256_set1_epi8('1');
+  __m256i v;
+  unsigned int m;
+  size_t i;
+
+  for (i = 0; i + 4 <= n; i += 4, bits += 32) {
+    v = _mm256_loadu_si256((const __m256i *) bits);
+    v = _mm256_cmpeq_epi8(_mm256_shuffle_epi8(v, reverse), ones);
+    m = _mm256_movemask_epi8(v);
+    memcpy(out + i, &m, 4);
+  }
+
+  pack_ascii_scalar(bits, n - i, out + i);
+}
+
+__attribute__((target("avx2")))
+static size_t check_ascii_avx2(const char *bits, size_t n)
+{
+  const __m256i zeros = _mm256_set1_epi8('0');
+  const __m256i ones = _mm256_set1_epi8('1');
+  __m256i v;
+  unsigned int m;
+  size_t i;
+
+  for (i = 0; i + 32 <= n; i += 32) {
+    v = _mm256_loadu_si256((const __m256i *) (bits + i));
+    m = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, zeros), _mm256_cmpeq_epi8(v, ones)));
+    if (m != 0xffffffff)
+      return i + __builtin_ctz(~m);
+  }
+
+  return i + check_ascii_loop(bits + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void unpack_ascii_avx2(const unsigned char *in, size_t n, char *bits)
+{
+  const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                          2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+  const __m256i bit_of_lane = _mm256_set1_epi64x(0x0102040810204080LL);
+  const __m256i zeros = _mm256_set1_epi8('0');
+  __m256i v;
+  unsigned int w;
+  size_t i;
+
+  for (i = 0; i + 4 <= n; i += 4, bits += 32) {
+    memcpy(&w, in + i, 4);
+    v = _mm256_shuffle_epi8(_mm256_set1_epi32(w), spread);
+    v = _mm256_cmpeq_epi8(_mm256_and_si256(v, bit_of_lane), bit_of_lane);
+    _mm256_storeu_si256((__m256i *) bits, _mm256_sub_epi8(zeros, v));
+  }
+
+  unpack_ascii_scalar(in + i, n - i, bits);
+}
+
+//----------------------------------------------------------------------------
+
+// leaf 7 has BMI2 and AVX2; AVX2 also needs the OS to save the ymm
+// registers (OSXSAVE, and XCR0 bits 1-2)
+
+static void cpu_features(bool & has_bmi2, bool & has_avx2)
+{
+  unsigned int eax, ebx, ecx, edx, xcr0_low, xcr0_high;
+  bool os_avx;
+
+  has_bmi2 = has_avx2 = false;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return;
+  os_avx = false;
+  if (ecx & bit_OSXSAVE) {
+    __asm__("xgetbv" : "=a" (xcr0_low), "=d" (xcr0_high) : "c" (0));
+    os_avx = (xcr0_low & 6) == 6;
+  }
+
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    return;
+  has_bmi2 = (ebx & bit_BMI2) != 0;
+  has_avx2 = has_bmi2 && os_avx && (ebx & bit_AVX2) != 0;
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+static BitPackKernels scalar_kernels = { "scalar", pack_ascii_scalar, unpack_ascii_scalar, check_ascii_scalar, encode_scalar, decode_scalar };
+
+#ifdef BITPACK_X86
+static BitPackKernels bmi2_kernels = { "bmi2", pack_ascii_bmi2, unpack_ascii_bmi2, check_ascii_bmi2, encode_bmi2, decode_bmi2 };
+static BitPackKernels avx2_kernels = { "avx2", pack_ascii_avx2, unpack_ascii_avx2, check_ascii_avx2, encode_bmi2, decode_bmi2 };
+#endif
+
+static BitPackKernels *selected = NULL;
+
+//----------------------------------------------------------------------------
+
+// every target this machine can run, slowest first
+
+vector <BitPackKernels *> bitpack_targets()
+{
+  vector <BitPackKernels *> targets;
+
+  targets.push_back(&scalar_kernels);
+
+#ifdef BITPACK_X86
+  bool has_bmi2, has_avx2;
+
+  cpu_features(has_bmi2, has_avx2);
+  if (has_bmi2)
+    targets.push_back(&bmi2_kernels);
+  if (has_avx2)
+    targets.push_back(&avx2_kernels);
+#endif
+
+  return targets;
+}
+
+//----------------------------------------------------------------------------
+
+// force a target by name (e.g. to compare them); false if this machine
+// can't run it
+
+bool bitpack_select(string name)
+{
+  vector <BitPackKernels *> targets;
+  int i;
+
+  targets = bitpack_targets();
+  for (i = 0; i < targets.size(); i++)
+    if (name == targets[i]->name) {
+      selected = targets[i];
+      return true;
+    }
+
+  return false;
+}
+
+//----------------------------------------------------------------------------
+
+// the chosen kernels, picking the fastest supported target on first use
+
+static BitPackKernels *best_target()
+{
+  return bitpack_targets().back();
+}
+
+BitPackKernels & bitpack()
+{
+  static BitPackKernels *best = best_target();
+
+  return selected != NULL ? *selected : *best;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,58 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// bit packing kernels with run-time CPU dispatch
+//----------------------------------------------------------------------------
+
+#ifndef BITPACK_HH
+#define BITPACK_HH
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+
+// the inner loops that move bits around, in one version per instruction
+// set.  the whole program is built for the baseline x86-64 (or whatever
+// the host is), and only these functions are compiled with BMI2 or AVX2
+// enabled; CPUID picks the best version the machine has the first time
+// bitpack() is called, so one binary runs everywhere.
+//
+//   pack_ascii    8n '0'/'1' chars -> n bytes, first char in the high bit
+//   unpack_ascii  n bytes -> 8n '0'/'1' chars
+//   check_ascii   offset of the first of n chars that isn't '0' or '1',
+//                 or n if they all are
+//   encode        n chars -> MSB-first payload appended to a string, given
+//                 per-char code lengths and codes (length 0: skip the char).
+//                 returns the number of bits, not counting padding
+//   decode        n chars from a payload with a DecodeTable's entries.
+//                 returns the bits consumed, or -1 on an invalid code
+//
+// scalar is plain C++.  bmi2 builds the same encode/decode loops with BMI2
+// on, so variable shifts become shlx/shrx and masks bzhi, and uses
+// pext/pdep for pack/unpack.  both check 8 chars at a time in a 64-bit
+// word.  avx2 adds 32-chars-at-a-time pack/unpack/check (compares,
+// movemask and byte shuffles) on top of the bmi2 encode/decode
+
+class BitPackKernels
+{
+public:
+  const char *name;
+  void (*pack_ascii)(const char *, size_t, unsigned char *);
+  void (*unpack_ascii)(const unsigned char *, size_t, char *);
+  size_t (*check_ascii)(const char *, size_t);
+  long long (*encode)(const char *, size_t, const int *, const unsigned int *, string &);
+  long long (*decode)(const unsigned int *, int, const unsigned char *, size_t, char *, size_t);
+};
+
+//----------------------------------------------------------------------------
+
+BitPackKernels & bitpack();
+bool bitpack_select(string);
+vector <BitPackKernels *> bitpack_targets();
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,210 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// choosing block boundaries where the char statistics change
+//----------------------------------------------------------------------------
+
+#include "BlockSplit.hh"
+#include <cmath>
+
+//----------------------------------------------------------------------------
+
+// per-level settings: segment size, boundary refinement step
+
+static const int level_segment[SPLIT_MAX_LEVEL + 1] = { 0, 32768, 16384, 16384, 8192, 8192, 4096, 4096, 2048, 1024 };
+static const int level_refine[SPLIT_MAX_LEVEL + 1]  = { 0, 0, 0, 2048, 0, 1024, 0, 512, 256, 128 };
+
+//----------------------------------------------------------------------------
+
+// a candidate block.  blocks that have been merged away are unlinked from
+// the next/prev chain rather than erased, so a merge doesn't move the rest
+
+class SplitBlock
+{
+public:
+  size_t start, end;
+  long long counts[NUM_ASCII];
+  double bits;               // estimated_block_bits(counts)
+  double merge_gain;         // bits saved by merging with the next block, <= 0: don't
+  int prev, next;            // -1 at either end
+};
+
+//----------------------------------------------------------------------------
+
+// chars the stream encoder drops (see Huffman::is_bad_ascii_code) are
+// counted but cost nothing
+
+static bool is_coded_char(int c)
+{
+  return c == ASCII_TAB || c == ASCII_NEWLINE || (c >= ASCII_FIRST_PRINTING && c < NUM_ASCII);
+}
+
+static void add_chars(long long *counts, const char *data, size_t n, int sign)
+{
+  size_t i;
+  int c;
+
+  for (i = 0; i < n; i++) {
+    c = (unsigned char) data[i];
+    if (c < NUM_ASCII)
+      counts[c] += sign;
+  }
+}
+
+//----------------------------------------------------------------------------
+
+// header bits plus sum of -log2(p) over the chars.  a one-char block still
+// spends a bit per char
+
+double estimated_block_bits(const long long *counts)
+{
+  double n, sum;
+  int c, distinct;
+
+  n = sum = 0;
+  distinct = 0;
+  for (c = 0; c < NUM_ASCII; c++)
+    if (counts[c] > 0 && is_coded_char(c)) {
+      n += counts[c];
+      sum += counts[c] * log2((double) counts[c]);
+      distinct++;
+    }
+
+  return 8.0 * (SPLIT_FIXED_HEADER_BYTES + 2 * distinct) + (distinct == 1 ? n : n * log2(n) - sum);
+}
+
+//----------------------------------------------------------------------------
+
+static double merged_bits(SplitBlock & a, SplitBlock & b)
+{
+  long long counts[NUM_ASCII];
+  int c;
+
+  for (c = 0; c < NUM_ASCII; c++)
+    counts[c] = a.counts[c] + b.counts[c];
+
+  return estimated_block_bits(counts);
+}
+
+static void update_merge_gain(vector <SplitBlock> & blocks, int i, size_t max_block)
+{
+  SplitBlock & a = blocks[i];
+
+  if (a.next < 0 || blocks[a.next].end - a.start > max_block)
+    a.merge_gain = 0;
+  else
+    a.merge_gain = a.bits + blocks[a.next].bits - merged_bits(a, blocks[a.next]);
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+BlockSplitter::BlockSplitter(int lev)
+{
+  level = max(SPLIT_MIN_LEVEL, min(SPLIT_MAX_LEVEL, lev));
+  segment_size = level_segment[level];
+  refine_step = level_refine[level];
+}
+
+//----------------------------------------------------------------------------
+
+// choose blocks for data[0..n), none longer than max_block.  ends gets the
+// end offset of each block, so the last entry is n
+
+void BlockSplitter::split(const char *data, size_t n, size_t max_block, vector <size_t> & ends)
+{
+  vector <SplitBlock> blocks;
+  size_t start, p, lo, hi, best_p;
+  double bits, best_bits;
+  int i, j, best;
+
+  ends.clear();
+  if (n <= segment_size || max_block <= segment_size) {
+    for (start = 0; start < n; start += max_block)
+      ends.push_back(min(n, start + max_block));
+    return;
+  }
+
+  // one block per segment
+
+  blocks.resize((n + segment_size - 1) / segment_size);
+  for (i = 0; i < blocks.size(); i++) {
+    SplitBlock & b = blocks[i];
+    b.start = (size_t) i * segment_size;
+    b.end = min(n, b.start + segment_size);
+    memset(b.counts, 0, sizeof(b.counts));
+    add_chars(b.counts, data + b.start, b.end - b.start, 1);
+    b.bits = estimated_block_bits(b.counts);
+    b.prev = i - 1;
+    b.next = i + 1 < blocks.size() ? i + 1 : -1;
+  }
+  for (i = 0; i < blocks.size(); i++)
+    update_merge_gain(blocks, i, max_block);
+
+  // merge the best pair until nothing is gained
+
+  while (true) {
+    best = -1;
+    for (i = 0; i >= 0; i = blocks[i].next)
+      if (blocks[i].merge_gain > 0 && (best < 0 || blocks[i].merge_gain > blocks[best].merge_gain))
+        best = i;
+    if (best < 0)
+      break;
+
+    SplitBlock & a = blocks[best];
+    SplitBlock & b = blocks[a.next];
+    for (j = 0; j < NUM_ASCII; j++)
+      a.counts[j] += b.counts[j];
+    a.bits -= a.merge_gain - b.bits;
+    a.end = b.end;
+    a.next = b.next;
+    if (a.next >= 0)
+      blocks[a.next].prev = best;
+
+    update_merge_gain(blocks, best, max_block);
+    if (a.prev >= 0)
+      update_merge_gain(blocks, a.prev, max_block);
+  }
+
+  // slide each boundary up to a segment either way, refine_step at a time.
+  // the chars between the old and new boundary change sides
+
+  for (i = 0; refine_step > 0 && blocks[i].next >= 0; i = blocks[i].next) {
+    SplitBlock & a = blocks[i];
+    SplitBlock & b = blocks[a.next];
+
+    p = a.end;
+    lo = p;
+    while (lo - a.start > refine_step && p - lo < segment_size && b.end - (lo - refine_step) <= max_block)
+      lo -= refine_step;
+    hi = p;
+    while (b.end - hi > refine_step && hi - p < segment_size && hi + refine_step - a.start <= max_block)
+      hi += refine_step;
+
+    add_chars(a.counts, data + lo, p - lo, -1);
+    add_chars(b.counts, data + lo, p - lo, 1);
+    best_p = lo;
+    best_bits = estimated_block_bits(a.counts) + estimated_block_bits(b.counts);
+
+    for (p = lo; p < hi; p += refine_step) {
+      add_chars(a.counts, data + p, refine_step, 1);
+      add_chars(b.counts, data + p, refine_step, -1);
+      bits = estimated_block_bits(a.counts) + estimated_block_bits(b.counts);
+      if (bits < best_bits) {
+        best_bits = bits;
+        best_p = p + refine_step;
+      }
+    }
+
+    add_chars(a.counts, data + best_p, hi - best_p, -1);
+    add_chars(b.counts, data + best_p, hi - best_p, 1);
+    a.end = b.start = best_p;
+    a.bits = estimated_block_bits(a.counts);
+    b.bits = estimated_block_bits(b.counts);
+  }
+
+  for (i = 0; i >= 0; i = blocks[i].next)
+    ends.push_back(blocks[i].end);
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,58 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// choosing block boundaries where the char statistics change
+//----------------------------------------------------------------------------
+
+#ifndef BLOCKSPLIT_HH
+#define BLOCKSPLIT_HH
+
+#include "Huffman.hh"
+
+//----------------------------------------------------------------------------
+
+#define SPLIT_MIN_LEVEL                1
+#define SPLIT_MAX_LEVEL                9
+#define DEFAULT_SPLIT_LEVEL            5
+#define DEFAULT_SPLIT_BLOCK_SIZE       (512 * 1024)   // largest block the splitter will make
+#define SPLIT_FIXED_HEADER_BYTES       14      // a BLOCK_HUFFMAN_CRC header without its table
+
+//----------------------------------------------------------------------------
+
+// fixed-size blocks pay for a table every block_size chars whether the
+// text changes or not, and a block that straddles a change (prose, then a
+// table of numbers) gets one table that fits neither half.  the splitter
+// cuts a run of input into segments, then repeatedly merges the pair of
+// neighbouring blocks whose merge saves the most estimated bits, until no
+// merge saves anything.  a block's estimated size is its header (fixed
+// part + 2 bytes per coded char) plus the entropy of its char counts, so
+// merging pays off exactly when the shared table costs less than the
+// second header.  at higher levels each boundary is then slid back and
+// forth in smaller steps to where the two blocks on either side are
+// cheapest, which only needs the chars that cross the boundary added to
+// one histogram and taken out of the other.
+//
+// level trades time for ratio: smaller segments find changes more
+// precisely but mean more merging
+//
+//   level     1    2    3    4    5    6    7    8    9
+//   segment  32K  16K  16K   8K   8K   4K   4K   2K   1K
+//   refine    -    -   2K    -   1K    -   512  256  128
+
+class BlockSplitter
+{
+public:
+
+  BlockSplitter(int = DEFAULT_SPLIT_LEVEL);
+  void split(const char *, size_t, size_t, vector <size_t> &);
+
+  int level;
+  int segment_size;          // smallest block considered
+  int refine_step;           // 0: boundaries stay on segment edges
+};
+
+double estimated_block_bits(const long long *);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,74 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// CRC-32 (the zlib/gzip polynomial) for detecting corrupt blocks
+//----------------------------------------------------------------------------
+
+#include "Checksum.hh"
+
+//----------------------------------------------------------------------------
+
+#define CRC32_POLYNOMIAL               0xEDB88320u   // reflected
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// slicing-by-8: table[k][b] is the crc of byte b followed by k zero bytes,
+// so 8 input bytes are folded in with 8 independent lookups
+
+static unsigned int crc_table[8][256];
+static bool crc_table_ready = false;
+
+static void make_crc_table()
+{
+  unsigned int c;
+  int i, j, k;
+
+  for (i = 0; i < 256; i++) {
+    c = i;
+    for (j = 0; j < 8; j++)
+      c = (c & 1) ? (c >> 1) ^ CRC32_POLYNOMIAL : c >> 1;
+    crc_table[0][i] = c;
+  }
+
+  for (i = 0; i < 256; i++)
+    for (k = 1; k < 8; k++)
+      crc_table[k][i] = (crc_table[k - 1][i] >> 8) ^ crc_table[0][crc_table[k - 1][i] & 0xff];
+
+  crc_table_ready = true;
+}
+
+// tables are filled before main() runs, so threads never race on them
+
+static struct CrcTableInit { CrcTableInit() { make_crc_table(); } } crc_table_init;
+
+//----------------------------------------------------------------------------
+
+unsigned int crc32_update(unsigned int crc, const char *data, size_t n)
+{
+  const unsigned char *p = (const unsigned char *) data;
+  unsigned int lo, hi;
+
+  if (!crc_table_ready)
+    make_crc_table();
+
+  crc = ~crc;
+
+  while (n >= 8) {
+    lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24));
+    hi = p[4] | (p[5] << 8) | (p[6] << 16) | ((unsigned int) p[7] << 24);
+    crc = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^
+          crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24] ^
+          crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff] ^
+          crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+    p += 8;
+    n -= 8;
+  }
+
+  while (n-- > 0)
+    crc = crc_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+  return ~crc;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
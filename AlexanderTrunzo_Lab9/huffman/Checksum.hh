@@ -0,0 +1,20 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// CRC-32 (the zlib/gzip polynomial) for detecting corrupt blocks
+//----------------------------------------------------------------------------
+
+#ifndef CHECKSUM_HH
+#define CHECKSUM_HH
+
+#include <stddef.h>
+
+//----------------------------------------------------------------------------
+
+// crc is the running value: start with 0 and feed successive pieces
+
+unsigned int crc32_update(unsigned int, const char *, size_t);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,105 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// immutable code tables that any number of threads can share
+//----------------------------------------------------------------------------
+
+#include "CodeBook.hh"
+#include "BitPack.hh"
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// a code for every char with a nonzero count (counts may cover all 256
+// byte values, not just NUM_ASCII).  returns NULL if the code
+// can't be decoded with a table (which shouldn't happen for a Huffman code)
+
+CodeBookPtr CodeBook::from_counts(vector <int> & counts, int max_len, int bits)
+{
+  CodeBook *B;
+
+  B = new CodeBook();
+  B->T = CodeTable(max((int) counts.size(), NUM_ASCII));
+  B->T.from_counts(counts, max_len);
+  if (!B->finish(bits)) {
+    delete B;
+    return CodeBookPtr();
+  }
+
+  return CodeBookPtr(B);
+}
+
+//----------------------------------------------------------------------------
+
+// a copy of an existing table (e.g. from a TableCache or a file header)
+
+CodeBookPtr CodeBook::from_table(const CodeTable & table, int bits)
+{
+  CodeBook *B;
+
+  B = new CodeBook();
+  B->T = table;
+  if (!B->finish(bits)) {
+    delete B;
+    return CodeBookPtr();
+  }
+
+  return CodeBookPtr(B);
+}
+
+//----------------------------------------------------------------------------
+
+// everything derived from T is computed here, before the CodeBook is
+// shared, and never touched again
+
+bool CodeBook::finish(int bits)
+{
+  int c;
+
+  if (!D.build(T, bits))
+    return false;
+
+  lengths.assign(256, 0);
+  codes.assign(256, 0);
+  for (c = 0; c < T.num_symbols && c < 256; c++) {
+    lengths[c] = T.code_length[c];
+    codes[c] = T.code_bits[c];
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+bool CodeBook::covers(const char *data, size_t n) const
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    if (lengths[(unsigned char) data[i]] == 0)
+      return false;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+long long CodeBook::encode(const char *data, size_t n, string & out) const
+{
+  if (!covers(data, n))
+    return -1;
+
+  return bitpack().encode(data, n, &lengths[0], &codes[0], out);
+}
+
+//----------------------------------------------------------------------------
+
+long long CodeBook::decode(const unsigned char *payload, size_t payload_length, char *out, size_t n) const
+{
+  if (n == 0)
+    return 0;
+
+  return bitpack().decode(&D.entries[0], D.primary_bits, payload, payload_length, out, n);
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
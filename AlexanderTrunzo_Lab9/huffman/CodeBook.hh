@@ -0,0 +1,66 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// immutable code tables that any number of threads can share
+//----------------------------------------------------------------------------
+
+#ifndef CODEBOOK_HH
+#define CODEBOOK_HH
+
+#include "Huffman.hh"
+#include "CodeTable.hh"
+
+#include <memory>
+
+//----------------------------------------------------------------------------
+
+#define MAX_CODEBOOK_CODE_LENGTH       15      // keeps decode table subtables small
+
+//----------------------------------------------------------------------------
+
+// a Huffman object mixes the state of building a code (trie, char_counter)
+// with the code itself, so one can't be used by two threads at once.  a
+// CodeBook is just the finished code: the encode table and the decode
+// lookup table, built once and never changed after.  it is handed around
+// as shared_ptr <const CodeBook>, so it lives as long as anyone uses it,
+// and every member is const and keeps no state between calls -- threads
+// bring their own buffers, and that's all the per-thread state there is
+
+class CodeBook;
+typedef shared_ptr <const CodeBook> CodeBookPtr;
+
+class CodeBook
+{
+public:
+
+  static CodeBookPtr from_counts(vector <int> &, int = MAX_CODEBOOK_CODE_LENGTH, int = 0);
+  static CodeBookPtr from_table(const CodeTable &, int = 0);
+
+  // append n chars' codes to out, MSB first, last byte 0-padded.  returns
+  // the number of bits, or -1 if some char has no code
+
+  long long encode(const char *, size_t, string &) const;
+
+  // decode exactly n chars; returns the bits consumed, or -1 on an
+  // invalid code
+
+  long long decode(const unsigned char *, size_t, char *, size_t) const;
+
+  bool covers(const char *, size_t) const;
+  const CodeTable & table() const { return T; }
+  int decode_table_bits() const { return D.primary_bits; }
+
+private:
+
+  CodeBook() {}
+  bool finish(int);
+
+  CodeTable T;
+  DecodeTable D;
+  vector <int> lengths;          // T's code lengths for all 256 byte values (0: no code)
+  vector <unsigned int> codes;
+};
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,447 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// compact code table: one code length and one bit pattern per char
+//----------------------------------------------------------------------------
+
+#include "CodeTable.hh"
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+CodeTable::CodeTable(int n)
+{
+  num_symbols = n;
+  clear();
+}
+
+//----------------------------------------------------------------------------
+
+void CodeTable::clear()
+{
+  code_length.assign(num_symbols, 0);
+  code_bits.assign(num_symbols, 0);
+  trained_ratio = 1.0;
+}
+
+//----------------------------------------------------------------------------
+
+// copy codes out of a char -> bitstring map.  returns false if any code
+// is too long to be held in an unsigned int; its length is then cut to
+// MAX_CODE_LENGTH and the table is only usable after limit_code_lengths()
+
+bool CodeTable::from_compression_map(map <char, string> & compression_map)
+{
+  map <char, string>::iterator cur;
+  int i, c;
+  bool exact = true;
+
+  clear();
+
+  for (cur = compression_map.begin(); cur != compression_map.end(); cur++) {
+    c = (unsigned char) (*cur).first;
+    if (c >= NUM_ASCII)
+      return false;
+    if ((*cur).second.length() > MAX_CODE_LENGTH) {
+      code_length[c] = MAX_CODE_LENGTH;
+      exact = false;
+      continue;
+    }
+    code_length[c] = (*cur).second.length();
+    code_bits[c] = 0;
+    for (i = 0; i < code_length[c]; i++)
+      code_bits[c] = (code_bits[c] << 1) | ((*cur).second[i] == '1');
+  }
+
+  return exact;
+}
+
+//----------------------------------------------------------------------------
+
+// Huffman's algorithm straight from a histogram, for alphabets that aren't
+// chars (so a TrieNode can't hold the symbol).  same merging as
+// build_optimal_trie(), but on parent links in arrays; the depth of each
+// leaf is its code length.  lengths are then limited to max_len and codes
+// assigned canonically
+
+void CodeTable::from_counts(vector <int> & counts, int max_len)
+{
+  priority_queue <pair <long long, int>, vector <pair <long long, int> >, greater <pair <long long, int> > > pq;
+  vector <int> parent, freq_counts;
+  pair <long long, int> first, second;
+  int i, node, depth, used;
+
+  clear();
+
+  used = 0;
+  for (i = 0; i < num_symbols && i < counts.size(); i++)
+    if (counts[i] > 0) {
+      pq.push(make_pair((long long) counts[i], i));
+      used++;
+    }
+
+  if (used == 0)
+    return;
+
+  // leaves are nodes 0..num_symbols-1, merged subtries get new numbers
+
+  parent.assign(num_symbols, -1);
+
+  while (pq.size() > 1) {
+    first = pq.top();
+    pq.pop();
+    second = pq.top();
+    pq.pop();
+    node = parent.size();
+    parent.push_back(-1);
+    parent[first.second] = node;
+    parent[second.second] = node;
+    pq.push(make_pair(first.first + second.first, node));
+  }
+
+  for (i = 0; i < num_symbols && i < counts.size(); i++) {
+    if (counts[i] == 0)
+      continue;
+    depth = 0;
+    for (node = i; parent[node] >= 0; node = parent[node])
+      depth++;
+    code_length[i] = min(max(depth, 1), MAX_CODE_LENGTH);   // one symbol still needs a 1-bit code
+  }
+
+  freq_counts.assign(counts.begin(), counts.begin() + min((int) counts.size(), num_symbols));
+  freq_counts.resize(num_symbols, 0);
+  limit_code_lengths(max_len, freq_counts);
+}
+
+//----------------------------------------------------------------------------
+
+// take only the lengths and rebuild the codes themselves canonically
+
+void CodeTable::from_code_lengths(vector <int> & lengths)
+{
+  int i;
+
+  clear();
+  for (i = 0; i < num_symbols && i < lengths.size(); i++)
+    code_length[i] = lengths[i];
+  assign_canonical_codes();
+}
+
+//----------------------------------------------------------------------------
+
+// canonical Huffman codes: shorter codes come first, and codes of the same
+// length are handed out in increasing char order.  the lengths are all
+// that's needed to reproduce the table
+
+void CodeTable::assign_canonical_codes()
+{
+  unsigned int code;
+  int len, i, prev_len;
+
+  code = 0;
+  prev_len = 0;
+
+  for (len = 1; len <= MAX_CODE_LENGTH; len++)
+    for (i = 0; i < num_symbols; i++)
+      if (code_length[i] == len) {
+        code <<= (len - prev_len);
+        prev_len = len;
+        code_bits[i] = code++;
+      }
+}
+
+//----------------------------------------------------------------------------
+
+// squeeze every code down to at most max_len bits, keeping the code
+// complete.  codes that are too long are cut to max_len, which overfills
+// the code space; each step of the repair then lengthens one shorter code
+// by a bit, freeing exactly one max_len-bit slot.  afterwards the lengths
+// are handed back out so the most frequent chars get the shortest codes.
+// codes are reassigned canonically
+
+void CodeTable::limit_code_lengths(int max_len, vector <int> & char_counter)
+{
+  vector <int> length_count(MAX_CODE_LENGTH + 1, 0);
+  vector <int> order;
+  long long kraft = 0;
+  int i, j, len, tmp;
+
+  for (i = 0; i < num_symbols; i++)
+    if (code_length[i] > 0)
+      kraft += 1LL << (MAX_CODE_LENGTH - code_length[i]);
+
+  if (max_code_length() <= max_len && kraft <= (1LL << MAX_CODE_LENGTH)) {
+    assign_canonical_codes();
+    return;
+  }
+
+  for (i = 0; i < num_symbols; i++)
+    if (code_length[i] > 0) {
+      length_count[min(code_length[i], max_len)]++;
+      order.push_back(i);
+    }
+
+  // kraft sum scaled by 2^max_len; it must come out to exactly 2^max_len
+
+  kraft = 0;
+  for (len = 1; len <= max_len; len++)
+    kraft += (long long) length_count[len] << (max_len - len);
+
+  while (kraft > (1LL << max_len)) {
+    length_count[max_len]--;
+    for (len = max_len - 1; len > 0; len--)
+      if (length_count[len] > 0) {
+        length_count[len]--;
+        length_count[len + 1] += 2;
+        break;
+      }
+    kraft--;
+  }
+
+  // most frequent first (insertion sort -- a few hundred entries at most)
+
+  for (i = 1; i < order.size(); i++)
+    for (j = i; j > 0 && char_counter[order[j]] > char_counter[order[j - 1]]; j--) {
+      tmp = order[j];
+      order[j] = order[j - 1];
+      order[j - 1] = tmp;
+    }
+
+  i = 0;
+  for (len = 1; len <= max_len; len++)
+    for (j = 0; j < length_count[len]; j++)
+      code_length[order[i++]] = len;
+
+  assign_canonical_codes();
+}
+
+//----------------------------------------------------------------------------
+
+// regenerate the string maps that compress() and decompress() use
+
+void CodeTable::fill_maps(map <char, string> & compression_map, map <string, char> & decompression_map)
+{
+  int i, j;
+  string s;
+
+  compression_map.clear();
+  decompression_map.clear();
+
+  for (i = 0; i < num_symbols; i++) {
+    if (code_length[i] == 0)
+      continue;
+    s.clear();
+    for (j = code_length[i] - 1; j >= 0; j--)
+      s += ((code_bits[i] >> j) & 1) ? '1' : '0';
+    compression_map[(char) i] = s;
+    decompression_map[s] = (char) i;
+  }
+}
+
+//----------------------------------------------------------------------------
+
+// does every char that occurs in the histogram have a code?
+
+bool CodeTable::covers(vector <int> & char_counter)
+{
+  int i;
+
+  for (i = 0; i < num_symbols && i < char_counter.size(); i++)
+    if (char_counter[i] > 0 && code_length[i] == 0)
+      return false;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// how many bits the histogram takes to encode with this table
+
+double CodeTable::cost(vector <int> & char_counter)
+{
+  double bits;
+  int i;
+
+  bits = 0;
+  for (i = 0; i < num_symbols && i < char_counter.size(); i++)
+    bits += (double) char_counter[i] * code_length[i];
+
+  return bits;
+}
+
+//----------------------------------------------------------------------------
+
+int CodeTable::max_code_length()
+{
+  int i, longest;
+
+  longest = 0;
+  for (i = 0; i < num_symbols; i++)
+    if (code_length[i] > longest)
+      longest = code_length[i];
+
+  return longest;
+}
+
+//----------------------------------------------------------------------------
+
+// text format: trained ratio on the first line, then one "char length"
+// pair per line for every char with a code
+
+bool CodeTable::save(string filename)
+{
+  ofstream outStream;
+  int i;
+
+  outStream.open(filename.c_str());
+  if (outStream.fail())
+    return false;
+
+  outStream << trained_ratio << endl;
+  for (i = 0; i < num_symbols; i++)
+    if (code_length[i] > 0)
+      outStream << i << " " << code_length[i] << endl;
+
+  outStream.close();
+  return !outStream.fail();
+}
+
+//----------------------------------------------------------------------------
+
+bool CodeTable::load(string filename)
+{
+  ifstream inStream;
+  vector <int> lengths(NUM_ASCII, 0);
+  long long kraft = 0;
+  double ratio;
+  int c, len;
+
+  inStream.open(filename.c_str());
+  if (inStream.fail())
+    return false;
+
+  if (!(inStream >> ratio))
+    return false;
+
+  while (inStream >> c >> len) {
+    if (c < 0 || c >= NUM_ASCII || len <= 0 || len > MAX_CODE_LENGTH)
+      return false;
+    lengths[c] = len;
+  }
+
+  // too many short codes: no prefix code has these lengths, and coding
+  // with them would write a file that can't be decoded
+
+  for (c = 0; c < NUM_ASCII; c++)
+    if (lengths[c] > 0)
+      kraft += 1LL << (MAX_CODE_LENGTH - lengths[c]);
+  if (kraft > (1LL << MAX_CODE_LENGTH))
+    return false;
+
+  from_code_lengths(lengths);
+  trained_ratio = ratio;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+int DecodeTable::default_bits = DEFAULT_DECODE_TABLE_BITS;
+
+DecodeTable::DecodeTable()
+{
+  primary_bits = 0;
+}
+
+//----------------------------------------------------------------------------
+
+// fill the primary table and any subtables.  fails if the codes in T
+// aren't a prefix code
+
+bool DecodeTable::build(CodeTable & T, int bits)
+{
+  vector <int> sub_bits;
+  unsigned int prefix, first, fill, e, offset;
+  int i, j, len, extra;
+
+  primary_bits = bits > 0 ? bits : default_bits;
+  entries.assign(1 << primary_bits, 0);
+
+  // pass 1: how wide does the subtable under each primary prefix need to be?
+
+  sub_bits.assign(1 << primary_bits, 0);
+  for (i = 0; i < T.num_symbols; i++) {
+    len = T.code_length[i];
+    if (len > primary_bits) {
+      prefix = T.code_bits[i] >> (len - primary_bits);
+      sub_bits[prefix] = max(sub_bits[prefix], len - primary_bits);
+    }
+  }
+
+  for (prefix = 0; prefix < sub_bits.size(); prefix++)
+    if (sub_bits[prefix] > 0) {
+      offset = entries.size();
+      entries[prefix] = (offset << 8) | DECODE_LINK | sub_bits[prefix];
+      entries.resize(offset + (1 << sub_bits[prefix]), 0);
+    }
+
+  // pass 2: every index that starts with a code decodes to its char
+
+  for (i = 0; i < T.num_symbols; i++) {
+    len = T.code_length[i];
+    if (len == 0)
+      continue;
+
+    if (len <= primary_bits) {
+      first = T.code_bits[i] << (primary_bits - len);
+      fill = 1 << (primary_bits - len);
+      e = (i << 8) | len;
+      for (j = 0; j < fill; j++) {
+        if (entries[first + j] != 0)
+          return false;
+        entries[first + j] = e;
+      }
+    }
+    else {
+      prefix = T.code_bits[i] >> (len - primary_bits);
+      offset = entries[prefix] >> 8;
+      extra = len - primary_bits;
+      first = offset + ((T.code_bits[i] & ((1u << extra) - 1)) << (sub_bits[prefix] - extra));
+      fill = 1 << (sub_bits[prefix] - extra);
+      e = (i << 8) | extra;
+      for (j = 0; j < fill; j++) {
+        if (entries[first + j] != 0)
+          return false;
+        entries[first + j] = e;
+      }
+    }
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// lower bound on encoded size, in bits, of a histogram for any prefix code
+
+double histogram_entropy_bits(vector <int> & char_counter)
+{
+  double total, bits, p;
+  int i;
+
+  total = 0;
+  for (i = 0; i < char_counter.size(); i++)
+    total += char_counter[i];
+
+  bits = 0;
+  for (i = 0; i < char_counter.size(); i++)
+    if (char_counter[i] > 0) {
+      p = char_counter[i] / total;
+      bits -= char_counter[i] * log2(p);
+    }
+
+  return bits;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
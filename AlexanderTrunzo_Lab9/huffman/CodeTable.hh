@@ -0,0 +1,107 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// compact code table: one code length and one bit pattern per char
+//----------------------------------------------------------------------------
+
+#ifndef CODETABLE_HH
+#define CODETABLE_HH
+
+#include "Huffman.hh"
+#include "BitIO.hh"
+
+//----------------------------------------------------------------------------
+
+#define MAX_CODE_LENGTH                32      // longest code that fits in code_bits
+#define DEFAULT_DECODE_TABLE_BITS      11      // bits resolved by one primary lookup
+
+//----------------------------------------------------------------------------
+
+// the same information as compression_map, but indexed by char and with
+// each code stored as an integer (MSB = first bit of code) instead of a
+// string of 0's and 1's.  a length of 0 means the char has no code.
+//
+// tables for other alphabets (e.g. LZ lengths and distances) use the same
+// class with a different num_symbols; the string map functions only make
+// sense for char tables
+
+class CodeTable
+{
+public:
+
+  CodeTable(int = NUM_ASCII);
+  void clear();
+  bool from_compression_map(map <char, string> &);
+  void from_code_lengths(vector <int> &);
+  void from_counts(vector <int> &, int);
+  void assign_canonical_codes();
+  void limit_code_lengths(int, vector <int> &);
+  void fill_maps(map <char, string> &, map <string, char> &);
+  bool covers(vector <int> &);
+  double cost(vector <int> &);
+  int max_code_length();
+  bool save(string);
+  bool load(string);
+
+  int num_symbols;                     // alphabet size (NUM_ASCII for chars)
+  vector <int> code_length;            // bits in code for each char (0 if unused)
+  vector <unsigned int> code_bits;     // code for each char, right-justified
+  double trained_ratio;                // cost / entropy on the histogram the table was built from
+};
+
+//----------------------------------------------------------------------------
+
+// table-driven decoder for any prefix code in a CodeTable.  the next
+// primary_bits of input index the primary table directly; codes longer
+// than that go through a second lookup in a subtable for their prefix.
+//
+// each entry packs (value << 8) | (is_link << 7) | length: for a char,
+// value is the char and length its code length; for a link, value is the
+// subtable offset and length the subtable's index width.  a length of 0
+// marks a bit pattern that isn't a valid code.
+//
+// build() without a width uses default_bits, which is
+// DEFAULT_DECODE_TABLE_BITS unless -tablebits or a -tune profile (see
+// Tune.hh) says otherwise
+
+#define DECODE_LINK                    0x80
+#define DECODE_LENGTH_MASK             0x7f
+
+class DecodeTable
+{
+public:
+
+  DecodeTable();
+  bool build(CodeTable &, int = 0);
+
+  // decode one char; returns -1 on an invalid code
+
+  inline int decode(BitReader & in)
+  {
+    unsigned int e;
+
+    in.refill();
+    e = entries[in.peek(primary_bits)];
+    if (e & DECODE_LINK) {
+      in.consume(primary_bits);
+      e = entries[(e >> 8) + in.peek(e & DECODE_LENGTH_MASK)];
+    }
+    if ((e & DECODE_LENGTH_MASK) == 0)
+      return -1;
+    in.consume(e & DECODE_LENGTH_MASK);
+    return e >> 8;
+  }
+
+  int primary_bits;
+  vector <unsigned int> entries;
+
+  static int default_bits;
+};
+
+//----------------------------------------------------------------------------
+
+double histogram_entropy_bits(vector <int> &);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,202 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// per-column code tables for tab-delimited text
+//----------------------------------------------------------------------------
+
+#include "Columns.hh"
+#include "StreamCodec.hh"
+#include "BitIO.hh"
+
+//----------------------------------------------------------------------------
+
+// which table the char after c uses
+
+static inline int next_column(int column, int c, int num_tables)
+{
+  if (c == ASCII_NEWLINE)
+    return 0;
+  if (c == ASCII_TAB && column < num_tables - 1)
+    return column + 1;
+  return column;
+}
+
+//----------------------------------------------------------------------------
+
+int column_after(int column, const char *data, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    if (data[i] == ASCII_NEWLINE)
+      column = 0;
+    else if (data[i] == ASCII_TAB)
+      column++;
+
+  return column;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+ColumnModel::ColumnModel()
+{
+  num_tables = 1;
+  start_column = 0;
+  bits = single_table_bits = 0;
+}
+
+//----------------------------------------------------------------------------
+
+// table + payload bits of coding counts with T
+
+static long long table_bits(CodeTable & T, vector <int> & counts)
+{
+  long long bits;
+  int c;
+
+  bits = 8;
+  for (c = 0; c < NUM_ASCII; c++)
+    if (T.code_length[c] > 0)
+      bits += 16 + (long long) counts[c] * T.code_length[c];
+
+  return bits;
+}
+
+//----------------------------------------------------------------------------
+
+// histogram the n chars (bad chars already taken out) by column,
+// starting in column, and pick the number of tables.  returns true if
+// more than one table wins
+
+bool ColumnModel::build(const char *data, size_t n, int column)
+{
+  vector <vector <int> > counts(MAX_COLUMN_TABLES, vector <int> (NUM_ASCII, 0));
+  vector <int> merged;
+  vector <CodeTable> candidate;
+  long long candidate_bits;
+  size_t i;
+  int c, k, j, col;
+
+  col = min(column, MAX_COLUMN_TABLES - 1);
+  for (i = 0; i < n; i++) {
+    c = (unsigned char) data[i];
+    if (c >= NUM_ASCII)
+      continue;
+    counts[col][c]++;
+    col = next_column(col, c, MAX_COLUMN_TABLES);
+  }
+
+  bits = -1;
+  for (k = 1; k <= MAX_COLUMN_TABLES; k++) {
+
+    // columns k-1 and up share the last table
+
+    candidate.assign(k, CodeTable());
+    candidate_bits = k > 1 ? 16 : 0;
+    merged.assign(NUM_ASCII, 0);
+    for (j = k - 1; j < MAX_COLUMN_TABLES; j++)
+      for (c = 0; c < NUM_ASCII; c++)
+        merged[c] += counts[j][c];
+
+    for (j = 0; j < k; j++) {
+      vector <int> & h = j < k - 1 ? counts[j] : merged;
+      candidate[j].from_counts(h, MAX_STREAM_CODE_LENGTH);
+      candidate_bits += table_bits(candidate[j], h);
+    }
+
+    if (k == 1)
+      single_table_bits = candidate_bits;
+    if (bits < 0 || candidate_bits < bits) {
+      bits = candidate_bits;
+      num_tables = k;
+      tables = candidate;
+    }
+  }
+
+  start_column = min(column, num_tables - 1);
+
+  return num_tables > 1;
+}
+
+//----------------------------------------------------------------------------
+
+// append [table count][start column][tables][payload] for the n chars
+// build() saw.  payload_start is where the payload begins in out
+
+void ColumnModel::encode(const char *data, size_t n, string & out, int & payload_start)
+{
+  size_t i;
+  int c, j, col, count;
+
+  out += (char) num_tables;
+  out += (char) start_column;
+  for (j = 0; j < num_tables; j++) {
+    count = 0;
+    for (c = 0; c < NUM_ASCII; c++)
+      if (tables[j].code_length[c] > 0)
+        count++;
+    out += (char) count;
+    for (c = 0; c < NUM_ASCII; c++)
+      if (tables[j].code_length[c] > 0) {
+        out += (char) c;
+        out += (char) tables[j].code_length[c];
+      }
+  }
+
+  payload_start = out.length();
+  BitWriter w(out);
+
+  col = start_column;
+  for (i = 0; i < n; i++) {
+    c = (unsigned char) data[i];
+    w.put(tables[col].code_bits[c], tables[col].code_length[c]);
+    col = next_column(col, c, num_tables);
+  }
+
+  w.flush();
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// decode n chars into out, switching tables on tabs and newlines as the
+// encoder did.  a column whose table is empty has no chars in the block
+
+bool column_decode_block(vector <vector <int> > & lengths, int start_column, const unsigned char *payload,
+                         size_t payload_length, char *out, int n, string & message)
+{
+  vector <DecodeTable> D(lengths.size());
+  CodeTable T;
+  int i, j, c, col, num_tables;
+
+  num_tables = lengths.size();
+  for (j = 0; j < num_tables; j++) {
+    T.from_code_lengths(lengths[j]);
+    if (T.max_code_length() > 0 && !D[j].build(T)) {
+      message = "column code table is not a prefix code";
+      return false;
+    }
+  }
+
+  BitReader in(payload, payload_length);
+  col = start_column;
+
+  for (i = 0; i < n; i++) {
+    if (D[col].entries.empty() || (c = D[col].decode(in)) < 0) {
+      message = "invalid code in column block payload";
+      return false;
+    }
+    out[i] = (char) c;
+    col = next_column(col, c, num_tables);
+  }
+
+  if (in.bits_consumed() > 8LL * payload_length || (in.bits_consumed() + 7) / 8 != payload_length) {
+    message = "block payload length doesn't match its contents";
+    return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
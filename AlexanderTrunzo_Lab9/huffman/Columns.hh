@@ -0,0 +1,59 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// per-column code tables for tab-delimited text
+//----------------------------------------------------------------------------
+
+#ifndef COLUMNS_HH
+#define COLUMNS_HH
+
+#include "Huffman.hh"
+#include "CodeTable.hh"
+
+//----------------------------------------------------------------------------
+
+#define MAX_COLUMN_TABLES              8
+#define COLUMN_FIXED_HEADER_BYTES      16      // through the first table's size byte
+
+//----------------------------------------------------------------------------
+
+// in TSV the columns are different languages -- IDs are all digits,
+// timestamps digits and a few separators, free text mostly letters -- and
+// one table for the whole block fits none of them well.  a column block
+// has a table per column instead: the char after a tab is coded with the
+// next column's table, the char after a newline with column 0's.  encoder
+// and decoder both follow along with the tabs and newlines they've coded,
+// so nothing is spent saying which table is in use.
+//
+// with k tables, columns 0..k-2 have their own and every column from
+// k-1 on shares the last one (wide files usually end in free text).  the
+// encoder tries every k from 1 to MAX_COLUMN_TABLES on each block and
+// keeps the one with the smallest tables + payload; if that's k = 1 the
+// block is written as an ordinary Huffman block.  a block can start
+// mid-line, so its header says which table its first char uses
+
+class ColumnModel
+{
+public:
+
+  ColumnModel();
+  bool build(const char *, size_t, int);
+  void encode(const char *, size_t, string &, int &);
+
+  int num_tables;
+  int start_column;          // table of the first char
+  vector <CodeTable> tables;
+  long long bits;            // tables + payload
+  long long single_table_bits;
+};
+
+// column (tabs since the last newline) after the given chars, starting
+// in the given column
+
+int column_after(int, const char *, size_t);
+
+bool column_decode_block(vector <vector <int> > &, int, const unsigned char *, size_t, char *, int, string &);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
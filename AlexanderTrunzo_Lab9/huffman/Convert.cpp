@@ -0,0 +1,169 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// converting .huf files between -ascii and binary without decoding
+//----------------------------------------------------------------------------
+
+#include "Convert.hh"
+#include "BitPack.hh"
+#include "StreamCodec.hh"
+#include "Adaptive.hh"
+
+#include <sstream>
+#include <algorithm>
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// bytes from the current position to the end; the position is unchanged
+
+static long long bytes_left(istream & inStream)
+{
+  long long start, end;
+
+  start = inStream.tellg();
+  inStream.seekg(0, ios::end);
+  end = inStream.tellg();
+  inStream.seekg(start);
+
+  return end - start;
+}
+
+//----------------------------------------------------------------------------
+
+bool convert_to_binary(istream & inStream, ostream & outStream, string & message)
+{
+  BitPackKernels & K = bitpack();
+  string bits(8 * CONVERT_BUFFER_BYTES, '0'), packed(CONVERT_BUFFER_BYTES, 0);
+  Huffman H;
+  long long total_bits, offset;
+  size_t n, bad;
+  unsigned char bad_bits;
+
+  H.read_decompression_map(inStream, false);
+  if (H.decompression_map.empty())
+    inStream >> ws;            // an empty table is just "0\n"
+  if (!inStream) {
+    message = "not an -ascii .huf file";
+    return false;
+  }
+
+  total_bits = bytes_left(inStream);
+  bad_bits = (BITS_PER_BYTE - total_bits % BITS_PER_BYTE) % BITS_PER_BYTE;
+
+  H.print_decompression_map(outStream, true);
+  outStream.write((char *) &bad_bits, 1);
+
+  for (offset = 0; offset < total_bits; offset += n) {
+    inStream.read(&bits[0], bits.length());
+    n = inStream.gcount();
+    if (n == 0) {
+      message = "input ended early";
+      return false;
+    }
+
+    bad = K.check_ascii(bits.data(), n);
+    if (bad < n) {
+      ostringstream where;
+      where << "char " << offset + bad << " of the code bits isn't '0' or '1'";
+      message = where.str();
+      return false;
+    }
+
+    // last few bits: padded with 0's on the right, as the compressor does
+
+    fill(bits.begin() + n, bits.begin() + (n + 7) / 8 * 8, '0');
+    K.pack_ascii(bits.data(), (n + 7) / 8, (unsigned char *) &packed[0]);
+    outStream.write(packed.data(), (n + 7) / 8);
+  }
+
+  outStream.flush();
+  if (outStream.fail()) {
+    message = "write failed";
+    return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+bool convert_to_ascii(istream & inStream, ostream & outStream, string & message)
+{
+  BitPackKernels & K = bitpack();
+  string packed(CONVERT_BUFFER_BYTES, 0), bits(8 * CONVERT_BUFFER_BYTES, 0);
+  Huffman H;
+  long long payload_bytes, offset;
+  size_t n, keep;
+  int bad_bits;
+
+  if (is_stream_format(inStream)) {
+    message = "block stream files have no -ascii form";
+    return false;
+  }
+  if (is_adaptive_format(inStream)) {
+    message = "adaptive files have no -ascii form";
+    return false;
+  }
+
+  H.read_decompression_map(inStream, true);
+  bad_bits = inStream.get();
+  if (!inStream || bad_bits >= BITS_PER_BYTE) {
+    message = "not a binary .huf file";
+    return false;
+  }
+
+  payload_bytes = bytes_left(inStream);
+  if (payload_bytes == 0 && bad_bits > 0) {
+    message = "padding longer than payload";
+    return false;
+  }
+
+  H.print_decompression_map(outStream, false);
+
+  for (offset = 0; offset < payload_bytes; offset += n) {
+    inStream.read(&packed[0], packed.length());
+    n = inStream.gcount();
+    if (n == 0) {
+      message = "input ended early";
+      return false;
+    }
+
+    K.unpack_ascii((const unsigned char *) packed.data(), n, &bits[0]);
+    keep = 8 * n;
+    if (offset + n == payload_bytes)
+      keep -= bad_bits;
+    outStream.write(bits.data(), keep);
+  }
+
+  outStream.flush();
+  if (outStream.fail()) {
+    message = "write failed";
+    return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+bool convert_file(string in_filename, string out_filename, bool to_binary, string & message)
+{
+  ifstream inStream;
+  ofstream outStream;
+
+  inStream.open(in_filename.c_str(), ios::binary);
+  if (inStream.fail()) {
+    message = "can't open " + in_filename;
+    return false;
+  }
+  outStream.open(out_filename.c_str(), ios::binary);
+  if (outStream.fail()) {
+    message = "can't create " + out_filename;
+    return false;
+  }
+
+  return to_binary ? convert_to_binary(inStream, outStream, message) : convert_to_ascii(inStream, outStream, message);
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,33 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// converting .huf files between -ascii and binary without decoding
+//----------------------------------------------------------------------------
+
+#ifndef CONVERT_HH
+#define CONVERT_HH
+
+#include "Huffman.hh"
+
+//----------------------------------------------------------------------------
+
+#define CONVERT_BUFFER_BYTES           (256 * 1024)   // packed bytes per step (8 times that in '0'/'1' chars)
+
+//----------------------------------------------------------------------------
+
+// an -ascii .huf file is the same code table and the same code bits as a
+// binary one, with each bit written as a '0' or '1' char.  so converting
+// is just re-writing the header and packing or unpacking the bits with
+// the bitpack() kernels; no chars are decoded.  binary files get the
+// padding byte the compressor would have written, so an -ascii file
+// converted to binary is byte-for-byte what compressing without -ascii
+// gives.  the input must be seekable, since the body's length decides the
+// padding.  block stream files have no -ascii form
+
+bool convert_to_binary(istream &, ostream &, string &);
+bool convert_to_ascii(istream &, ostream &, string &);
+bool convert_file(string, string, bool, string &);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
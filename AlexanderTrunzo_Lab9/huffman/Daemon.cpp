@@ -0,0 +1,434 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// long-lived compression server on a unix domain socket
+//----------------------------------------------------------------------------
+
+#include "Daemon.hh"
+#include "StreamCodec.hh"
+#include "Adaptive.hh"
+#include "SyncDecode.hh"
+#include "Convert.hh"
+
+#include <sstream>
+#include <algorithm>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop_signal(int)
+{
+  stop_requested = 1;
+}
+
+//----------------------------------------------------------------------------
+
+// an ostream into a string that won't grow past limit chars: past that it
+// fails, as a full disk would, and the decoders writing to it stop
+
+class BoundedStringBuffer : public streambuf
+{
+public:
+  BoundedStringBuffer(string & s, size_t n) : out(s), limit(n) {}
+protected:
+  int overflow(int c)
+  {
+    if (c == EOF)
+      return 0;
+    if (out.length() >= limit)
+      return EOF;
+    out += (char) c;
+    return c;
+  }
+  streamsize xsputn(const char *p, streamsize n)
+  {
+    if (out.length() + n > limit)
+      return 0;
+    out.append(p, n);
+    return n;
+  }
+private:
+  string & out;
+  size_t limit;
+};
+
+//----------------------------------------------------------------------------
+
+// if no cache is passed in, the daemon keeps a private in-memory one
+
+Daemon::Daemon(string path, int num_engines, TableCache *cache)
+{
+  int i;
+
+  socket_path = path;
+  stopping = false;
+
+  own_cache = (cache == NULL);
+  table_cache = own_cache ? new TableCache() : cache;
+
+  if (num_engines < 1)
+    num_engines = 1;
+
+  for (i = 0; i < num_engines; i++) {
+    engines.push_back(new Huffman());
+    engines.back()->table_cache = table_cache;
+  }
+}
+
+//----------------------------------------------------------------------------
+
+Daemon::~Daemon()
+{
+  int i;
+
+  for (i = 0; i < engines.size(); i++)
+    delete engines[i];
+
+  if (own_cache)
+    delete table_cache;
+}
+
+//----------------------------------------------------------------------------
+
+// compress each sample file once (output discarded) so the table cache
+// already holds tables for the kinds of data we expect to see
+
+void Daemon::pretrain(vector <string> & filenames)
+{
+  ifstream inStream;
+  ostringstream discard;
+  int i;
+
+  for (i = 0; i < filenames.size(); i++) {
+    inStream.open(filenames[i].c_str());
+    if (inStream.fail()) {
+      cout << "daemon: can't read training file " << filenames[i] << endl;
+      inStream.clear();
+      continue;
+    }
+    engines[0]->reset();
+    engines[0]->compress_stream(inStream, discard, true);
+    inStream.close();
+    discard.str("");
+  }
+
+  engines[0]->reset();
+}
+
+//----------------------------------------------------------------------------
+
+// accept loop, which also watches idle connections for their next
+// request.  returns false if the socket couldn't be set up
+
+bool Daemon::run()
+{
+  struct sockaddr_un addr;
+  struct timeval timeout;
+  vector <struct pollfd> pfds;
+  struct pollfd pfd;
+  char drain[64];
+  int listen_fd, fd, i;
+
+  if (socket_path.length() >= sizeof(addr.sun_path)) {
+    cout << "daemon: socket path too long\n";
+    return false;
+  }
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    cout << "daemon: socket() failed\n";
+    return false;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, socket_path.c_str());
+  unlink(socket_path.c_str());
+
+  if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(listen_fd, 64) < 0) {
+    cout << "daemon: can't listen on " << socket_path << endl;
+    close(listen_fd);
+    return false;
+  }
+
+  if (pipe(wake_pipe) < 0) {
+    cout << "daemon: pipe() failed\n";
+    close(listen_fd);
+    return false;
+  }
+
+  signal(SIGINT, handle_stop_signal);
+  signal(SIGTERM, handle_stop_signal);
+  signal(SIGPIPE, SIG_IGN);
+
+  for (i = 0; i < engines.size(); i++)
+    workers.push_back(thread(&Daemon::worker, this, i));
+
+  cout << "daemon: listening on " << socket_path << " with " << engines.size() << " engines\n";
+
+  // a client that stalls in the middle of a frame, or doesn't read the
+  // reply, can't hold a worker
+
+  timeout.tv_sec = DAEMON_IO_TIMEOUT_SECONDS;
+  timeout.tv_usec = 0;
+
+  // poll with a timeout so a stop signal is noticed promptly.  pfds is
+  // the listening socket, the wake pipe, then the idle connections
+
+  while (!stop_requested) {
+
+    pfds.clear();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    pfd.fd = listen_fd;
+    pfds.push_back(pfd);
+    pfd.fd = wake_pipe[0];
+    pfds.push_back(pfd);
+    {
+      lock_guard <mutex> guard(lock);
+      for (i = 0; i < idle.size(); i++) {
+        pfd.fd = idle[i];
+        pfds.push_back(pfd);
+      }
+    }
+
+    if (poll(&pfds[0], pfds.size(), 200) <= 0)
+      continue;
+
+    if (pfds[1].revents & POLLIN)
+      read(wake_pipe[0], drain, sizeof(drain));
+
+    // a request (or a hangup) on an idle connection: queue it for the
+    // next free worker
+
+    lock_guard <mutex> guard(lock);
+
+    for (i = 2; i < pfds.size(); i++)
+      if (pfds[i].revents) {
+        idle.erase(find(idle.begin(), idle.end(), pfds[i].fd));
+        pending.push(pfds[i].fd);
+        wakeup.notify_one();
+      }
+
+    if (pfds[0].revents & POLLIN) {
+      fd = accept(listen_fd, NULL, NULL);
+      if (fd >= 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        idle.push_back(fd);
+      }
+    }
+  }
+
+  // shut down: stop taking connections, kick clients being served, drop
+  // the rest, and wait for the workers
+
+  close(listen_fd);
+  unlink(socket_path.c_str());
+
+  {
+    lock_guard <mutex> guard(lock);
+    stopping = true;
+    for (set <int>::iterator cur = active.begin(); cur != active.end(); cur++)
+      shutdown(*cur, SHUT_RDWR);
+    while (!pending.empty()) {
+      close(pending.front());
+      pending.pop();
+    }
+    for (i = 0; i < idle.size(); i++)
+      close(idle[i]);
+    idle.clear();
+  }
+  wakeup.notify_all();
+
+  for (i = 0; i < workers.size(); i++)
+    workers[i].join();
+  workers.clear();
+
+  close(wake_pipe[0]);
+  close(wake_pipe[1]);
+
+  print_stats(cout);
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// take the next connection with a request waiting, answer that one
+// request, and give the connection back to run() to poll
+
+void Daemon::worker(int engine_index)
+{
+  bool keep;
+  int fd;
+
+  while (1) {
+    {
+      unique_lock <mutex> guard(lock);
+      while (pending.empty() && !stopping)
+        wakeup.wait(guard);
+      if (stopping)
+        return;
+      fd = pending.front();
+      pending.pop();
+      active.insert(fd);
+    }
+
+    keep = serve_request(fd, *engines[engine_index]);
+
+    {
+      lock_guard <mutex> guard(lock);
+      active.erase(fd);
+      if (keep && !stopping) {
+        idle.push_back(fd);
+        write(wake_pipe[1], "", 1);
+        continue;
+      }
+    }
+    close(fd);
+  }
+}
+
+//----------------------------------------------------------------------------
+
+// answer one request.  false once the client has closed the connection
+// (or sent something that isn't a frame)
+
+bool Daemon::serve_request(int fd, Huffman & H)
+{
+  unsigned char op, flags, status;
+  string request, response;
+  double start;
+
+  if (!recv_frame(fd, op, flags, request))
+    return false;
+
+  start = now_microseconds();
+  status = handle_request(H, op, flags, request, response);
+
+  if (op == OP_COMPRESS)
+    compress_latency.add(now_microseconds() - start);
+  else if (op == OP_DECOMPRESS)
+    decompress_latency.add(now_microseconds() - start);
+
+  return send_frame(fd, status, 0, response);
+}
+
+//----------------------------------------------------------------------------
+
+// run one request on engine H.  returns the response status
+
+unsigned char Daemon::handle_request(Huffman & H, unsigned char op, unsigned char flags, string & request, string & response)
+{
+  istringstream inStream(request);
+  ostringstream outStream;
+  bool do_binary, ok;
+
+  do_binary = !(flags & FLAG_ASCII);
+  ok = true;
+
+  H.reset();
+
+  if (op == OP_COMPRESS)
+    H.compress_stream(inStream, outStream, do_binary);
+  else if (op == OP_DECOMPRESS)
+    return decompress_request(flags, request, response) ? STATUS_OK : STATUS_ERROR;
+  else if (op == OP_STATS)
+    print_stats(outStream);
+  else {
+    outStream << "unknown request op " << (int) op << endl;
+    ok = false;
+  }
+
+  response = outStream.str();
+
+  // an -ascii compress is several times bigger than its request, so it
+  // can outgrow a frame
+
+  if (response.length() > MAX_FRAME_PAYLOAD) {
+    response = "response too big for one frame\n";
+    ok = false;
+  }
+
+  return ok ? STATUS_OK : STATUS_ERROR;
+}
+
+//----------------------------------------------------------------------------
+
+// the payload comes from a client, so nothing in it is trusted, and it
+// never goes to Huffman::decompress_stream(), whose string decoder can
+// take quadratic time on garbage.  block stream and adaptive data are
+// checked as they're decoded; an old-style file goes through
+// sync_decode_legacy(), which checks the header and padding and that the
+// codes end exactly where the padding starts, using a DecodeTable.  an
+// -ascii payload is packed to binary first, which checks that every code
+// char is a '0' or '1'.  the decoded size is held to what fits in one
+// reply frame.  on failure response holds the reason
+
+bool Daemon::decompress_request(unsigned char flags, const string & request, string & response)
+{
+  istringstream inStream(request);
+  ostringstream packed;
+  SyncDecodeResult result;
+  string binary, message;
+
+  response.clear();
+
+  if (!(flags & FLAG_ASCII) && (is_stream_format(inStream) || is_adaptive_format(inStream))) {
+    BoundedStringBuffer buffer(response, MAX_FRAME_PAYLOAD);
+    ostream outStream(&buffer);
+    bool ok;
+
+    if (is_stream_format(inStream)) {
+      StreamDecoder decoder(inStream);
+      ok = decoder.copy_to(outStream);
+      message = decoder.message;
+    }
+    else {
+      AdaptiveDecoder decoder(inStream);
+      ok = decoder.copy_to(outStream);
+      message = decoder.message;
+    }
+    if (!ok) {
+      response = "bad payload: " + (outStream.fail() ? string("decoded data too large for one reply") : message) + "\n";
+    }
+    return ok;
+  }
+
+  if (flags & FLAG_ASCII) {
+    if (!convert_to_binary(inStream, packed, message)) {
+      response = "bad payload: " + message + "\n";
+      return false;
+    }
+    binary = packed.str();
+  }
+
+  if (!sync_decode_legacy(flags & FLAG_ASCII ? binary : request, response, 1, result, MAX_FRAME_PAYLOAD)) {
+    response = "bad payload: " + result.message + "\n";
+    return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+void Daemon::print_stats(ostream & outStream)
+{
+  compress_latency.print(outStream, "compress");
+  decompress_latency.print(outStream, "decompress");
+  table_cache->print_stats(outStream);
+  if (!tuning.empty())
+    outStream << "tuning: " << tuning << endl;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
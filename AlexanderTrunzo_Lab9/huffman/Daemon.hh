@@ -0,0 +1,87 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// long-lived compression server on a unix domain socket
+//----------------------------------------------------------------------------
+
+#ifndef DAEMON_HH
+#define DAEMON_HH
+
+#include "Huffman.hh"
+#include "TableCache.hh"
+#include "Protocol.hh"
+
+#include <thread>
+#include <condition_variable>
+#include <set>
+
+//----------------------------------------------------------------------------
+
+#define DEFAULT_NUM_ENGINES            4
+#define DAEMON_IO_TIMEOUT_SECONDS      10
+
+//----------------------------------------------------------------------------
+
+// accepts connections on a unix socket and answers framed compress and
+// decompress requests (see Protocol.hh) entirely in memory.
+//
+// there is one Huffman object ("engine") per worker thread, allocated up
+// front and reset between requests.  all engines share one TableCache,
+// which can be warmed before serving starts by compressing sample files,
+// so most requests skip building a table.
+//
+// engines are shared per request, not per connection.  the accept loop
+// also polls every idle connection; when one has a request waiting, it
+// is queued, and whichever worker is free reads that one request,
+// answers it, and hands the connection back to be polled.  so clients
+// that stay connected without sending anything hold no engine.  a client
+// that stops partway through a frame, or stops reading its replies, is
+// dropped after DAEMON_IO_TIMEOUT_SECONDS.
+//
+// run() returns after SIGINT or SIGTERM
+
+class Daemon
+{
+public:
+
+  Daemon(string, int = DEFAULT_NUM_ENGINES, TableCache * = NULL);
+  ~Daemon();
+  void pretrain(vector <string> &);
+  bool run();
+  void print_stats(ostream &);
+
+  LatencyStats compress_latency;
+  LatencyStats decompress_latency;
+  string tuning;             // what the -tune profile set, for the stats; empty if none
+
+private:
+
+  void worker(int);
+  bool serve_request(int, Huffman &);
+  unsigned char handle_request(Huffman &, unsigned char, unsigned char, string &, string &);
+  bool decompress_request(unsigned char, const string &, string &);
+
+  string socket_path;
+  TableCache *table_cache;
+  bool own_cache;
+
+  vector <Huffman *> engines;
+  vector <thread> workers;
+
+  // connections waiting for their next request (polled by run()), ones
+  // with a request waiting for a free worker, and ones being served.  a
+  // worker handing a connection back writes a byte to wake_pipe so run()
+  // starts polling it again
+
+  vector <int> idle;
+  queue <int> pending;
+  set <int> active;
+  int wake_pipe[2];
+  mutex lock;
+  condition_variable wakeup;
+  bool stopping;
+};
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,352 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// DEFLATE (RFC 1951) and gzip (RFC 1952) output
+//----------------------------------------------------------------------------
+
+#include "Deflate.hh"
+#include "Checksum.hh"
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// length codes 257..285 and distance codes 0..29 (RFC 1951, 3.2.5)
+
+static const int length_base[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const int length_extra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const int distance_base[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const int distance_extra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// order the code length code lengths are sent in
+
+static const int codelen_order[DEFLATE_CODELEN_SYMBOLS] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+//----------------------------------------------------------------------------
+
+static int length_code(int len)
+{
+  int i;
+
+  if (len == 258)
+    return 28;
+  for (i = 27; length_base[i] > len; i--)
+    ;
+  return i;
+}
+
+static int distance_code(int dist)
+{
+  int i;
+
+  for (i = 29; distance_base[i] > dist; i--)
+    ;
+  return i;
+}
+
+//----------------------------------------------------------------------------
+
+// one symbol of the run-length coded code lengths (RFC 1951, 3.2.7)
+
+class CodeLengthSymbol
+{
+public:
+  CodeLengthSymbol(int s, int v = 0, int b = 0) { symbol = s; extra_value = v; extra_bits = b; }
+  int symbol, extra_value, extra_bits;
+};
+
+static void run_length_code(vector <int> & lengths, vector <CodeLengthSymbol> & out)
+{
+  int i, run, take;
+
+  out.clear();
+
+  for (i = 0; i < lengths.size(); i += run) {
+    for (run = 1; i + run < lengths.size() && lengths[i + run] == lengths[i]; run++)
+      ;
+
+    if (lengths[i] == 0) {
+      take = run;
+      while (take >= 11) {
+        out.push_back(CodeLengthSymbol(18, min(take, 138) - 11, 7));
+        take -= min(take, 138);
+      }
+      if (take >= 3) {
+        out.push_back(CodeLengthSymbol(17, take - 3, 3));
+        take = 0;
+      }
+      while (take-- > 0)
+        out.push_back(CodeLengthSymbol(0));
+    }
+    else {
+      out.push_back(CodeLengthSymbol(lengths[i]));
+      take = run - 1;
+      while (take >= 3) {
+        out.push_back(CodeLengthSymbol(16, min(take, 6) - 3, 2));
+        take -= min(take, 6);
+      }
+      while (take-- > 0)
+        out.push_back(CodeLengthSymbol(lengths[i]));
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+DeflateEncoder::DeflateEncoder(ostream & out, bool use_gzip, int size, int lz_level) : outStream(out), bits(encoded)
+{
+  gzip = use_gzip;
+  block_size = size > 0 ? size : DEFAULT_DEFLATE_BLOCK_SIZE;
+  lz = lz_level > 0 ? new LZMatcher(lz_level, DEFLATE_WINDOW_BITS) : NULL;
+
+  started = finished = false;
+  crc = 0;
+  bytes_in = bytes_out = 0;
+
+  block.reserve(block_size);
+}
+
+//----------------------------------------------------------------------------
+
+DeflateEncoder::~DeflateEncoder()
+{
+  finish();
+  delete lz;
+}
+
+//----------------------------------------------------------------------------
+
+bool DeflateEncoder::write(const char *data, size_t n)
+{
+  size_t take;
+
+  if (finished)
+    return false;
+
+  crc = crc32_update(crc, data, n);
+  bytes_in += n;
+
+  while (n > 0) {
+    take = min(n, (size_t) block_size - block.size());
+    block.append(data, take);
+    data += take;
+    n -= take;
+
+    if (block.size() == block_size) {
+      encode_block(false);
+      if (!write_output())
+        return false;
+    }
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// last block (possibly empty) has BFINAL set; then the gzip trailer
+
+bool DeflateEncoder::finish()
+{
+  int i;
+
+  if (finished)
+    return true;
+  finished = true;
+
+  encode_block(true);
+  bits.align();
+
+  if (gzip) {
+    for (i = 0; i < 4; i++)
+      encoded += (char) ((crc >> (8 * i)) & 0xff);
+    for (i = 0; i < 4; i++)
+      encoded += (char) ((bytes_in >> (8 * i)) & 0xff);
+  }
+
+  if (!write_output())
+    return false;
+  outStream.flush();
+
+  return !outStream.fail();
+}
+
+//----------------------------------------------------------------------------
+
+bool DeflateEncoder::copy_from(istream & inStream)
+{
+  char buffer[64 * 1024];
+
+  while (inStream.read(buffer, sizeof(buffer)) || inStream.gcount() > 0)
+    if (!write(buffer, inStream.gcount()))
+      return false;
+
+  return finish();
+}
+
+//----------------------------------------------------------------------------
+
+// write out the whole bytes produced so far (the bit writer keeps any
+// partial byte), preceded by the gzip header the first time
+
+bool DeflateEncoder::write_output()
+{
+  static const unsigned char gzip_header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 255 };
+
+  if (!started) {
+    started = true;
+    if (gzip) {
+      outStream.write((const char *) gzip_header, sizeof(gzip_header));
+      bytes_out += sizeof(gzip_header);
+    }
+  }
+
+  outStream.write(encoded.data(), encoded.length());
+  bytes_out += encoded.length();
+  encoded.clear();
+
+  return !outStream.fail();
+}
+
+//----------------------------------------------------------------------------
+
+// encode the buffered bytes as one dynamic block or as stored blocks,
+// whichever is smaller
+
+void DeflateEncoder::encode_block(bool final)
+{
+  vector <LZToken> tokens;
+  vector <int> litlen_counts(DEFLATE_LITLEN_SYMBOLS, 0), distance_counts(DEFLATE_DISTANCE_SYMBOLS, 0);
+  vector <int> codelen_counts(DEFLATE_CODELEN_SYMBOLS, 0), all_lengths;
+  vector <CodeLengthSymbol> rle;
+  CodeTable litlen(DEFLATE_LITLEN_SYMBOLS), dist(DEFLATE_DISTANCE_SYMBOLS), codelen(DEFLATE_CODELEN_SYMBOLS);
+  LZToken t;
+  long long dynamic_bits, stored_bits;
+  int i, n, c, d, hlit, hdist, hclen, num_stored, len;
+
+  n = block.size();
+
+  // tokens: LZ parse, or every byte a literal
+
+  if (lz != NULL)
+    lz->parse(block.data(), n, tokens);
+  else {
+    t.length = 0;
+    for (i = 0; i < n; i++) {
+      t.literal = block[i];
+      tokens.push_back(t);
+    }
+  }
+
+  for (i = 0; i < tokens.size(); i++) {
+    if (tokens[i].length == 0)
+      litlen_counts[tokens[i].literal]++;
+    else {
+      litlen_counts[257 + length_code(tokens[i].length)]++;
+      distance_counts[distance_code(tokens[i].distance)]++;
+    }
+  }
+  litlen_counts[DEFLATE_END_OF_BLOCK]++;
+
+  // the distance code can't be empty; a single unused code is allowed
+
+  for (d = 0; d < DEFLATE_DISTANCE_SYMBOLS && distance_counts[d] == 0; d++)
+    ;
+  if (d == DEFLATE_DISTANCE_SYMBOLS)
+    distance_counts[0] = 1;
+
+  litlen.from_counts(litlen_counts, DEFLATE_MAX_CODE_LENGTH);
+  dist.from_counts(distance_counts, DEFLATE_MAX_CODE_LENGTH);
+
+  for (hlit = DEFLATE_LITLEN_SYMBOLS; hlit > 257 && litlen.code_length[hlit - 1] == 0; hlit--)
+    ;
+  for (hdist = DEFLATE_DISTANCE_SYMBOLS; hdist > 1 && dist.code_length[hdist - 1] == 0; hdist--)
+    ;
+
+  all_lengths.assign(litlen.code_length.begin(), litlen.code_length.begin() + hlit);
+  all_lengths.insert(all_lengths.end(), dist.code_length.begin(), dist.code_length.begin() + hdist);
+  run_length_code(all_lengths, rle);
+
+  for (i = 0; i < rle.size(); i++)
+    codelen_counts[rle[i].symbol]++;
+  codelen.from_counts(codelen_counts, DEFLATE_MAX_CODELEN_LENGTH);
+
+  for (hclen = DEFLATE_CODELEN_SYMBOLS; hclen > 4 && codelen.code_length[codelen_order[hclen - 1]] == 0; hclen--)
+    ;
+
+  // compare sizes
+
+  dynamic_bits = 3 + 5 + 5 + 4 + 3 * hclen;
+  for (i = 0; i < rle.size(); i++)
+    dynamic_bits += codelen.code_length[rle[i].symbol] + rle[i].extra_bits;
+  for (c = 0; c < DEFLATE_LITLEN_SYMBOLS; c++)
+    dynamic_bits += (long long) litlen_counts[c] * (litlen.code_length[c] + (c > 256 ? length_extra[c - 257] : 0));
+  for (d = 0; d < DEFLATE_DISTANCE_SYMBOLS; d++)
+    dynamic_bits += (long long) distance_counts[d] * (dist.code_length[d] + distance_extra[d]);
+
+  num_stored = max(1, (n + DEFLATE_MAX_STORED - 1) / DEFLATE_MAX_STORED);
+  stored_bits = num_stored * (3 + 7 + 32) + 8LL * n;
+
+  // stored: each block byte-aligned with LEN and its complement
+
+  if (stored_bits <= dynamic_bits) {
+    for (i = 0; i < num_stored; i++) {
+      len = min(DEFLATE_MAX_STORED, n - i * DEFLATE_MAX_STORED);
+      bits.put(final && i == num_stored - 1 ? 1 : 0, 1);
+      bits.put(0, 2);
+      bits.align();
+      bits.put(len, 16);
+      bits.put(~len & 0xffff, 16);
+      encoded.append(block, i * DEFLATE_MAX_STORED, len);
+    }
+    block.clear();
+    return;
+  }
+
+  // dynamic: header, code length code, run-length coded lengths, data
+
+  bits.put(final ? 1 : 0, 1);
+  bits.put(2, 2);
+  bits.put(hlit - 257, 5);
+  bits.put(hdist - 1, 5);
+  bits.put(hclen - 4, 4);
+  for (i = 0; i < hclen; i++)
+    bits.put(codelen.code_length[codelen_order[i]], 3);
+
+  for (i = 0; i < rle.size(); i++) {
+    bits.put_code(codelen.code_bits[rle[i].symbol], codelen.code_length[rle[i].symbol]);
+    if (rle[i].extra_bits > 0)
+      bits.put(rle[i].extra_value, rle[i].extra_bits);
+  }
+
+  for (i = 0; i < tokens.size(); i++) {
+    if (tokens[i].length == 0) {
+      c = tokens[i].literal;
+      bits.put_code(litlen.code_bits[c], litlen.code_length[c]);
+      continue;
+    }
+    c = length_code(tokens[i].length);
+    bits.put_code(litlen.code_bits[257 + c], litlen.code_length[257 + c]);
+    if (length_extra[c] > 0)
+      bits.put(tokens[i].length - length_base[c], length_extra[c]);
+    d = distance_code(tokens[i].distance);
+    bits.put_code(dist.code_bits[d], dist.code_length[d]);
+    if (distance_extra[d] > 0)
+      bits.put(tokens[i].distance - distance_base[d], distance_extra[d]);
+  }
+
+  bits.put_code(litlen.code_bits[DEFLATE_END_OF_BLOCK], litlen.code_length[DEFLATE_END_OF_BLOCK]);
+
+  block.clear();
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
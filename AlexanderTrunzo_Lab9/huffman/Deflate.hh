@@ -0,0 +1,115 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// DEFLATE (RFC 1951) and gzip (RFC 1952) output
+//----------------------------------------------------------------------------
+
+#ifndef DEFLATE_HH
+#define DEFLATE_HH
+
+#include "Huffman.hh"
+#include "CodeTable.hh"
+#include "LZ77.hh"
+
+//----------------------------------------------------------------------------
+
+#define DEFLATE_LITLEN_SYMBOLS         286     // 0-255 bytes, 256 end of block, 257-285 lengths
+#define DEFLATE_DISTANCE_SYMBOLS       30
+#define DEFLATE_CODELEN_SYMBOLS        19
+#define DEFLATE_END_OF_BLOCK           256
+#define DEFLATE_MAX_CODE_LENGTH        15
+#define DEFLATE_MAX_CODELEN_LENGTH     7
+#define DEFLATE_WINDOW_BITS            15      // matches reach back at most 32K
+#define DEFLATE_MAX_STORED             65535
+#define DEFAULT_DEFLATE_BLOCK_SIZE     (256 * 1024)
+
+//----------------------------------------------------------------------------
+
+// DEFLATE packs bits LSB first and Huffman codes bit-reversed, the
+// opposite of BitWriter
+
+class DeflateBitWriter
+{
+public:
+
+  DeflateBitWriter(string & out) : output(out) { bits = 0; count = 0; }
+
+  inline void put(unsigned int value, int len)
+  {
+    bits |= (unsigned long long) value << count;
+    count += len;
+    while (count >= 8) {
+      output += (char) (bits & 0xff);
+      bits >>= 8;
+      count -= 8;
+    }
+  }
+
+  // a Huffman code, first bit first
+
+  inline void put_code(unsigned int code, int len)
+  {
+    unsigned int reversed;
+    int i;
+
+    reversed = 0;
+    for (i = 0; i < len; i++)
+      reversed |= ((code >> i) & 1) << (len - 1 - i);
+    put(reversed, len);
+  }
+
+  void align()
+  {
+    if (count > 0)
+      put(0, 8 - count);
+  }
+
+private:
+
+  string & output;
+  unsigned long long bits;
+  int count;
+};
+
+//----------------------------------------------------------------------------
+
+// every block_size input bytes become one DEFLATE block: a dynamic Huffman
+// block whose tables come from that block's histogram (length-limited with
+// CodeTable), or stored blocks if those would be smaller.  with an LZ
+// level, repeats are found first by LZMatcher (window limited to 32K);
+// without one the blocks hold only literals, i.e. plain Huffman coding.
+//
+// unlike the .huf formats every byte value is kept, so gzip -d gives back
+// the original file exactly
+
+class DeflateEncoder
+{
+public:
+
+  DeflateEncoder(ostream &, bool = true, int = DEFAULT_DEFLATE_BLOCK_SIZE, int = 0);
+  ~DeflateEncoder();
+  bool write(const char *, size_t);
+  bool finish();
+  bool copy_from(istream &);
+
+  long long bytes_in, bytes_out;
+
+private:
+
+  void encode_block(bool);
+  bool write_output();
+
+  ostream & outStream;
+  bool gzip;
+  int block_size;
+  LZMatcher *lz;
+  bool started, finished;
+  unsigned int crc;
+  string block;
+  string encoded;
+  DeflateBitWriter bits;
+};
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -6,6 +6,10 @@
 //----------------------------------------------------------------------------
 
 #include "Huffman.hh"
+#include "TableCache.hh"
+#include "StreamCodec.hh"
+#include "Adaptive.hh"
+#include "BitPack.hh"
 
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
@@ -31,6 +35,46 @@ Huffman::Huffman()
 
   code_table_size = 0;
   num_chars = 0;
+
+  table_cache = NULL;
+  debug = debug_flag;
+}
+
+//----------------------------------------------------------------------------
+
+// free a trie and everything below it
+
+static void delete_trie(TrieNode *T)
+{
+  if (T == NULL)
+    return;
+  delete_trie(T->left);
+  delete_trie(T->right);
+  delete T;
+}
+
+//----------------------------------------------------------------------------
+
+// forget everything about the last file so this object can be reused for
+// another one (the table cache, if any, is kept)
+
+void Huffman::reset()
+{
+  int i;
+
+  for (i = 0; i < char_counter.size(); i++)
+    char_counter[i] = 0;
+
+  code_table_size = 0;
+  num_chars = 0;
+
+  while (!trie.empty()) {
+    delete_trie(trie.top());
+    trie.pop();
+  }
+
+  compression_map.clear();
+  decompression_map.clear();
 }
 
 //----------------------------------------------------------------------------
@@ -40,7 +84,7 @@ Huffman::Huffman()
 
 // debug with print_frequencies()
 
-void Huffman::compute_frequencies(ifstream & inStream)
+void Huffman::compute_frequencies(istream & inStream)
 {
   char c;
   int i;
@@ -74,6 +118,28 @@ void Huffman::compute_frequencies(ifstream & inStream)
 
 //----------------------------------------------------------------------------
 
+// same, for n chars already in memory
+
+void Huffman::compute_frequencies(const char *buffer, int n)
+{
+  int i, j;
+
+  for (j = 0; j < n; j++) {
+
+    i = (int) buffer[j];
+
+    if (is_bad_ascii_code(i))
+      continue;
+
+    if (char_counter[i] == 0)
+      code_table_size++;
+
+    char_counter[i]++;
+    num_chars++;
+  }
+}
+//----------------------------------------------------------------------------
+
 // print char counter
 
 void Huffman::print_frequencies()
@@ -109,10 +175,21 @@ void Huffman::build_optimal_trie()
   while (trie.size() > 1)
     merge_two_least_frequent_subtries();
 
-  // populate code table
+  // populate code table (nothing to do for an empty file)
+
+  if (!trie.empty())
+    compute_all_codes_from_trie(trie.top());
+
+  compute_compression_stats();
+}
+
+//----------------------------------------------------------------------------
 
-  compute_all_codes_from_trie(trie.top());
+// sizes of the compressed file under each scheme, plus the padding needed
+// in the last chunk.  assumes compression_map has been filled in
 
+void Huffman::compute_compression_stats()
+{
   // how long would the compressed file be in various forms?
 
   ascii_bits = calculate_ascii_file_size();
@@ -125,7 +202,7 @@ void Huffman::build_optimal_trie()
 
   // report results...
 
-  if (debug_flag) {
+  if (debug) {
     cout << "ASCII: " << ascii_bits << " bits (" << ascii_bytes << " bytes)\n";
     cout << "Custom: " << custom_bits << " bits (" << custom_bytes << " bytes)\n";
     cout << "Huffman: " << huffman_bits << " bits (" << huffman_bytes << " bytes)\n";
@@ -140,6 +217,30 @@ void Huffman::build_optimal_trie()
 
 //----------------------------------------------------------------------------
 
+// get a code table for the current frequencies: reuse one from the table
+// cache if a close enough match is there, otherwise run Huffman's
+// algorithm and offer the result to the cache
+
+void Huffman::build_code_table()
+{
+  CodeTable T;
+
+  if (table_cache != NULL && table_cache->lookup(char_counter, T)) {
+    T.fill_maps(compression_map, decompression_map);
+    compute_compression_stats();
+    if (debug)
+      cout << "using cached code table\n";
+    return;
+  }
+
+  build_optimal_trie();
+
+  if (table_cache != NULL && T.from_compression_map(compression_map))
+    table_cache->store(char_counter, T);
+}
+
+//----------------------------------------------------------------------------
+
 // print char and frequency info for root node of every trie in PQ "forest".
 // does NOT do a full traversal of underlying binary tree
 
@@ -311,7 +412,7 @@ void Huffman::print_decompression_map(ostream & outStream, bool do_binary)
 
 // iterate through mapping between bitcodes and chars, printing pairs
 
-void Huffman::read_decompression_map(ifstream & inStream, bool do_binary)
+void Huffman::read_decompression_map(istream & inStream, bool do_binary)
 {
   char c;
   unsigned char ucx;
@@ -376,17 +477,19 @@ void Huffman::read_decompression_map(ifstream & inStream, bool do_binary)
 
 //----------------------------------------------------------------------------
 
-// fill char buffer from bitstring s and write to file in binary
+// fill char buffer from bitstring s and write to file in binary.  s may
+// hold any whole number of chunks; they are packed together
 
-void Huffman::write_binary_chunk(string & s, ofstream & outStream)
+void Huffman::write_binary_chunk(string & s, ostream & outStream)
 {
-  int i;
-  char buffer[BYTES_PER_CHUNK];
+  int n;
+  string buffer;
 
-  for (i = 0; i < BYTES_PER_CHUNK; i++) 
-    buffer[i] = binary_2_int(s.substr(i * BITS_PER_BYTE, BITS_PER_BYTE));
+  n = (s.length() / BITS_PER_CHUNK) * BYTES_PER_CHUNK;
+  buffer.resize(n);
+  bitpack().pack_ascii(s.data(), n, (unsigned char *) &buffer[0]);
 
-  outStream.write(buffer, BYTES_PER_CHUNK);
+  outStream.write(buffer.data(), n);
 }
 
 //----------------------------------------------------------------------------
@@ -398,10 +501,6 @@ void Huffman::compress(string in_filename, string out_filename, bool do_binary)
 {
   ifstream inStream;
   ofstream outStream;
-  char c;
-  unsigned char ucx;
-  int i;
-  string char_queue, s;
 
   cout << "COMPRESSING to " << out_filename << endl;
 
@@ -414,27 +513,48 @@ void Huffman::compress(string in_filename, string out_filename, bool do_binary)
     exit(1);
   }
 
+  if (do_binary)
+    outStream.open(out_filename.c_str(), ios::binary);
+  else
+    outStream.open(out_filename.c_str());
+
+  compress_stream(inStream, outStream, do_binary);
+
+  // clean up
+
+  inStream.close();
+  outStream.close();
+}
+
+//----------------------------------------------------------------------------
+
+// the work of compress() on already-open streams.  inStream must be
+// seekable, since it is read twice (this is what lets in-memory
+// istringstreams be compressed without touching the disk)
+
+void Huffman::compress_stream(istream & inStream, ostream & outStream, bool do_binary)
+{
+  char c;
+  unsigned char ucx;
+  int i;
+  string char_queue, s;
+
   // FIRST PASS -- compute character statistics, build trie
 
   compute_frequencies(inStream);
-  if (debug_flag)
+  if (debug)
     print_frequencies();
-  build_optimal_trie();
+  build_code_table();
 
   // SECOND PASS -- rewind to beginning of input, encode to output file
 
   inStream.clear();
   inStream.seekg(0);
 
-  if (do_binary)
-    outStream.open(out_filename.c_str(), ios::binary);
-  else
-    outStream.open(out_filename.c_str());
-
   // WRITE code table as header
 
   print_decompression_map(outStream, do_binary);
-  if (debug_flag)
+  if (debug)
     print_decompression_map(cout);
 
   // BINARY ONLY: WRITE excess bit information so decompressor knows when to stop
@@ -465,13 +585,13 @@ void Huffman::compress(string in_filename, string out_filename, bool do_binary)
 
 	char_queue += compression_map[c];
 
-	// if we have enough code bits queued up to write a chunk, turn bit string
-	// into chars and emit them
+	// if we have enough code bits queued up, turn every whole chunk of the
+	// bit string into chars and emit them
 
-	if (char_queue.length() >= BITS_PER_CHUNK) {
-	  s = char_queue.substr(0, BITS_PER_CHUNK);
+	if (char_queue.length() >= BITS_PER_PACK) {
+	  s = char_queue.substr(0, char_queue.length() - char_queue.length() % BITS_PER_CHUNK);
 	  write_binary_chunk(s, outStream);
-	  char_queue.erase(0, BITS_PER_CHUNK);
+	  char_queue.erase(0, s.length());
 	}
       }
 
@@ -483,18 +603,13 @@ void Huffman::compress(string in_filename, string out_filename, bool do_binary)
     }
   }
 
-  // binary only: write remaining data after RIGHT-padding with 0's to fill chunk
+  // binary only: write remaining data after RIGHT-padding with 0's to fill the last chunk
 
   if (do_binary && char_queue.length() > 0) {
-    while (char_queue.length() < BITS_PER_CHUNK)
+    while (char_queue.length() % BITS_PER_CHUNK != 0)
       char_queue += "0";
     write_binary_chunk(char_queue, outStream);
   }
-
-  // clean up
-
-  inStream.close();
-  outStream.close();
 }
 
 //----------------------------------------------------------------------------
@@ -506,9 +621,6 @@ void Huffman::decompress(string in_filename, string out_filename, bool do_binary
 {
   ifstream inStream;
   ofstream outStream;
-  char c;
-  unsigned char ucx;
-  int i, j, file_length, file_pos;
 
   cout << "DECOMPRESSING to " << out_filename << endl;
 
@@ -523,21 +635,54 @@ void Huffman::decompress(string in_filename, string out_filename, bool do_binary
     cout << "Failed to open input file\n";
     exit(1);
   }
-  
+
+  outStream.open(out_filename.c_str());
+
+  decompress_stream(inStream, outStream, do_binary);
+
+  // clean up
+
+  inStream.close();
+  outStream.close();
+}
+
+//----------------------------------------------------------------------------
+
+// the work of decompress() on already-open streams.  returns false if the
+// compressed data didn't decode cleanly
+
+bool Huffman::decompress_stream(istream & inStream, ostream & outStream, bool do_binary)
+{
+  char c;
+  unsigned char ucx;
+  int i, j, file_length, file_pos, start_pos;
+  bool ok = true;
+
+  // block stream files (see StreamCodec.hh) and adaptive ones (see
+  // Adaptive.hh) are recognized by their first byte
+
+  if (do_binary && is_stream_format(inStream)) {
+    StreamDecoder decoder(inStream);
+    return decoder.copy_to(outStream);
+  }
+  if (do_binary && is_adaptive_format(inStream)) {
+    AdaptiveDecoder decoder(inStream);
+    return decoder.copy_to(outStream);
+  }
+
   // need length of file for binary
 
   if (do_binary) {
+    start_pos = inStream.tellg();
     inStream.seekg (0, ios::end);
     file_length = inStream.tellg();
-    inStream.seekg (0, ios::beg);
+    inStream.seekg (start_pos, ios::beg);
   }
 
-  outStream.open(out_filename.c_str());
-
   // READ code table from header
   
   read_decompression_map(inStream, do_binary);
-  if (debug_flag)
+  if (debug)
     print_decompression_map(cout);
 
   // BINARY ONLY: READ excess bit information so decompressor knows when to stop
@@ -553,9 +698,16 @@ void Huffman::decompress(string in_filename, string out_filename, bool do_binary
   map <string, char>::iterator cur;
   char *buffer = new char[BYTES_PER_CHUNK];
   int bits_read = 0;
-  int value, code_len;
+  int value, code_len, max_code_len = 0;
   bool got_a_match;
 
+  // no code is longer than this, so a queue that doesn't start with one
+  // doesn't have to be searched any further (a damaged file could
+  // otherwise queue up every bit it has and search them all, each chunk)
+
+  for (cur = decompression_map.begin(); cur != decompression_map.end(); cur++)
+    max_code_len = max(max_code_len, (int) (*cur).first.length());
+
   if (do_binary) {
 
     while (1) {
@@ -565,8 +717,10 @@ void Huffman::decompress(string in_filename, string out_filename, bool do_binary
       // hit end of file
 
       if (!inStream) {
-	if (inStream.gcount() > 0 || char_queue.size() > 0) 
+	if (inStream.gcount() > 0 || char_queue.size() > 0) {
+	  ok = false;
  	  cout << "binary decompression error: reached end of file with " << inStream.gcount() << " bytes unread and/or non-empty char queue " << char_queue << endl;
+	}
 	break;
       }
 
@@ -578,12 +732,9 @@ void Huffman::decompress(string in_filename, string out_filename, bool do_binary
 	// grab a chunk's worth of bytes, turn into binary, and add to character queue
 	// (aka "bit stream")
 
-	for (j = 0; j < BYTES_PER_CHUNK; j++) {
-	  value = (int) buffer[j];
-	  if (value < 0)
-	    value = 256 + value;	
-	  char_queue += int_2_binary(value, BITS_PER_BYTE);
-	}
+	j = char_queue.length();
+	char_queue.resize(j + BITS_PER_CHUNK);
+	bitpack().unpack_ascii((unsigned char *) buffer, BYTES_PER_CHUNK, &char_queue[j]);
 
 	// if we just got the last bits in the file, snip off padding bits from last byte
 
@@ -604,7 +755,7 @@ void Huffman::decompress(string in_filename, string out_filename, bool do_binary
 	  // try taking substrings from character queue of increasing length
 	  // and seeing if they're legal
 
-	  for (code_len = 1; code_len <= char_queue.length(); code_len++) {
+	  for (code_len = 1; code_len <= char_queue.length() && code_len <= max_code_len; code_len++) {
 	    s = char_queue.substr(0, code_len);
 	    cur = decompression_map.find(s); 
 	    if (cur != decompression_map.end()) {
@@ -620,7 +771,7 @@ void Huffman::decompress(string in_filename, string out_filename, bool do_binary
 
     // how much did we read and what's left?
 
-    if (debug_flag)
+    if (debug)
       cout << "read " << bits_read << " bits\n";
   }
 
@@ -652,8 +803,12 @@ void Huffman::decompress(string in_filename, string out_filename, bool do_binary
 
   delete buffer;
 
-  inStream.close();
-  outStream.close();
+  // anything left over in the text version is a code that never matched
+
+  if (!do_binary && !s.empty())
+    ok = false;
+
+  return ok;
 }
 
 //----------------------------------------------------------------------------
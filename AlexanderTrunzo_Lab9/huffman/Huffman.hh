@@ -4,6 +4,9 @@
 // university of delaware
 //----------------------------------------------------------------------------
 
+#ifndef HUFFMAN_HH
+#define HUFFMAN_HH
+
 #include <iostream>
 #include <ctype.h>
 #include <fstream>
@@ -25,6 +28,7 @@ using namespace std;
 #define BITS_PER_BYTE                  8
 #define BYTES_PER_CHUNK                1      
 #define BITS_PER_CHUNK                 (BYTES_PER_CHUNK*BITS_PER_BYTE)
+#define BITS_PER_PACK                  (4096*BITS_PER_BYTE)   // code bits queued before packing them
 #define BITS_PER_ASCII_CHAR            8
 #define ASCII_TAB                      9
 #define ASCII_NEWLINE                  10
@@ -33,6 +37,10 @@ using namespace std;
 
 //----------------------------------------------------------------------------
 
+class TableCache;
+
+//----------------------------------------------------------------------------
+
 class TrieNode
 {
 public:
@@ -88,9 +96,13 @@ class Huffman
 public:
 
   Huffman();
-  void compute_frequencies(ifstream &);
+  void reset();
+  void compute_frequencies(istream &);
+  void compute_frequencies(const char *, int);
   void print_frequencies();
   void build_optimal_trie();
+  void build_code_table();
+  void compute_compression_stats();
   void merge_two_least_frequent_subtries();
   void print_trie_roots();
   void compute_all_codes_from_trie(TrieNode *);
@@ -99,13 +111,15 @@ public:
   int calculate_huffman_file_size();
   void print_compression_map();
   void print_decompression_map(ostream &, bool = false);
-  void read_decompression_map(ifstream &, bool = false);
+  void read_decompression_map(istream &, bool = false);
   void compress(string, string, bool = false);
   void decompress(string, string, bool = false);
+  void compress_stream(istream &, ostream &, bool = false);
+  bool decompress_stream(istream &, ostream &, bool = false);
   int binary_2_int(string);
   string int_2_binary(int, int);
   int pad_bit_length(int);
-  void write_binary_chunk(string &, ofstream &);
+  void write_binary_chunk(string &, ostream &);
   bool is_bad_ascii_code(int i) 
   { return i < 0 || i >= NUM_ASCII || (i != ASCII_TAB && i != ASCII_NEWLINE && i < ASCII_FIRST_PRINTING); }
 
@@ -136,7 +150,18 @@ public:
 
   map <char, string> compression_map;
   map <string, char> decompression_map;
+
+  // optional source of ready-made tables (NULL to always build from scratch)
+
+  TableCache *table_cache;
+
+  // print tables and statistics as they're built.  copied from the global
+  // -debug flag when the object is made, so engines don't share it
+
+  bool debug;
 };
 
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,302 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// LZ77 match finding ahead of the Huffman coder
+//----------------------------------------------------------------------------
+
+#include "LZ77.hh"
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// per-level settings: chain length, "good enough" match length, lazy?
+
+static const int level_chain[LZ_MAX_LEVEL + 1]  = { 0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096 };
+static const int level_nice[LZ_MAX_LEVEL + 1]   = { 0, 8, 16, 32, 32, 64, 128, 258, 258, 258 };
+
+LZMatcher::LZMatcher(int lev, int bits)
+{
+  level = max(LZ_MIN_LEVEL, min(LZ_MAX_LEVEL, lev));
+  window_bits = max(LZ_MIN_WINDOW_BITS, min(LZ_MAX_WINDOW_BITS, bits));
+
+  max_chain = level_chain[level];
+  nice_length = level_nice[level];
+  lazy = level >= 4;
+}
+
+//----------------------------------------------------------------------------
+
+static inline unsigned int hash3(const char *p)
+{
+  unsigned int x;
+
+  x = (unsigned char) p[0] | ((unsigned char) p[1] << 8) | ((unsigned char) p[2] << 16);
+
+  return (x * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+//----------------------------------------------------------------------------
+
+// add position pos to its hash chain (needs 3 chars to hash)
+
+void LZMatcher::insert(const char *data, int n, int pos)
+{
+  unsigned int h;
+
+  if (pos + LZ_MIN_MATCH > n)
+    return;
+
+  h = hash3(data + pos);
+  prev[pos] = head[h];
+  head[h] = pos;
+}
+
+//----------------------------------------------------------------------------
+
+// longest earlier match for the chars at pos, walking at most max_chain
+// links.  returns its length (0 if none is at least LZ_MIN_MATCH)
+
+int LZMatcher::longest_match(const char *data, int n, int pos, unsigned int & distance)
+{
+  int cand, chain, len, best_len, limit, window;
+
+  if (pos + LZ_MIN_MATCH > n)
+    return 0;
+
+  limit = min(LZ_MAX_MATCH, n - pos);
+  window = 1 << window_bits;
+  best_len = LZ_MIN_MATCH - 1;
+  chain = max_chain;
+
+  for (cand = head[hash3(data + pos)]; cand >= 0 && pos - cand <= window && chain-- > 0; cand = prev[cand]) {
+
+    // a candidate can only win if it also matches at the current best length
+
+    if (data[cand + best_len] != data[pos + best_len])
+      continue;
+
+    for (len = 0; len < limit && data[cand + len] == data[pos + len]; len++)
+      ;
+
+    if (len > best_len) {
+      best_len = len;
+      distance = pos - cand;
+      if (len >= nice_length || len == limit)
+        break;
+    }
+  }
+
+  return best_len >= LZ_MIN_MATCH ? best_len : 0;
+}
+
+//----------------------------------------------------------------------------
+
+// turn n chars into tokens.  every position is put on its hash chain
+// before the search at any later position, including those inside matches
+
+void LZMatcher::parse(const char *data, int n, vector <LZToken> & tokens)
+{
+  LZToken t;
+  unsigned int distance, next_distance;
+  int pos, next_insert, len, next_len;
+
+  head.assign(1 << LZ_HASH_BITS, -1);
+  prev.assign(n, -1);
+  tokens.clear();
+
+  pos = 0;
+  next_insert = 0;
+
+  while (pos < n) {
+
+    while (next_insert < pos)
+      insert(data, n, next_insert++);
+
+    len = longest_match(data, n, pos, distance);
+
+    // lazy: if the match starting one char later is longer, emit this
+    // char as a literal and take that one instead
+
+    if (lazy && len > 0 && len < nice_length && pos + 1 < n) {
+      insert(data, n, next_insert++);
+      next_len = longest_match(data, n, pos + 1, next_distance);
+      if (next_len > len) {
+        t.length = 0;
+        t.literal = data[pos];
+        tokens.push_back(t);
+        pos++;
+        len = next_len;
+        distance = next_distance;
+      }
+    }
+
+    if (len > 0) {
+      t.length = len;
+      t.distance = distance;
+      tokens.push_back(t);
+      pos += len;
+    }
+    else {
+      t.length = 0;
+      t.literal = data[pos];
+      tokens.push_back(t);
+      pos++;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// code table as a count byte and (symbol, length) pairs
+
+void lz_append_table(string & out, CodeTable & T)
+{
+  int i, n;
+
+  n = 0;
+  for (i = 0; i < T.num_symbols; i++)
+    if (T.code_length[i] > 0)
+      n++;
+
+  out += (char) n;
+  for (i = 0; i < T.num_symbols; i++)
+    if (T.code_length[i] > 0) {
+      out += (char) i;
+      out += (char) T.code_length[i];
+    }
+}
+
+//----------------------------------------------------------------------------
+
+// parse, build both tables from the token histogram, and append
+// [literal/length table][distance table][payload] to out.  payload_start
+// is set to where the payload begins in out
+
+void lz_encode_block(const char *data, int n, LZMatcher & matcher, string & out, int & payload_start)
+{
+  vector <LZToken> tokens;
+  vector <int> litlen_counts(LZ_LITLEN_SYMBOLS, 0), distance_counts(LZ_DISTANCE_SYMBOLS, 0);
+  CodeTable litlen(LZ_LITLEN_SYMBOLS), dist(LZ_DISTANCE_SYMBOLS);
+  unsigned int extra_value;
+  int i, code, extra_bits;
+
+  matcher.parse(data, n, tokens);
+
+  for (i = 0; i < tokens.size(); i++) {
+    if (tokens[i].length == 0)
+      litlen_counts[tokens[i].literal]++;
+    else {
+      litlen_counts[LZ_NUM_LITERALS + lz_value_code(tokens[i].length - LZ_MIN_MATCH, extra_bits, extra_value)]++;
+      distance_counts[lz_value_code(tokens[i].distance - 1, extra_bits, extra_value)]++;
+    }
+  }
+
+  litlen.from_counts(litlen_counts, LZ_MAX_CODE_LENGTH);
+  dist.from_counts(distance_counts, LZ_MAX_CODE_LENGTH);
+
+  lz_append_table(out, litlen);
+  lz_append_table(out, dist);
+
+  payload_start = out.length();
+  BitWriter w(out);
+
+  for (i = 0; i < tokens.size(); i++) {
+    if (tokens[i].length == 0) {
+      w.put(litlen.code_bits[tokens[i].literal], litlen.code_length[tokens[i].literal]);
+      continue;
+    }
+    code = LZ_NUM_LITERALS + lz_value_code(tokens[i].length - LZ_MIN_MATCH, extra_bits, extra_value);
+    w.put(litlen.code_bits[code], litlen.code_length[code]);
+    if (extra_bits > 0)
+      w.put(extra_value, extra_bits);
+    code = lz_value_code(tokens[i].distance - 1, extra_bits, extra_value);
+    w.put(dist.code_bits[code], dist.code_length[code]);
+    if (extra_bits > 0)
+      w.put(extra_value, extra_bits);
+  }
+
+  w.flush();
+}
+
+//----------------------------------------------------------------------------
+
+// decode n chars into out.  the loop body is a table lookup, and for a
+// match two more lookups and one memcpy (or a short overlapping copy)
+
+bool lz_decode_block(vector <int> & litlen_lengths, vector <int> & distance_lengths,
+                     const unsigned char *payload, size_t payload_length, char *out, int n, string & message)
+{
+  CodeTable litlen(LZ_LITLEN_SYMBOLS), dist(LZ_DISTANCE_SYMBOLS);
+  DecodeTable L, D;
+  unsigned int length_base[LZ_NUM_LENGTH_CODES], distance_base[LZ_DISTANCE_SYMBOLS];
+  int length_extra[LZ_NUM_LENGTH_CODES], distance_extra[LZ_DISTANCE_SYMBOLS];
+  unsigned int len, distance;
+  int i, o, sym;
+
+  litlen.from_code_lengths(litlen_lengths);
+  dist.from_code_lengths(distance_lengths);
+
+  if (!L.build(litlen) || !D.build(dist)) {
+    message = "LZ code table is not a prefix code";
+    return false;
+  }
+
+  for (i = 0; i < LZ_NUM_LENGTH_CODES; i++) {
+    length_base[i] = lz_code_base(i) + LZ_MIN_MATCH;
+    length_extra[i] = lz_code_extra_bits(i);
+  }
+  for (i = 0; i < LZ_DISTANCE_SYMBOLS; i++) {
+    distance_base[i] = lz_code_base(i) + 1;
+    distance_extra[i] = lz_code_extra_bits(i);
+  }
+
+  BitReader in(payload, payload_length);
+  o = 0;
+
+  while (o < n) {
+
+    sym = L.decode(in);
+
+    if (sym < LZ_NUM_LITERALS) {
+      if (sym < 0)
+        break;
+      out[o++] = (char) sym;
+      continue;
+    }
+
+    sym -= LZ_NUM_LITERALS;
+    len = length_base[sym] + (length_extra[sym] ? in.get(length_extra[sym]) : 0);
+
+    sym = D.decode(in);
+    if (sym < 0)
+      break;
+    distance = distance_base[sym] + (distance_extra[sym] ? in.get(distance_extra[sym]) : 0);
+
+    if (distance > o || len > n - o) {
+      message = "LZ match out of range";
+      return false;
+    }
+
+    if (distance >= len)
+      memcpy(out + o, out + o - distance, len);
+    else
+      for (i = 0; i < len; i++)
+        out[o + i] = out[o + i - distance];
+    o += len;
+  }
+
+  if (o < n) {
+    message = "invalid code in LZ block payload";
+    return false;
+  }
+
+  if (in.bits_consumed() > 8LL * payload_length || (in.bits_consumed() + 7) / 8 != payload_length) {
+    message = "block payload length doesn't match its contents";
+    return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,120 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// LZ77 match finding ahead of the Huffman coder
+//----------------------------------------------------------------------------
+
+#ifndef LZ77_HH
+#define LZ77_HH
+
+#include "Huffman.hh"
+#include "CodeTable.hh"
+
+//----------------------------------------------------------------------------
+
+#define LZ_MIN_MATCH                   3
+#define LZ_MAX_MATCH                   258
+#define LZ_NUM_LITERALS                NUM_ASCII
+#define LZ_NUM_LENGTH_CODES            16      // codes for lengths 3..258
+#define LZ_LITLEN_SYMBOLS              (LZ_NUM_LITERALS + LZ_NUM_LENGTH_CODES)
+#define LZ_MIN_WINDOW_BITS             8
+#define LZ_MAX_WINDOW_BITS             20
+#define LZ_DISTANCE_SYMBOLS            (2 * LZ_MAX_WINDOW_BITS)
+#define LZ_MAX_CODE_LENGTH             15
+#define LZ_MAX_BITS_PER_CHAR           18      // worst case: 3-char match with the longest codes
+#define LZ_HASH_BITS                   15
+#define LZ_MIN_LEVEL                   1
+#define LZ_MAX_LEVEL                   9
+#define DEFAULT_LZ_LEVEL               5
+#define DEFAULT_LZ_WINDOW_BITS         16
+
+//----------------------------------------------------------------------------
+
+// the input is rewritten as a sequence of tokens, each either a literal
+// char or a (length, distance) pair meaning "copy length chars starting
+// distance chars back".  literals and match lengths share one Huffman
+// table (symbols 0..127 are chars, 128.. are length codes), distances get
+// a second table.  lengths and distances are coded as a bucket symbol
+// plus extra bits, like DEFLATE: values 0..3 have their own symbols, and
+// above that each power-of-2 range is split in two buckets
+
+class LZToken
+{
+public:
+  unsigned short length;     // 0 for a literal
+  unsigned char literal;
+  unsigned int distance;
+};
+
+//----------------------------------------------------------------------------
+
+// hash-chain match finder.  level trades speed for ratio: it sets how many
+// earlier positions with the same 3-char hash are tried, how long a match
+// has to be to stop looking, and whether to check one position ahead for
+// a longer match before committing (lazy matching).  matches reach back
+// at most 2^window_bits chars
+
+class LZMatcher
+{
+public:
+
+  LZMatcher(int = DEFAULT_LZ_LEVEL, int = DEFAULT_LZ_WINDOW_BITS);
+  void parse(const char *, int, vector <LZToken> &);
+
+  int level;
+  int window_bits;
+  int max_chain;
+  int nice_length;
+  bool lazy;
+
+private:
+
+  int longest_match(const char *, int, int, unsigned int &);
+  void insert(const char *, int, int);
+
+  vector <int> head;         // most recent position for each hash
+  vector <int> prev;         // previous position with the same hash
+};
+
+//----------------------------------------------------------------------------
+
+// bucket symbol and extra bits for a value (length - LZ_MIN_MATCH or
+// distance - 1), and the reverse
+
+inline int lz_value_code(unsigned int x, int & extra_bits, unsigned int & extra_value)
+{
+  int n, bit;
+
+  if (x < 4) {
+    extra_bits = 0;
+    extra_value = 0;
+    return x;
+  }
+
+  n = 31 - __builtin_clz(x);
+  bit = (x >> (n - 1)) & 1;
+  extra_bits = n - 1;
+  extra_value = x - ((2 + bit) << (n - 1));
+
+  return 2 * n + bit;
+}
+
+inline unsigned int lz_code_base(int code)
+{
+  return code < 4 ? code : (2 + (code & 1)) << (code / 2 - 1);
+}
+
+inline int lz_code_extra_bits(int code)
+{
+  return code < 4 ? 0 : code / 2 - 1;
+}
+
+//----------------------------------------------------------------------------
+
+void lz_encode_block(const char *, int, LZMatcher &, string &, int &);
+bool lz_decode_block(vector <int> &, vector <int> &, const unsigned char *, size_t, char *, int, string &);
+void lz_append_table(string &, CodeTable &);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
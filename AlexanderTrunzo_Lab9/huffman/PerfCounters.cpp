@@ -0,0 +1,165 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// hardware performance counters (Linux perf_event_open) for benchmarks
+//----------------------------------------------------------------------------
+
+#include "PerfCounters.hh"
+
+#include <string.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+static const char *counter_names[NUM_PERF_COUNTERS] = {
+  "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses" };
+
+const char *PerfCounters::name(int which)
+{
+  return counter_names[which];
+}
+
+//----------------------------------------------------------------------------
+
+#ifdef __linux__
+
+// what each counter is, as perf_event_attr type and config
+
+static void counter_event(int which, unsigned int & type, unsigned long long & config)
+{
+  switch (which) {
+  case PERF_CYCLES:
+    type = PERF_TYPE_HARDWARE;
+    config = PERF_COUNT_HW_CPU_CYCLES;
+    break;
+  case PERF_INSTRUCTIONS:
+    type = PERF_TYPE_HARDWARE;
+    config = PERF_COUNT_HW_INSTRUCTIONS;
+    break;
+  case PERF_BRANCH_MISSES:
+    type = PERF_TYPE_HARDWARE;
+    config = PERF_COUNT_HW_BRANCH_MISSES;
+    break;
+  case PERF_L1D_MISSES:
+    type = PERF_TYPE_HW_CACHE;
+    config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    break;
+  default:
+    type = PERF_TYPE_HARDWARE;
+    config = PERF_COUNT_HW_CACHE_MISSES;
+    break;
+  }
+}
+
+// user space only, so it works with perf_event_paranoid up to 2
+
+PerfCounters::PerfCounters()
+{
+  struct perf_event_attr attr;
+  int i, first_errno;
+
+  num_open = 0;
+  first_errno = 0;
+
+  for (i = 0; i < NUM_PERF_COUNTERS; i++) {
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    counter_event(i, attr.type, attr.config);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    counts[i] = 0;
+    if (fd[i] >= 0)
+      num_open++;
+    else {
+      if (first_errno == 0)
+        first_errno = errno;
+      if (!why.empty())
+        why += ", ";
+      why += counter_names[i];
+    }
+  }
+
+  if (num_open == 0)
+    why = string("perf_event_open failed: ") + strerror(first_errno)
+      + (first_errno == EACCES || first_errno == EPERM ? " (check /proc/sys/kernel/perf_event_paranoid)" :
+         first_errno == ENOENT || first_errno == EOPNOTSUPP ? " (no hardware counters, e.g. a VM without a virtual PMU)" : "");
+  else if (!why.empty())
+    why = "not supported here: " + why;
+}
+
+PerfCounters::~PerfCounters()
+{
+  int i;
+
+  for (i = 0; i < NUM_PERF_COUNTERS; i++)
+    if (fd[i] >= 0)
+      close(fd[i]);
+}
+
+//----------------------------------------------------------------------------
+
+void PerfCounters::start()
+{
+  int i;
+
+  for (i = 0; i < NUM_PERF_COUNTERS; i++)
+    if (fd[i] >= 0) {
+      ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounters::stop()
+{
+  unsigned long long buffer[3];     // value, time enabled, time running
+  int i;
+
+  for (i = 0; i < NUM_PERF_COUNTERS; i++)
+    if (fd[i] >= 0)
+      ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+  for (i = 0; i < NUM_PERF_COUNTERS; i++) {
+    if (fd[i] < 0)
+      continue;
+    if (read(fd[i], buffer, sizeof(buffer)) != sizeof(buffer))
+      counts[i] = -1;
+    else if (buffer[2] == 0)
+      counts[i] = 0;
+    else
+      counts[i] = (long long) ((double) buffer[0] * buffer[1] / buffer[2]);
+  }
+}
+
+//----------------------------------------------------------------------------
+
+#else
+
+PerfCounters::PerfCounters()
+{
+  int i;
+
+  for (i = 0; i < NUM_PERF_COUNTERS; i++)
+    fd[i] = -1;
+  num_open = 0;
+  why = "hardware counters are only read on Linux";
+}
+
+PerfCounters::~PerfCounters() {}
+void PerfCounters::start() {}
+void PerfCounters::stop() {}
+
+#endif
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,57 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// hardware performance counters (Linux perf_event_open) for benchmarks
+//----------------------------------------------------------------------------
+
+#ifndef PERFCOUNTERS_HH
+#define PERFCOUNTERS_HH
+
+#include <string>
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+
+#define PERF_CYCLES                    0
+#define PERF_INSTRUCTIONS              1
+#define PERF_BRANCH_MISSES             2
+#define PERF_L1D_MISSES                3
+#define PERF_LLC_MISSES                4
+#define NUM_PERF_COUNTERS              5
+
+//----------------------------------------------------------------------------
+
+// counts user-space events of the calling thread between start() and
+// stop().  each counter is opened on its own, so if some event doesn't
+// exist here (LLC misses often don't in VMs) the others still work; if
+// none can be opened (no PMU, perf_event_paranoid too high, seccomp, not
+// Linux) available() is false and why says so.  counters the kernel had
+// to multiplex are scaled up by enabled/running time
+
+class PerfCounters
+{
+public:
+
+  PerfCounters();
+  ~PerfCounters();
+  bool available() { return num_open > 0; }
+  bool has(int which) { return fd[which] >= 0; }
+  void start();
+  void stop();
+  long long value(int which) { return fd[which] >= 0 ? counts[which] : -1; }
+
+  static const char *name(int);
+
+  string why;                // why counters are missing, if any are
+
+private:
+
+  int fd[NUM_PERF_COUNTERS];
+  long long counts[NUM_PERF_COUNTERS];
+  int num_open;
+};
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,209 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// framed request/response protocol for the compression daemon
+//----------------------------------------------------------------------------
+
+#include "Protocol.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// returns connected fd, or -1
+
+int connect_unix_socket(string path)
+{
+  struct sockaddr_un addr;
+  int fd;
+
+  if (path.length() >= sizeof(addr.sun_path))
+    return -1;
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+
+  if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+//----------------------------------------------------------------------------
+
+// read/write exactly n bytes, riding out short transfers and signals
+
+bool read_fully(int fd, char *buffer, size_t n)
+{
+  ssize_t got;
+
+  while (n > 0) {
+    got = read(fd, buffer, n);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      return false;
+    buffer += got;
+    n -= got;
+  }
+
+  return true;
+}
+
+bool write_fully(int fd, const char *buffer, size_t n)
+{
+  ssize_t put;
+
+  while (n > 0) {
+    put = write(fd, buffer, n);
+    if (put < 0 && errno == EINTR)
+      continue;
+    if (put <= 0)
+      return false;
+    buffer += put;
+    n -= put;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+bool send_frame(int fd, unsigned char op, unsigned char flags, const string & payload)
+{
+  unsigned char header[FRAME_HEADER_BYTES];
+  unsigned int len;
+
+  if (payload.length() > MAX_FRAME_PAYLOAD)
+    return false;
+  len = payload.length();
+
+  header[0] = op;
+  header[1] = flags;
+  header[2] = len & 0xff;
+  header[3] = (len >> 8) & 0xff;
+  header[4] = (len >> 16) & 0xff;
+  header[5] = (len >> 24) & 0xff;
+
+  return write_fully(fd, (char *) header, FRAME_HEADER_BYTES) && write_fully(fd, payload.data(), len);
+}
+
+//----------------------------------------------------------------------------
+
+// false on clean close, short read, or oversized frame
+
+bool recv_frame(int fd, unsigned char & op, unsigned char & flags, string & payload)
+{
+  unsigned char header[FRAME_HEADER_BYTES];
+  unsigned int len;
+
+  if (!read_fully(fd, (char *) header, FRAME_HEADER_BYTES))
+    return false;
+
+  op = header[0];
+  flags = header[1];
+  len = header[2] | (header[3] << 8) | (header[4] << 16) | ((unsigned int) header[5] << 24);
+
+  if (len > MAX_FRAME_PAYLOAD)
+    return false;
+
+  payload.resize(len);
+
+  return len == 0 || read_fully(fd, &payload[0], len);
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+LatencyStats::LatencyStats()
+{
+  memset(buckets, 0, sizeof(buckets));
+  total = 0;
+  max_seen = 0;
+}
+
+//----------------------------------------------------------------------------
+
+// bucket b holds [2^(b / k), 2^((b + 1) / k)) microseconds, k buckets per
+// doubling; anything under 1 us goes in bucket 0, anything too big in the
+// last one
+
+void LatencyStats::add(double microseconds)
+{
+  int b;
+
+  b = microseconds < 1 ? 0 : (int) (log2(microseconds) * LATENCY_BUCKETS_PER_DOUBLING);
+  b = min(b, LATENCY_BUCKETS - 1);
+
+  lock_guard <mutex> guard(lock);
+
+  buckets[b]++;
+  total++;
+  max_seen = max(max_seen, microseconds);
+}
+
+//----------------------------------------------------------------------------
+
+long long LatencyStats::count()
+{
+  lock_guard <mutex> guard(lock);
+
+  return total;
+}
+
+//----------------------------------------------------------------------------
+
+// p in [0, 1] -- nearest-rank percentile, to the top of its bucket
+
+double LatencyStats::percentile(double p)
+{
+  long long rank, seen;
+  int b;
+
+  lock_guard <mutex> guard(lock);
+
+  if (total == 0)
+    return 0;
+
+  rank = max(1LL, (long long) ceil(p * total));
+  seen = 0;
+  for (b = 0; b < LATENCY_BUCKETS - 1; b++) {
+    seen += buckets[b];
+    if (seen >= rank)
+      break;
+  }
+
+  return min(max_seen, exp2((double) (b + 1) / LATENCY_BUCKETS_PER_DOUBLING));
+}
+
+//----------------------------------------------------------------------------
+
+void LatencyStats::print(ostream & outStream, string label)
+{
+  outStream << label << ": " << count() << " requests, p50 " << percentile(0.50)
+            << " us, p99 " << percentile(0.99) << " us, max " << percentile(1.0) << " us\n";
+}
+
+//----------------------------------------------------------------------------
+
+double now_microseconds()
+{
+  return chrono::duration <double, micro> (chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
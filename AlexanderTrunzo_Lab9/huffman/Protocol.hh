@@ -0,0 +1,85 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// framed request/response protocol for the compression daemon
+//----------------------------------------------------------------------------
+
+#ifndef PROTOCOL_HH
+#define PROTOCOL_HH
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <iostream>
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+
+// every message in either direction is one frame:
+//
+//   1 byte   op (request) or status (response)
+//   1 byte   flags
+//   4 bytes  payload length, little-endian
+//   N bytes  payload
+//
+// a connection carries any number of request/response pairs, one at a
+// time, until the client closes it
+
+#define OP_COMPRESS                    'C'     // payload: raw text
+#define OP_DECOMPRESS                  'D'     // payload: .huf contents
+#define OP_STATS                       'S'     // payload: empty; reply is text
+
+#define FLAG_ASCII                     0x01    // use the -ascii ('0'/'1' text) format
+
+#define STATUS_OK                      0
+#define STATUS_ERROR                   1
+
+#define FRAME_HEADER_BYTES             6
+#define MAX_FRAME_PAYLOAD              (1 << 30)
+
+//----------------------------------------------------------------------------
+
+int connect_unix_socket(string);
+bool read_fully(int, char *, size_t);
+bool write_fully(int, const char *, size_t);
+bool send_frame(int, unsigned char, unsigned char, const string &);
+bool recv_frame(int, unsigned char &, unsigned char &, string &);
+
+//----------------------------------------------------------------------------
+
+#define LATENCY_BUCKETS_PER_DOUBLING   8       // bucket width about 9%
+#define LATENCY_BUCKETS                (32 * LATENCY_BUCKETS_PER_DOUBLING)   // 1 us to over an hour
+
+// request latencies in microseconds, for p50/p99 reporting.  a daemon
+// runs indefinitely, so samples aren't kept: each one is counted in a
+// bucket of a log-scale histogram, and a percentile is read off the
+// bucket counts.  memory and the cost of a stats query stay fixed; the
+// percentiles are the top of their bucket (but never above the max), so
+// within about 9%
+
+class LatencyStats
+{
+public:
+
+  LatencyStats();
+  void add(double);
+  long long count();
+  double percentile(double);
+  void print(ostream &, string);
+
+private:
+
+  long long buckets[LATENCY_BUCKETS];
+  long long total;
+  double max_seen;
+  mutex lock;
+};
+
+//----------------------------------------------------------------------------
+
+double now_microseconds();
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,202 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// batches of small records sharing one code table, with random access
+//----------------------------------------------------------------------------
+
+#include "RecordCodec.hh"
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+static bool book_covers(CodeBookPtr book, const vector <string> & records)
+{
+  size_t i;
+
+  for (i = 0; i < records.size(); i++)
+    if (!book->covers(records[i].data(), records[i].length()))
+      return false;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+bool encode_records(const vector <string> & records, string & out, CodeBookPtr book, unsigned char flags)
+{
+  vector <int> counts(RECORD_SYMBOLS, 0);
+  string payload;
+  size_t i, j;
+  int c, n;
+
+  if (!book || book->table().num_symbols > RECORD_SYMBOLS || !book_covers(book, records)) {
+    for (i = 0; i < records.size(); i++)
+      for (j = 0; j < records[i].length(); j++)
+        counts[(unsigned char) records[i][j]]++;
+    book = CodeBook::from_counts(counts);
+    if (!book)
+      return false;
+  }
+
+  const CodeTable & T = book->table();
+
+  out.clear();
+  out.append(RECORD_MAGIC, RECORD_MAGIC_BYTES);
+  append_u32(out, records.size());
+  out += (char) flags;
+
+  n = 0;
+  for (c = 0; c < T.num_symbols; c++)
+    if (T.code_length[c] > 0)
+      n++;
+  out += (char) (n & 0xff);
+  out += (char) (n >> 8);
+  for (c = 0; c < T.num_symbols; c++)
+    if (T.code_length[c] > 0) {
+      out += (char) c;
+      out += (char) T.code_length[c];
+    }
+
+  // offsets and lengths, then the payloads one after another
+
+  for (i = 0; i < records.size(); i++) {
+    if (records[i].length() > MAX_RECORD_BYTES)
+      return false;
+    append_u32(out, payload.length());
+    book->encode(records[i].data(), records[i].length(), payload);
+  }
+  append_u32(out, payload.length());
+  for (i = 0; i < records.size(); i++) {
+    out += (char) (records[i].length() & 0xff);
+    out += (char) (records[i].length() >> 8);
+  }
+
+  out += payload;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+bool RecordReader::open(const string & batch, string & message)
+{
+  CodeTable T(RECORD_SYMBOLS);
+  vector <int> code_lengths(RECORD_SYMBOLS, 0);
+  const unsigned char *p;
+  size_t pos, i, payload_bytes;
+  int n, c, len;
+
+  data = (const unsigned char *) batch.data();
+  length = batch.length();
+  count = 0;
+  book.reset();
+  p = data;
+
+  if (length < RECORD_MAGIC_BYTES + 7 || memcmp(p, RECORD_MAGIC, RECORD_MAGIC_BYTES)) {
+    message = "not a record batch";
+    return false;
+  }
+  pos = RECORD_MAGIC_BYTES;
+  count = read_u32(p + pos);
+  pos += 4;
+  header_flags = p[pos++];
+  n = p[pos] | (p[pos + 1] << 8);
+  pos += 2;
+
+  if (n > RECORD_SYMBOLS || length - pos < 2 * (size_t) n) {
+    message = "truncated or corrupt code table";
+    return false;
+  }
+  for (i = 0; i < n; i++) {
+    c = p[pos++];
+    len = p[pos++];
+    if (len < 1 || len > MAX_CODEBOOK_CODE_LENGTH || code_lengths[c] != 0) {
+      message = "truncated or corrupt code table";
+      return false;
+    }
+    code_lengths[c] = len;
+  }
+
+  T.from_code_lengths(code_lengths);
+  book = CodeBook::from_table(T);
+  if (!book) {
+    message = "code table is not a prefix code";
+    return false;
+  }
+
+  // the arrays must fit, offsets must not decrease, and the last one must
+  // end the batch exactly
+
+  if ((length - pos) / 6 < count || length - pos - 6 * count < 4) {
+    message = "truncated offset array";
+    return false;
+  }
+  offsets = p + pos;
+  lengths = offsets + 4 * (count + 1);
+  payload = lengths + 2 * count;
+  payload_bytes = data + length - payload;
+
+  if (read_u32(offsets + 4 * count) != payload_bytes) {
+    message = "payload size doesn't match offset array";
+    return false;
+  }
+  for (i = 0; i < count; i++)
+    if (read_u32(offsets + 4 * i) > read_u32(offsets + 4 * (i + 1))) {
+      message = "corrupt offset array";
+      return false;
+    }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+size_t RecordReader::record_length(size_t i) const
+{
+  return i < count ? lengths[2 * i] | (lengths[2 * i + 1] << 8) : 0;
+}
+
+//----------------------------------------------------------------------------
+
+// decode record i into out, which has room for record_length(i) bytes.
+// the record's bits must end in its last byte
+
+bool RecordReader::get(size_t i, char *out) const
+{
+  unsigned int start, end;
+  long long used;
+
+  if (i >= count)
+    return false;
+
+  start = read_u32(offsets + 4 * i);
+  end = read_u32(offsets + 4 * (i + 1));
+
+  used = book->decode(payload + start, end - start, out, record_length(i));
+
+  return used >= 0 && (used + 7) / 8 == end - start;
+}
+
+bool RecordReader::get(size_t i, string & record) const
+{
+  record.resize(record_length(i));
+
+  return get(i, &record[0]);
+}
+
+//----------------------------------------------------------------------------
+
+bool RecordReader::decode_all(vector <string> & records) const
+{
+  size_t i;
+
+  records.resize(count);
+  for (i = 0; i < count; i++)
+    if (!get(i, records[i]))
+      return false;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,84 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// batches of small records sharing one code table, with random access
+//----------------------------------------------------------------------------
+
+#ifndef RECORDCODEC_HH
+#define RECORDCODEC_HH
+
+#include "Huffman.hh"
+#include "CodeBook.hh"
+
+//----------------------------------------------------------------------------
+
+// record batch format.  compressing each small record on its own costs a
+// code table per record, which can be bigger than the record itself.  a
+// batch stores one table for all of its records instead, and each record
+// is a separate byte-aligned bitstream, so any one of them can be decoded
+// without touching the others
+//
+//   4 bytes        magic F1 'R' 'E' 'C'
+//   4 bytes        number of records, R
+//   1 byte         flags
+//   2 bytes        number of byte values with codes, n
+//   n pairs        (byte, code length) -- codes are canonical
+//   (R + 1) x 4    start of each record's payload, from the start of the
+//                  payload area; the last entry is the payload area's size
+//   R x 2          number of bytes in each record
+//   payload area   each record's codes, MSB first, padded to a whole byte
+//
+// integers are little-endian.  unlike the .huf formats, records are
+// binary-safe: all 256 byte values can be coded
+
+#define RECORD_MAGIC                   "\xF1REC"
+#define RECORD_MAGIC_BYTES             4
+#define RECORD_SYMBOLS                 256
+#define MAX_RECORD_BYTES               65535   // so a record's length fits in 2 bytes
+
+#define RECORD_FINAL_NEWLINE           0x01    // lines of a file whose last line ended in '\n'
+
+//----------------------------------------------------------------------------
+
+// batch encode.  with a book, records are coded with it if it covers
+// every byte they hold (e.g. a table trained on earlier batches);
+// otherwise a table is built from the batch itself.  flags are stored as
+// given, for the caller
+
+bool encode_records(const vector <string> &, string &, CodeBookPtr = CodeBookPtr(), unsigned char = 0);
+
+//----------------------------------------------------------------------------
+
+// random access to an encoded batch.  open() checks the header and the
+// offset array and builds the shared CodeBook; after that get() decodes
+// record i with two array lookups and one bitstream decode.  the reader
+// doesn't copy the batch, which must outlive it.  const members can be
+// called from any number of threads at once
+
+class RecordReader
+{
+public:
+
+  RecordReader() { data = NULL; length = 0; count = 0; header_flags = 0; }
+  bool open(const string &, string &);
+  size_t size() const { return count; }
+  unsigned char flags() const { return header_flags; }
+  size_t record_length(size_t) const;
+  bool get(size_t, string &) const;
+  bool get(size_t, char *) const;
+  bool decode_all(vector <string> &) const;
+
+  CodeBookPtr book;
+
+private:
+
+  const unsigned char *data;
+  size_t length;
+  size_t count;
+  unsigned char header_flags;
+  const unsigned char *offsets, *lengths, *payload;
+};
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,474 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// substring search in .huf files without writing the decompressed text
+//----------------------------------------------------------------------------
+
+#include "Search.hh"
+#include "Verify.hh"
+#include "Adaptive.hh"
+
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// a match found inside one chunk, with its offset and line relative to the
+// chunk.  open_start / open_end: its line carries on into the previous /
+// next chunk
+
+class ChunkMatch
+{
+public:
+  size_t offset;
+  long long line;
+  string text;
+  bool open_start, open_end;
+};
+
+// what's left of one chunk after searching it
+
+class ChunkScan
+{
+public:
+
+  ChunkScan() { chars = 0; newlines = 0; }
+
+  size_t chars;
+  long long newlines;
+  string head;               // chars before the first newline (all of them if none)
+  string tail;               // chars after the last newline
+  string first, last;        // first and last pattern length - 1 chars
+  vector <ChunkMatch> matches;
+};
+
+//----------------------------------------------------------------------------
+
+static void scan_chunk(const char *chars, size_t n, const string & pattern, bool look, ChunkScan & scan)
+{
+  const char *p, *q, *nl, *end;
+  ChunkMatch m;
+  long long line;
+  size_t edge;
+
+  end = chars + n;
+  scan.chars = n;
+  scan.newlines = count(chars, end, '\n');
+
+  nl = (const char *) memchr(chars, '\n', n);
+  scan.head.assign(chars, min((size_t) SEARCH_MAX_LINE_CHARS, nl ? nl - chars : n));
+  nl = (const char *) memrchr(chars, '\n', n);
+  p = nl ? nl + 1 : chars;
+  if (end - p > SEARCH_MAX_LINE_CHARS)
+    p = end - SEARCH_MAX_LINE_CHARS;
+  scan.tail.assign(p, end);
+
+  edge = min(n, pattern.length() - 1);
+  scan.first.assign(chars, edge);
+  scan.last.assign(end - edge, edge);
+
+  if (!look)
+    return;
+
+  // every occurrence, including overlapping ones.  line numbers are kept
+  // up to date by counting newlines between one match and the next
+
+  line = 0;
+  p = chars;
+  for (q = chars; q < end && (q = (const char *) memmem(q, end - q, pattern.data(), pattern.length())) != NULL; q++) {
+    line += count(p, q, '\n');
+    p = q;
+
+    m.offset = q - chars;
+    m.line = line;
+    nl = (const char *) memrchr(chars, '\n', q - chars);
+    m.open_start = nl == NULL;
+    m.text.assign(nl ? nl + 1 : chars, q);
+    nl = (const char *) memchr(q, '\n', end - q);
+    m.open_end = nl == NULL;
+    m.text.append(q, nl ? nl : end);
+    scan.matches.push_back(m);
+  }
+}
+
+//----------------------------------------------------------------------------
+
+// the rest of a line that starts before chunk b (text from earlier
+// chunks' tails), and the rest of one that carries on after chunk b
+
+static string line_before(vector <ChunkScan> & scans, int b)
+{
+  string text;
+  int k;
+
+  for (k = b - 1; k >= 0 && text.length() < SEARCH_MAX_LINE_CHARS; k--) {
+    text.insert(0, scans[k].tail);
+    if (scans[k].newlines > 0)
+      break;
+  }
+
+  return text;
+}
+
+static string line_after(vector <ChunkScan> & scans, int b)
+{
+  string text;
+  int k;
+
+  for (k = b + 1; k < scans.size() && text.length() < SEARCH_MAX_LINE_CHARS; k++) {
+    text += scans[k].head;
+    if (scans[k].newlines > 0)
+      break;
+  }
+
+  return text;
+}
+
+//----------------------------------------------------------------------------
+
+// put the chunks' results together in order: global offsets and line
+// numbers, lines completed across chunks, and the matches that straddle
+// the boundary after each chunk.  those lie on the chunk's last line,
+// since a pattern has no newline
+
+static void collect_matches(vector <ChunkScan> & scans, const string & pattern, vector <SearchMatch> & matches)
+{
+  SearchMatch m;
+  string edge, ahead;
+  long long start, line_base;
+  size_t s, want;
+  int b, i, k;
+
+  matches.clear();
+  start = 0;
+  line_base = 0;
+
+  for (b = 0; b < scans.size(); b++) {
+
+    for (i = 0; i < scans[b].matches.size(); i++) {
+      ChunkMatch & cm = scans[b].matches[i];
+      m.offset = start + cm.offset;
+      m.line = line_base + cm.line + 1;
+      m.text = cm.text;
+      if (cm.open_start)
+        m.text.insert(0, line_before(scans, b));
+      if (cm.open_end)
+        m.text += line_after(scans, b);
+      if (m.text.length() > SEARCH_MAX_LINE_CHARS)
+        m.text.resize(SEARCH_MAX_LINE_CHARS);
+      matches.push_back(m);
+    }
+
+    // chars after the boundary, from as many chunks as it takes
+
+    edge = scans[b].last;
+    want = pattern.length() - 1;
+    ahead.clear();
+    for (k = b + 1; k < scans.size() && ahead.length() < want; k++)
+      ahead += scans[k].first.substr(0, want - ahead.length());
+    edge += ahead;
+
+    for (s = 0; s < scans[b].last.length() && s + pattern.length() <= edge.length(); s++)
+      if (!edge.compare(s, pattern.length(), pattern)) {
+        m.offset = start + scans[b].chars - scans[b].last.length() + s;
+        m.line = line_base + scans[b].newlines + 1;
+        m.text = scans[b].tail;
+        if (scans[b].newlines == 0)
+          m.text.insert(0, line_before(scans, b));
+        m.text += line_after(scans, b);
+        if (m.text.length() > SEARCH_MAX_LINE_CHARS)
+          m.text.resize(SEARCH_MAX_LINE_CHARS);
+        matches.push_back(m);
+      }
+
+    start += scans[b].chars;
+    line_base += scans[b].newlines;
+  }
+}
+
+//----------------------------------------------------------------------------
+
+// can a Huffman block with these code lengths contain the pattern?
+
+static bool block_may_match(BlockHeader & h, const string & pattern)
+{
+  int i, j, c;
+  bool coded;
+
+  if (h.type == BLOCK_LZ_CRC || h.type == BLOCK_BWT_CRC)
+    return true;
+
+  // column blocks: some column's table has to have each char
+
+  for (i = 0; i < pattern.length(); i++) {
+    c = (unsigned char) pattern[i];
+    if (c >= NUM_ASCII)
+      return false;
+    coded = h.lengths[c] > 0;
+    for (j = 1; !coded && j < h.column_lengths.size(); j++)
+      coded = h.column_lengths[j][c] > 0;
+    if (!coded)
+      return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+static bool search_stream(const string & data, const string & pattern, vector <ChunkScan> & scans,
+                          int num_threads, string & message)
+{
+  vector <BlockLocation> locations;
+  const unsigned char *p;
+  atomic <int> next_block(0);
+  atomic <bool> failed(false);
+  vector <thread> workers;
+  mutex message_lock;
+  int i;
+
+  if (!index_stream_blocks(data, locations, message))
+    return false;
+
+  scans.resize(locations.size());
+  p = (const unsigned char *) data.data();
+
+  num_threads = max(1, min(num_threads, (int) locations.size()));
+
+  for (i = 0; i < num_threads; i++)
+    workers.push_back(thread([&]() {
+      string scratch, why;
+      int b;
+
+      while (!failed && (b = next_block++) < locations.size()) {
+        BlockHeader & h = locations[b].header;
+        scratch.resize(h.num_chars);
+        if (!decode_block(h, p + locations[b].payload_offset, &scratch[0], why)) {
+          lock_guard <mutex> guard(message_lock);
+          if (!failed) {
+            ostringstream where;
+            where << "block " << b << ": " << why;
+            message = where.str();
+          }
+          failed = true;
+          continue;
+        }
+        scan_chunk(scratch.data(), h.num_chars, pattern, block_may_match(h, pattern), scans[b]);
+      }
+    }));
+
+  for (i = 0; i < workers.size(); i++)
+    workers[i].join();
+
+  return !failed;
+}
+
+//----------------------------------------------------------------------------
+
+// old-style binary file: one bitstream, decoded a chunk at a time into the
+// same scratch buffer
+
+static bool search_legacy(const string & data, const string & pattern, vector <ChunkScan> & scans, string & message)
+{
+  istringstream inStream(data);
+  map <string, char>::iterator cur;
+  map <char, string> codes;
+  CodeTable T;
+  DecodeTable D;
+  Huffman H;
+  ChunkScan scan;
+  string scratch;
+  unsigned char bad_bits;
+  long long total_bits;
+  size_t payload_start, n;
+  int c;
+
+  H.read_decompression_map(inStream, true);
+  bad_bits = inStream.get();
+  if (!inStream || bad_bits >= BITS_PER_BYTE) {
+    message = "truncated or corrupt header";
+    return false;
+  }
+  payload_start = inStream.tellg();
+
+  for (cur = H.decompression_map.begin(); cur != H.decompression_map.end(); cur++)
+    codes[(*cur).second] = (*cur).first;
+
+  // codes too long for a CodeTable: let the string decoder do it
+
+  if (!T.from_compression_map(codes)) {
+    ostringstream text;
+    inStream.seekg(0);
+    if (!H.decompress_stream(inStream, text, true)) {
+      message = "decoding error";
+      return false;
+    }
+    scratch = text.str();
+    scans.push_back(scan);
+    scan_chunk(scratch.data(), scratch.length(), pattern, true, scans.back());
+    return true;
+  }
+
+  if (!D.build(T)) {
+    message = "code table is not a prefix code";
+    return false;
+  }
+
+  total_bits = 8LL * (data.length() - payload_start) - bad_bits;
+  BitReader in((const unsigned char *) data.data() + payload_start, data.length() - payload_start);
+  scratch.resize(SEARCH_CHUNK_CHARS);
+
+  while (in.bits_consumed() < total_bits) {
+    for (n = 0; n < SEARCH_CHUNK_CHARS && in.bits_consumed() < total_bits; n++) {
+      c = D.decode(in);
+      if (c < 0) {
+        message = "invalid code";
+        return false;
+      }
+      scratch[n] = (char) c;
+    }
+    scans.push_back(scan);
+    scan_chunk(scratch.data(), n, pattern, true, scans.back());
+  }
+
+  if (in.bits_consumed() != total_bits) {
+    message = "last code runs into padding";
+    return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// -ascii file: decoded whole, since the string decoder can't stop part way
+
+static bool search_ascii(const string & data, const string & pattern, vector <ChunkScan> & scans, string & message)
+{
+  istringstream inStream(data);
+  ostringstream text;
+  string chars;
+  Huffman H;
+
+  if (!H.decompress_stream(inStream, text, false)) {
+    message = "decoding error";
+    return false;
+  }
+  chars = text.str();
+
+  scans.resize(1);
+  scan_chunk(chars.data(), chars.length(), pattern, true, scans[0]);
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// adaptive files can only be decoded from the start, so the whole text is
+// one chunk
+
+static bool search_adaptive(const string & data, const string & pattern, vector <ChunkScan> & scans, string & message)
+{
+  istringstream inStream(data);
+  ostringstream text;
+  AdaptiveDecoder decoder(inStream);
+  string chars;
+
+  if (!decoder.copy_to(text)) {
+    message = decoder.message;
+    return false;
+  }
+  chars = text.str();
+
+  scans.resize(1);
+  scan_chunk(chars.data(), chars.length(), pattern, true, scans[0]);
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+bool search_buffer(const string & data, const string & pattern, vector <SearchMatch> & matches,
+                   bool do_binary, int num_threads, string & message)
+{
+  vector <ChunkScan> scans;
+  bool ok;
+
+  matches.clear();
+
+  if (pattern.empty() || pattern.find('\n') != string::npos) {
+    message = "pattern must be non-empty and can't contain a newline";
+    return false;
+  }
+
+  if (do_binary && data.length() >= STREAM_MAGIC_BYTES && !memcmp(data.data(), STREAM_MAGIC, STREAM_MAGIC_BYTES))
+    ok = search_stream(data, pattern, scans, num_threads, message);
+  else if (do_binary && !data.empty() && (unsigned char) data[0] == ADAPTIVE_MAGIC)
+    ok = search_adaptive(data, pattern, scans, message);
+  else if (do_binary)
+    ok = search_legacy(data, pattern, scans, message);
+  else
+    ok = search_ascii(data, pattern, scans, message);
+
+  if (ok)
+    collect_matches(scans, pattern, matches);
+
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+
+bool search_file(string filename, const string & pattern, vector <SearchMatch> & matches,
+                 bool do_binary, int num_threads, string & message)
+{
+  string data;
+
+  if (!read_whole_file(filename, data)) {
+    message = "can't open file";
+    return false;
+  }
+
+  return search_buffer(data, pattern, matches, do_binary, num_threads, message);
+}
+
+//----------------------------------------------------------------------------
+
+// grep-style output, one line per match: [file:]line:offset:text, with
+// the file name only when there's more than one file.  returns the number
+// of matches, or -1 if any file couldn't be searched
+
+long long search_files(vector <string> & filenames, const string & pattern, bool do_binary,
+                       int num_threads, ostream & outStream)
+{
+  vector <SearchMatch> matches;
+  string message;
+  long long total;
+  bool failed;
+  int f, i;
+
+  total = 0;
+  failed = false;
+
+  for (f = 0; f < filenames.size(); f++) {
+    if (!search_file(filenames[f], pattern, matches, do_binary, num_threads, message)) {
+      cerr << filenames[f] << ": " << message << endl;
+      failed = true;
+      continue;
+    }
+    for (i = 0; i < matches.size(); i++) {
+      if (filenames.size() > 1)
+        outStream << filenames[f] << ":";
+      outStream << matches[i].line << ":" << matches[i].offset << ":" << matches[i].text << "\n";
+    }
+    total += matches.size();
+  }
+
+  outStream.flush();
+
+  return failed ? -1 : total;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
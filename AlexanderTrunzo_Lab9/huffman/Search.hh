@@ -0,0 +1,50 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// substring search in .huf files without writing the decompressed text
+//----------------------------------------------------------------------------
+
+#ifndef SEARCH_HH
+#define SEARCH_HH
+
+#include "Huffman.hh"
+#include "StreamCodec.hh"
+
+//----------------------------------------------------------------------------
+
+#define SEARCH_MAX_LINE_CHARS          1024    // longer lines are shown cut short
+#define SEARCH_CHUNK_CHARS             (64 * 1024)   // old-style files are scanned this much at a time
+
+//----------------------------------------------------------------------------
+
+// one occurrence of the pattern.  offsets and line numbers are in the
+// decompressed text, i.e. what decompress() would write to the .HUF file
+
+class SearchMatch
+{
+public:
+  long long offset;          // of the match's first char, from 0
+  long long line;            // from 1
+  string text;               // the whole line (at most SEARCH_MAX_LINE_CHARS)
+};
+
+//----------------------------------------------------------------------------
+
+// decoded text is searched a chunk at a time and never written anywhere:
+// a block of a stream file (blocks are decoded on up to num_threads
+// threads) or SEARCH_CHUNK_CHARS of an old-style file.  each chunk keeps
+// only its matches, its newline count and the ends of its first and last
+// lines, from which line numbers and matches that straddle two chunks are
+// worked out afterwards.
+//
+// in a stream file, a Huffman block whose code table has no code for one
+// of the pattern's chars can't contain a match, so it's decoded only to
+// count its lines.  patterns are literal and can't contain a newline
+
+bool search_buffer(const string &, const string &, vector <SearchMatch> &, bool, int, string &);
+bool search_file(string, const string &, vector <SearchMatch> &, bool, int, string &);
+long long search_files(vector <string> &, const string &, bool, int, ostream &);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,1046 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// incremental block-wise encoder and decoder for pipes and sockets
+//----------------------------------------------------------------------------
+
+#include "StreamCodec.hh"
+#include "Checksum.hh"
+#include "BitPack.hh"
+
+#include <thread>
+#include <atomic>
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+StreamEncoder::StreamEncoder(ostream & out, int size, TableCache *cache) : outStream(out)
+{
+  block_size = size;
+  if (block_size < 1)
+    block_size = DEFAULT_STREAM_BLOCK_SIZE;
+  if (block_size > MAX_STREAM_BLOCK_SIZE)
+    block_size = MAX_STREAM_BLOCK_SIZE;
+
+  started = finished = false;
+  bytes_in = bytes_out = 0;
+  blocks = 0;
+
+  H.table_cache = cache;
+  block.reserve(block_size);
+  lz = NULL;
+  splitter = NULL;
+  reuse_tables = false;
+  reused_tables = 0;
+  columns = NULL;
+  column = 0;
+  column_blocks = 0;
+  bwt_threads = 0;
+}
+
+//----------------------------------------------------------------------------
+
+// an encoder that goes out of scope still leaves a complete stream behind
+
+StreamEncoder::~StreamEncoder()
+{
+  finish();
+  delete lz;
+  delete splitter;
+  delete columns;
+}
+
+//----------------------------------------------------------------------------
+
+// run every block through an LZ77 matcher at this level (1 = fastest,
+// 9 = best ratio) before Huffman coding.  matches only reach back within
+// a block, so bigger blocks help
+
+void StreamEncoder::set_lz(int level, int window_bits)
+{
+  delete lz;
+  lz = new LZMatcher(level, window_bits);
+}
+
+//----------------------------------------------------------------------------
+
+// let a BlockSplitter at this level (1 = fastest, 9 = best ratio) decide
+// where blocks end.  only Huffman blocks are split; with an LZ stage,
+// bigger blocks are better anyway
+
+void StreamEncoder::set_split(int level)
+{
+  delete splitter;
+  splitter = new BlockSplitter(level);
+}
+
+//----------------------------------------------------------------------------
+
+void StreamEncoder::set_reuse_tables(bool on)
+{
+  reuse_tables = on;
+}
+
+//----------------------------------------------------------------------------
+
+void StreamEncoder::set_columns(bool on)
+{
+  delete columns;
+  columns = on ? new ColumnModel() : NULL;
+}
+
+//----------------------------------------------------------------------------
+
+// BWT stage on every block, threads blocks at a time (0 turns it off).
+// like LZ matches, BWT contexts don't cross blocks, so bigger blocks help
+
+void StreamEncoder::set_bwt(int threads)
+{
+  bwt_threads = max(0, threads);
+}
+
+//----------------------------------------------------------------------------
+
+// the magic and some blocks are already out there; new blocks follow
+// them, and may reuse table (empty if there's no earlier Huffman block)
+
+void StreamEncoder::resume(const vector <int> & table)
+{
+  started = true;
+  last_table = table;
+}
+
+//----------------------------------------------------------------------------
+
+bool StreamEncoder::write(const char *data, size_t n)
+{
+  size_t take;
+
+  if (finished)
+    return false;
+
+  while (splitter != NULL && lz == NULL && n > 0) {
+    take = min(n, 2 * (size_t) block_size - pending.size());
+    pending.append(data, take);
+    data += take;
+    n -= take;
+    bytes_in += take;
+
+    if (pending.size() == 2 * (size_t) block_size && !encode_split(false))
+      return false;
+  }
+
+  while (n > 0) {
+    take = min(n, (size_t) block_size - block.size());
+    block.append(data, take);
+    data += take;
+    n -= take;
+    bytes_in += take;
+
+    if (block.size() == block_size && !encode_block())
+      return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// encode whatever is buffered now, even if it's less than a full block,
+// so a reader on the other end can decode everything written so far
+
+bool StreamEncoder::flush()
+{
+  if (finished)
+    return true;
+  if (!pending.empty() && !encode_split(true))
+    return false;
+  if (!block.empty() && !encode_block())
+    return false;
+  if (!bwt_batch.empty() && !encode_bwt_blocks())
+    return false;
+  if (!started && !write_output(""))
+    return false;
+
+  outStream.flush();
+  return !outStream.fail();
+}
+
+//----------------------------------------------------------------------------
+
+bool StreamEncoder::finish()
+{
+  string end_marker(1, (char) BLOCK_END);
+
+  if (finished)
+    return true;
+  if (!flush() || !write_output(end_marker))
+    return false;
+
+  finished = true;
+  outStream.flush();
+
+  return !outStream.fail();
+}
+
+//----------------------------------------------------------------------------
+
+// compress everything from inStream, then finish the stream
+
+bool StreamEncoder::copy_from(istream & inStream)
+{
+  char buffer[STREAM_COPY_BUFFER_SIZE];
+
+  while (inStream.read(buffer, STREAM_COPY_BUFFER_SIZE) || inStream.gcount() > 0)
+    if (!write(buffer, inStream.gcount()))
+      return false;
+
+  return finish();
+}
+
+//----------------------------------------------------------------------------
+
+bool StreamEncoder::write_output(const string & s)
+{
+  if (!started) {
+    started = true;
+    outStream.write(STREAM_MAGIC, STREAM_MAGIC_BYTES);
+    bytes_out += STREAM_MAGIC_BYTES;
+  }
+
+  outStream.write(s.data(), s.length());
+  bytes_out += s.length();
+
+  return !outStream.fail();
+}
+
+//----------------------------------------------------------------------------
+
+// the chars of block that get codes (bad chars are dropped), for blocks
+// whose checksum and coder work on those alone
+
+static void coded_chars(Huffman & H, const string & block, string & filtered)
+{
+  int i;
+
+  filtered.reserve(block.size());
+  for (i = 0; i < block.size(); i++)
+    if (!H.is_bad_ascii_code((int) block[i]))
+      filtered += block[i];
+}
+
+//----------------------------------------------------------------------------
+
+// build a table for the buffered chars, limit it to MAX_STREAM_CODE_LENGTH
+// so the decoder's lookups stay small, and emit header + payload
+
+bool StreamEncoder::encode_block()
+{
+  if (lz != NULL)
+    return encode_lz_block();
+
+  if (bwt_threads > 0) {
+    bwt_batch.push_back(string());
+    coded_chars(H, block, bwt_batch.back());
+    block.clear();
+    return bwt_batch.size() < bwt_threads || encode_bwt_blocks();
+  }
+
+  if (columns != NULL) {
+    string filtered;
+    int start = column;
+    coded_chars(H, block, filtered);
+    column = column_after(column, block.data(), block.size());
+    if (columns->build(filtered.data(), filtered.length(), start))
+      return encode_column_block(filtered);
+  }
+
+  CodeTable T;
+  vector <int> code_lengths;
+  vector <unsigned int> code_bits;
+  long long new_bits, old_bits;
+  unsigned int crc;
+  int i, c, n, payload_start, run_start;
+  bool same;
+
+  H.reset();
+  H.compute_frequencies(block.data(), block.size());
+
+  if (H.num_chars > 0) {
+    H.build_code_table();
+    T.from_compression_map(H.compression_map);
+    T.limit_code_lengths(MAX_STREAM_CODE_LENGTH, H.char_counter);
+  }
+
+  n = 0;
+  for (c = 0; c < NUM_ASCII; c++)
+    if (T.code_length[c] > 0)
+      n++;
+
+  // the last table will do if it has a code for every char here and the
+  // payload it gives is no bigger than this block's own table plus payload
+
+  same = reuse_tables && H.num_chars > 0 && !last_table.empty();
+  new_bits = 16LL * n;
+  old_bits = 0;
+  for (c = 0; same && c < NUM_ASCII; c++)
+    if (T.code_length[c] > 0) {
+      same = last_table[c] > 0;
+      new_bits += (long long) H.char_counter[c] * T.code_length[c];
+      old_bits += (long long) H.char_counter[c] * last_table[c];
+    }
+  same = same && old_bits <= new_bits;
+
+  if (same) {
+    T.from_code_lengths(last_table);
+    reused_tables++;
+  }
+  else
+    last_table = T.code_length;
+
+  // header
+
+  encoded.clear();
+  encoded += (char) (same ? BLOCK_HUFFMAN_SAME : BLOCK_HUFFMAN_CRC);
+  append_u32(encoded, H.num_chars);
+  append_u32(encoded, 0);          // payload length, patched below
+  append_u32(encoded, 0);          // checksum, patched below
+
+  if (same)
+    encoded += (char) 0;
+  else {
+    encoded += (char) n;
+    for (c = 0; c < NUM_ASCII; c++)
+      if (T.code_length[c] > 0) {
+        encoded += (char) c;
+        encoded += (char) T.code_length[c];
+      }
+  }
+
+  // payload.  the checksum covers only the chars that are coded, i.e.
+  // exactly what the decoder will produce, so it's taken over each run of
+  // good chars
+
+  payload_start = encoded.length();
+  crc = 0;
+  run_start = 0;
+
+  for (i = 0; i < block.size(); i++) {
+    c = (int) block[i];
+    if (H.is_bad_ascii_code(c)) {
+      crc = crc32_update(crc, block.data() + run_start, i - run_start);
+      run_start = i + 1;
+    }
+  }
+  crc = crc32_update(crc, block.data() + run_start, block.size() - run_start);
+
+  // bad chars have no code (length 0), so the kernel skips them
+
+  code_lengths.assign(T.code_length.begin(), T.code_length.end());
+  code_lengths.resize(256, 0);
+  code_bits.assign(T.code_bits.begin(), T.code_bits.end());
+  code_bits.resize(256, 0);
+  bitpack().encode(block.data(), block.size(), &code_lengths[0], &code_bits[0], encoded);
+
+  n = encoded.length() - payload_start;
+  for (i = 0; i < 4; i++) {
+    encoded[5 + i] = (char) ((n >> (8 * i)) & 0xff);
+    encoded[9 + i] = (char) ((crc >> (8 * i)) & 0xff);
+  }
+
+  block.clear();
+  blocks++;
+
+  return write_output(encoded);
+}
+
+//----------------------------------------------------------------------------
+
+// encode the blocks the splitter picks for the pending input; all of them
+// if everything has to go out, else all but the last
+
+bool StreamEncoder::encode_split(bool all)
+{
+  vector <size_t> ends;
+  size_t start;
+  int i, num_blocks;
+
+  splitter->split(pending.data(), pending.size(), block_size, ends);
+  num_blocks = all ? ends.size() : ends.size() - 1;
+
+  start = 0;
+  for (i = 0; i < num_blocks; i++) {
+    block.assign(pending, start, ends[i] - start);
+    if (!encode_block())
+      return false;
+    start = ends[i];
+  }
+  pending.erase(0, start);
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// same framing, but the chars go through the LZ stage and the header
+// carries two tables
+
+bool StreamEncoder::encode_lz_block()
+{
+  string filtered;
+  unsigned int crc;
+  int i, n, payload_start;
+
+  coded_chars(H, block, filtered);
+  crc = crc32_update(0, filtered.data(), filtered.length());
+
+  encoded.clear();
+  encoded += (char) BLOCK_LZ_CRC;
+  append_u32(encoded, filtered.length());
+  append_u32(encoded, 0);          // payload length, patched below
+  append_u32(encoded, crc);
+
+  lz_encode_block(filtered.data(), filtered.length(), *lz, encoded, payload_start);
+
+  n = encoded.length() - payload_start;
+  for (i = 0; i < 4; i++)
+    encoded[5 + i] = (char) ((n >> (8 * i)) & 0xff);
+
+  block.clear();
+  blocks++;
+
+  return write_output(encoded);
+}
+
+//----------------------------------------------------------------------------
+
+// same framing, with the chosen column tables (see Columns.hh).  filtered
+// is the block without its bad chars
+
+bool StreamEncoder::encode_column_block(const string & filtered)
+{
+  unsigned int crc;
+  int i, n, payload_start;
+
+  crc = crc32_update(0, filtered.data(), filtered.length());
+
+  encoded.clear();
+  encoded += (char) BLOCK_COLUMNS_CRC;
+  append_u32(encoded, filtered.length());
+  append_u32(encoded, 0);          // payload length, patched below
+  append_u32(encoded, crc);
+
+  columns->encode(filtered.data(), filtered.length(), encoded, payload_start);
+
+  n = encoded.length() - payload_start;
+  for (i = 0; i < 4; i++)
+    encoded[5 + i] = (char) ((n >> (8 * i)) & 0xff);
+
+  block.clear();
+  blocks++;
+  column_blocks++;
+
+  return write_output(encoded);
+}
+
+//----------------------------------------------------------------------------
+
+// one whole BWT block for chars (bad chars already dropped).  touches
+// nothing shared, so blocks can be done on several threads at once
+
+static void encode_bwt_block(const string & chars, string & out)
+{
+  int i, n, payload_start;
+
+  out += (char) BLOCK_BWT_CRC;
+  append_u32(out, chars.length());
+  append_u32(out, 0);              // payload length, patched below
+  append_u32(out, crc32_update(0, chars.data(), chars.length()));
+
+  bwt_encode_block(chars.data(), chars.length(), out, payload_start);
+
+  n = out.length() - payload_start;
+  for (i = 0; i < 4; i++)
+    out[5 + i] = (char) ((n >> (8 * i)) & 0xff);
+}
+
+//----------------------------------------------------------------------------
+
+// transform the batched blocks, each on its own thread (the first on
+// this one), then write them out in order
+
+bool StreamEncoder::encode_bwt_blocks()
+{
+  vector <string> out(bwt_batch.size());
+  vector <thread> workers;
+  int i;
+
+  for (i = 1; i < bwt_batch.size(); i++)
+    workers.push_back(thread(encode_bwt_block, cref(bwt_batch[i]), ref(out[i])));
+  encode_bwt_block(bwt_batch[0], out[0]);
+  for (i = 0; i < workers.size(); i++)
+    workers[i].join();
+
+  bwt_batch.clear();
+  for (i = 0; i < out.size(); i++) {
+    blocks++;
+    if (!write_output(out[i]))
+      return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+StreamDecoder::StreamDecoder(istream & in) : inStream(in)
+{
+  started = done = error = false;
+  bytes_in = bytes_out = 0;
+  blocks = 0;
+  block_pos = 0;
+  threads = 1;
+}
+
+//----------------------------------------------------------------------------
+
+void StreamDecoder::set_threads(int n)
+{
+  threads = max(1, n);
+}
+
+//----------------------------------------------------------------------------
+
+bool StreamDecoder::fail(string message)
+{
+  cerr << "stream decompression error: " << message << endl;   // stdout may be the data
+  this->message = message;
+  error = true;
+  done = true;
+
+  return false;
+}
+
+//----------------------------------------------------------------------------
+
+// read and decode the next block.  returns false at the end of the stream
+// or on error (check failed())
+
+bool StreamDecoder::next_block()
+{
+  BlockHeader h;
+  string message;
+
+  if (threads > 1 && ahead.empty() && ahead_error.empty())
+    decode_ahead();
+
+  if (!ahead.empty()) {
+    block.swap(ahead.front());
+    ahead.pop_front();
+  }
+  else if (!ahead_error.empty()) {
+    message.swap(ahead_error);
+    return fail(message);
+  }
+  else {
+    if (!read_block(h, payload))
+      return false;
+    block.resize(h.num_chars);
+    if (!decode_block(h, (const unsigned char *) payload.data(), &block[0], message))
+      return fail(message);
+  }
+
+  block_pos = 0;
+  blocks++;
+  bytes_out += block.size();
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// read up to threads blocks and decode them all at once into ahead.  if
+// one of them fails, the ones before it still come out first
+
+bool StreamDecoder::decode_ahead()
+{
+  vector <BlockHeader> headers;
+  vector <string> payloads, decoded, messages;
+  vector <char> ok;
+  vector <thread> workers;
+  atomic <int> next_index(0);
+  BlockHeader h;
+  int i, n;
+
+  while (headers.size() < threads && read_block(h, payload)) {
+    headers.push_back(h);
+    payloads.push_back(payload);
+  }
+
+  n = headers.size();
+  decoded.resize(n);
+  messages.resize(n);
+  ok.assign(n, 0);
+
+  auto worker = [&]() {
+    int j;
+    while ((j = next_index++) < n) {
+      decoded[j].resize(headers[j].num_chars);
+      ok[j] = decode_block(headers[j], (const unsigned char *) payloads[j].data(), &decoded[j][0], messages[j]);
+    }
+  };
+
+  for (i = 1; i < min(n, threads); i++)
+    workers.push_back(thread(worker));
+  worker();
+  for (i = 0; i < workers.size(); i++)
+    workers[i].join();
+
+  for (i = 0; i < n; i++) {
+    if (!ok[i]) {
+      ahead_error = messages[i];
+      break;
+    }
+    ahead.push_back(string());
+    ahead.back().swap(decoded[i]);
+  }
+
+  return n > 0;
+}
+
+//----------------------------------------------------------------------------
+
+// read the next block's header and payload.  false at the end of the
+// stream or on error
+
+bool StreamDecoder::read_block(BlockHeader & h, string & payload)
+{
+  char magic[STREAM_MAGIC_BYTES];
+  string message;
+  int fixed, n, i, k;
+
+  if (done)
+    return false;
+
+  if (!started) {
+    if (!inStream.read(magic, STREAM_MAGIC_BYTES) || memcmp(magic, STREAM_MAGIC, STREAM_MAGIC_BYTES))
+      return fail("not a block stream");
+    bytes_in += STREAM_MAGIC_BYTES;
+    started = true;
+  }
+
+  // block type, or end marker, after any old end markers
+
+  header.resize(MAX_BLOCK_HEADER_BYTES);
+  if (!inStream.read(&header[0], 1))
+    return fail("stream ends without end marker");
+
+  while (header[0] == BLOCK_APPENDED) {
+    bytes_in++;
+    if (!inStream.read(&header[0], 1))
+      return fail("stream ends without end marker");
+  }
+
+  if (header[0] == BLOCK_END) {
+    bytes_in++;
+    done = true;
+    return false;
+  }
+
+  fixed = block_fixed_header_bytes((unsigned char) header[0]);
+  if (fixed == 0)
+    return fail("unknown block type");
+
+  // rest of fixed part, whose last byte says how big the code table is.
+  // every count is checked before its table is read, so header never
+  // has to hold more than MAX_BLOCK_HEADER_BYTES
+
+  if (!inStream.read(&header[1], fixed - 1))
+    return fail("truncated block header");
+  n = (unsigned char) header[fixed - 1];
+  if (n > block_table_symbols((unsigned char) header[0]) || !inStream.read(&header[fixed], 2 * n))
+    return fail("truncated code table");
+  fixed += 2 * n;
+
+  // LZ blocks have a second (distance) table
+
+  if ((unsigned char) header[0] == BLOCK_LZ_CRC) {
+    if (!inStream.read(&header[fixed], 1))
+      return fail("truncated code table");
+    n = (unsigned char) header[fixed++];
+    if (n > LZ_DISTANCE_SYMBOLS || !inStream.read(&header[fixed], 2 * n))
+      return fail("truncated code table");
+    fixed += 2 * n;
+  }
+
+  // column blocks have k - 1 more
+
+  if ((unsigned char) header[0] == BLOCK_COLUMNS_CRC) {
+    k = (unsigned char) header[13];
+    if (k < 1 || k > MAX_COLUMN_TABLES)
+      return fail("bad number of column tables");
+    for (i = 1; i < k; i++) {
+      if (!inStream.read(&header[fixed], 1))
+        return fail("truncated code table");
+      n = (unsigned char) header[fixed++];
+      if (n > NUM_ASCII || !inStream.read(&header[fixed], 2 * n))
+        return fail("truncated code table");
+      fixed += 2 * n;
+    }
+  }
+
+  if (!parse_block_header((const unsigned char *) header.data(), fixed, h, message) ||
+      !resolve_block_table(h, last_table, message))
+    return fail(message);
+  bytes_in += h.header_bytes;
+
+  payload.resize(h.payload_length);
+  if (h.payload_length > 0 && !inStream.read(&payload[0], h.payload_length))
+    return fail("truncated block payload");
+  bytes_in += h.payload_length;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// copy up to n decoded chars into buffer.  returns how many; 0 means the
+// stream is over (or failed)
+
+size_t StreamDecoder::read(char *buffer, size_t n)
+{
+  size_t got, take;
+
+  got = 0;
+
+  while (got < n) {
+    if (block_pos == block.size() && !next_block())
+      break;
+    take = min(n - got, block.size() - block_pos);
+    memcpy(buffer + got, block.data() + block_pos, take);
+    block_pos += take;
+    got += take;
+  }
+
+  return got;
+}
+
+//----------------------------------------------------------------------------
+
+int StreamDecoder::get()
+{
+  while (block_pos == block.size())
+    if (!next_block())
+      return -1;
+
+  return (unsigned char) block[block_pos++];
+}
+
+//----------------------------------------------------------------------------
+
+bool StreamDecoder::copy_to(ostream & outStream)
+{
+  do {
+    if (block_pos < block.size())
+      outStream.write(block.data() + block_pos, block.size() - block_pos);
+    block_pos = block.size();
+  } while (!outStream.fail() && next_block());
+
+  return !error && !outStream.fail();
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// size of the fixed part of a block header, through the code table size
+// byte.  0 for an unknown type
+
+int block_fixed_header_bytes(int type)
+{
+  if (type == BLOCK_HUFFMAN)
+    return 10;
+  if (type == BLOCK_HUFFMAN_CRC || type == BLOCK_HUFFMAN_SAME || type == BLOCK_LZ_CRC)
+    return 14;
+  if (type == BLOCK_COLUMNS_CRC)
+    return COLUMN_FIXED_HEADER_BYTES;
+  if (type == BLOCK_BWT_CRC)
+    return BWT_FIXED_HEADER_BYTES;
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+
+// how many symbols a block type's (first) code table can have
+
+int block_table_symbols(int type)
+{
+  if (type == BLOCK_LZ_CRC)
+    return LZ_LITLEN_SYMBOLS;
+  if (type == BLOCK_BWT_CRC)
+    return BWT_SYMBOLS;
+
+  return NUM_ASCII;
+}
+
+//----------------------------------------------------------------------------
+
+// a count byte at p[pos] and that many (symbol, length) pairs.  pos is
+// moved past them
+
+static bool parse_code_lengths(const unsigned char *p, size_t len, int & pos, int symbols, vector <int> & lengths, string & message)
+{
+  int n, i;
+
+  if (pos >= len || p[pos] > symbols || pos + 1 + 2 * p[pos] > len) {
+    message = "truncated code table";
+    return false;
+  }
+
+  n = p[pos++];
+  lengths.assign(symbols, 0);
+
+  for (i = 0; i < n; i++, pos += 2) {
+    if (p[pos] >= symbols || p[pos + 1] == 0 || p[pos + 1] > MAX_STREAM_CODE_LENGTH) {
+      message = "bad code table entry";
+      return false;
+    }
+    lengths[p[pos]] = p[pos + 1];
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// parse a block header from the len bytes at p, which start at the block
+// type byte.  on failure, message says why
+
+bool parse_block_header(const unsigned char *p, size_t len, BlockHeader & h, string & message)
+{
+  int fixed, pos, symbols, max_bits, i;
+
+  fixed = len > 0 ? block_fixed_header_bytes(p[0]) : 0;
+  if (fixed == 0 || len < fixed) {
+    message = fixed == 0 ? "unknown block type" : "truncated block header";
+    return false;
+  }
+
+  h.type = p[0];
+  h.num_chars = read_u32(p + 1);
+  h.payload_length = read_u32(p + 5);
+  h.has_checksum = (h.type != BLOCK_HUFFMAN);
+  h.checksum = h.has_checksum ? read_u32(p + 9) : 0;
+
+  // sizes this big can only come from a corrupt header -- refuse them
+  // rather than allocate
+
+  max_bits = h.type == BLOCK_LZ_CRC ? LZ_MAX_BITS_PER_CHAR : MAX_STREAM_CODE_LENGTH;
+  if (h.num_chars > MAX_STREAM_BLOCK_SIZE ||
+      h.payload_length > ((unsigned long long) h.num_chars * max_bits + 7) / 8) {
+    message = "bad block size";
+    return false;
+  }
+
+  pos = fixed - 1;
+  symbols = block_table_symbols(h.type);
+  if (!parse_code_lengths(p, len, pos, symbols, h.lengths, message))
+    return false;
+
+  if (h.type == BLOCK_HUFFMAN_SAME && p[fixed - 1] != 0) {
+    message = "block that reuses a table has one";
+    return false;
+  }
+
+  h.distance_lengths.clear();
+  if (h.type == BLOCK_LZ_CRC && !parse_code_lengths(p, len, pos, LZ_DISTANCE_SYMBOLS, h.distance_lengths, message))
+    return false;
+
+  h.column_lengths.clear();
+  h.start_column = 0;
+  if (h.type == BLOCK_COLUMNS_CRC) {
+    if (p[13] < 1 || p[13] > MAX_COLUMN_TABLES || p[14] >= p[13]) {
+      message = "bad column table count";
+      return false;
+    }
+    h.start_column = p[14];
+    h.column_lengths.resize(p[13]);
+    h.column_lengths[0] = h.lengths;
+    for (i = 1; i < h.column_lengths.size(); i++)
+      if (!parse_code_lengths(p, len, pos, NUM_ASCII, h.column_lengths[i], message))
+        return false;
+  }
+
+  h.primary_index = 0;
+  if (h.type == BLOCK_BWT_CRC) {
+    h.primary_index = read_u32(p + 13);
+    if (h.primary_index > h.num_chars) {
+      message = "bad BWT primary index";
+      return false;
+    }
+  }
+
+  h.header_bytes = pos;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// blocks are parsed in order, with last_table holding the code lengths of
+// the last Huffman block so far.  a BLOCK_HUFFMAN_SAME block gets them as
+// its own
+
+bool resolve_block_table(BlockHeader & h, vector <int> & last_table, string & message)
+{
+  if (h.type == BLOCK_HUFFMAN || h.type == BLOCK_HUFFMAN_CRC)
+    last_table = h.lengths;
+  else if (h.type == BLOCK_HUFFMAN_SAME) {
+    if (last_table.empty()) {
+      message = "no earlier code table to reuse";
+      return false;
+    }
+    h.lengths = last_table;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// decode h.num_chars chars from the payload into out (which must have room
+// for them), then check that the payload was used up exactly and that the
+// checksum matches
+
+bool decode_block(BlockHeader & h, const unsigned char *payload, char *out, string & message)
+{
+  CodeTable T;
+  DecodeTable D;
+  long long used;
+
+  if (h.num_chars == 0)
+    return true;
+
+  if (h.type == BLOCK_LZ_CRC) {
+    if (!lz_decode_block(h.lengths, h.distance_lengths, payload, h.payload_length, out, h.num_chars, message))
+      return false;
+    if (crc32_update(0, out, h.num_chars) != h.checksum) {
+      message = "block checksum mismatch";
+      return false;
+    }
+    return true;
+  }
+
+  if (h.type == BLOCK_BWT_CRC) {
+    if (!bwt_decode_block(h.lengths, h.primary_index, payload, h.payload_length, out, h.num_chars, message))
+      return false;
+    if (crc32_update(0, out, h.num_chars) != h.checksum) {
+      message = "block checksum mismatch";
+      return false;
+    }
+    return true;
+  }
+
+  if (h.type == BLOCK_COLUMNS_CRC) {
+    if (!column_decode_block(h.column_lengths, h.start_column, payload, h.payload_length, out, h.num_chars, message))
+      return false;
+    if (crc32_update(0, out, h.num_chars) != h.checksum) {
+      message = "block checksum mismatch";
+      return false;
+    }
+    return true;
+  }
+
+  T.from_code_lengths(h.lengths);
+  if (!D.build(T)) {
+    message = "code table is not a prefix code";
+    return false;
+  }
+
+  used = bitpack().decode(&D.entries[0], D.primary_bits, payload, h.payload_length, out, h.num_chars);
+  if (used < 0) {
+    message = "invalid code in block payload";
+    return false;
+  }
+
+  if (used > 8LL * h.payload_length || (used + 7) / 8 != h.payload_length) {
+    message = "block payload length doesn't match its contents";
+    return false;
+  }
+
+  if (h.has_checksum && crc32_update(0, out, h.num_chars) != h.checksum) {
+    message = "block checksum mismatch";
+    return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// walk the block headers of a whole stream file held in data, checking
+// that every payload fits.  payloads are skipped, so this is cheap.
+//
+// bytes after the end marker are what's left of an -append that never
+// committed (see Append.hh).  like StreamDecoder, this stops at the end
+// marker and doesn't look at them; their count goes in uncommitted
+
+bool index_stream_blocks(const string & data, vector <BlockLocation> & locations, string & message, size_t * uncommitted)
+{
+  BlockLocation loc;
+  vector <int> last_table;
+  const unsigned char *p;
+  size_t pos;
+
+  locations.clear();
+  p = (const unsigned char *) data.data();
+
+  if (data.length() < STREAM_MAGIC_BYTES || memcmp(data.data(), STREAM_MAGIC, STREAM_MAGIC_BYTES)) {
+    message = "not a block stream file";
+    return false;
+  }
+
+  pos = STREAM_MAGIC_BYTES;
+  loc.first_char = 0;
+  while (1) {
+    if (pos >= data.length()) {
+      message = "stream ends without end marker";
+      return false;
+    }
+    if (p[pos] == BLOCK_END)
+      break;
+    if (p[pos] == BLOCK_APPENDED) {
+      pos++;
+      continue;
+    }
+    if (!parse_block_header(p + pos, data.length() - pos, loc.header, message) ||
+        !resolve_block_table(loc.header, last_table, message))
+      return false;
+    loc.payload_offset = pos + loc.header.header_bytes;
+    if (loc.header.payload_length > data.length() - loc.payload_offset) {
+      message = "truncated block payload";
+      return false;
+    }
+    locations.push_back(loc);
+    loc.first_char += loc.header.num_chars;
+    pos = loc.payload_offset + loc.header.payload_length;
+  }
+
+  if (uncommitted != NULL)
+    *uncommitted = data.length() - (pos + 1);
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// does this input start with the block stream magic?  doesn't consume anything
+
+bool is_stream_format(istream & inStream)
+{
+  return inStream.peek() == (unsigned char) STREAM_MAGIC[0];
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,254 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// incremental block-wise encoder and decoder for pipes and sockets
+//----------------------------------------------------------------------------
+
+#ifndef STREAMCODEC_HH
+#define STREAMCODEC_HH
+
+#include "Huffman.hh"
+#include "CodeTable.hh"
+#include "TableCache.hh"
+#include "LZ77.hh"
+#include "BlockSplit.hh"
+#include "Columns.hh"
+#include "BWT.hh"
+
+//----------------------------------------------------------------------------
+
+// block stream format.  the first byte can never start an old-style .huf
+// file (its first byte is a code table size, at most NUM_ASCII)
+//
+//   4 bytes  magic F0 'H' 'U' 'F'
+//   blocks, each:
+//     1 byte   block type, BLOCK_HUFFMAN, BLOCK_HUFFMAN_CRC,
+//              BLOCK_HUFFMAN_SAME, BLOCK_LZ_CRC, BLOCK_COLUMNS_CRC or
+//              BLOCK_BWT_CRC
+//     4 bytes  number of chars in block
+//     4 bytes  number of payload bytes
+//     4 bytes  CRC-32 of the block's chars (not in BLOCK_HUFFMAN)
+//     BLOCK_COLUMNS_CRC only: 1 byte number of tables k, 1 byte table
+//       of the first char (see Columns.hh); the table below is the first
+//       of k
+//     BLOCK_BWT_CRC only: 4 bytes primary index; the table below is for
+//       the transformed symbols (see BWT.hh)
+//     1 byte   number of chars with codes, n
+//     n pairs  (char, code length) -- codes are canonical
+//     BLOCK_HUFFMAN_SAME only: n is 0, and the block is coded with the
+//       table of the last BLOCK_HUFFMAN or BLOCK_HUFFMAN_CRC block
+//     BLOCK_LZ_CRC only: the table above is for literals and match
+//       lengths (see LZ77.hh); then 1 byte m and m (distance symbol,
+//       code length) pairs
+//     BLOCK_COLUMNS_CRC only: k - 1 more tables like the first
+//     payload  codes packed MSB first, last byte 0-padded
+//   1 byte   BLOCK_END
+//
+// a single BLOCK_APPENDED byte can also come between blocks: it's where
+// the end marker was before more blocks were appended (see Append.hh).
+//
+// every block carries its own table, or reuses the one before, so
+// neither side ever needs more than one block in memory and no pass over
+// the whole input is required.  integers are little-endian
+
+#define STREAM_MAGIC                   "\xF0HUF"
+#define STREAM_MAGIC_BYTES             4
+#define BLOCK_END                      0
+#define BLOCK_HUFFMAN                  1
+#define BLOCK_HUFFMAN_CRC              2
+#define BLOCK_LZ_CRC                   3
+#define BLOCK_HUFFMAN_SAME             4
+#define BLOCK_APPENDED                 5
+#define BLOCK_COLUMNS_CRC              6
+#define BLOCK_BWT_CRC                  7
+#define MAX_BLOCK_HEADER_BYTES         (COLUMN_FIXED_HEADER_BYTES + MAX_COLUMN_TABLES * (1 + 2 * NUM_ASCII))   // bigger than any LZ header
+
+#define DEFAULT_STREAM_BLOCK_SIZE      (64 * 1024)
+#define DEFAULT_LZ_BLOCK_SIZE          (1024 * 1024)     // LZ matches can't cross blocks
+#define MAX_STREAM_BLOCK_SIZE          (16 * 1024 * 1024)
+#define MAX_STREAM_CODE_LENGTH         15
+#define STREAM_COPY_BUFFER_SIZE        (64 * 1024)
+
+//----------------------------------------------------------------------------
+
+// one block's header, as parsed by parse_block_header()
+
+class BlockHeader
+{
+public:
+
+  int type;
+  unsigned int num_chars;
+  unsigned int payload_length;
+  unsigned int checksum;
+  bool has_checksum;
+  int header_bytes;          // fixed part + code table(s)
+  vector <int> lengths;      // code length of each char (or literal/length symbol)
+  vector <int> distance_lengths;   // BLOCK_LZ_CRC only
+  vector <vector <int> > column_lengths;   // BLOCK_COLUMNS_CRC only, lengths is the first
+  int start_column;                  // BLOCK_COLUMNS_CRC only
+  unsigned int primary_index;        // BLOCK_BWT_CRC only
+};
+
+int block_fixed_header_bytes(int);
+int block_table_symbols(int);
+bool parse_block_header(const unsigned char *, size_t, BlockHeader &, string &);
+bool decode_block(BlockHeader &, const unsigned char *, char *, string &);
+bool resolve_block_table(BlockHeader &, vector <int> &, string &);
+
+// where one block of a whole stream file in memory sits, so its blocks
+// can be decoded independently (e.g. on several threads)
+
+class BlockLocation
+{
+public:
+  BlockHeader header;
+  size_t payload_offset;
+  long long first_char;      // offset of the block's first char in the decoded stream
+};
+
+bool index_stream_blocks(const string &, vector <BlockLocation> &, string &, size_t * = NULL);
+
+//----------------------------------------------------------------------------
+
+// bytes go in through write(); each time block_size of them have
+// accumulated a block is encoded and written out.  flush() pushes out a
+// partial block early, finish() ends the stream.  memory use is bounded
+// by about 3 * block_size regardless of input length.
+//
+// with set_split(), block_size is only the largest block allowed: input
+// is gathered 2 * block_size at a time and a BlockSplitter picks where the
+// blocks end.  the last block it picks is held back and goes in front of
+// the next run of input, since it may continue past what's been seen.
+//
+// with set_reuse_tables(), a block whose chars the last table covers is
+// written as BLOCK_HUFFMAN_SAME whenever that comes out no bigger than a
+// new table would.  resume() carries on a stream whose magic and earlier
+// blocks are already written (ending in the given table), for appending.
+//
+// with set_columns(), each block is also tried with a table per
+// tab-separated column (see Columns.hh), and written that way if it comes
+// out smaller.
+//
+// with set_bwt(), every block goes through the BWT stage (see BWT.hh)
+// instead, and that many blocks at a time are transformed on separate
+// threads.  they are written in order, so the output doesn't depend on
+// the number of threads; flush() still pushes out everything buffered
+
+class StreamEncoder
+{
+public:
+
+  StreamEncoder(ostream &, int = DEFAULT_STREAM_BLOCK_SIZE, TableCache * = NULL);
+  ~StreamEncoder();
+  bool write(const char *, size_t);
+  bool flush();
+  bool finish();
+  bool copy_from(istream &);
+  void set_lz(int, int = DEFAULT_LZ_WINDOW_BITS);
+  void set_split(int);
+  void set_reuse_tables(bool);
+  void set_columns(bool);
+  void set_bwt(int);
+  void resume(const vector <int> &);
+
+  long long bytes_in, bytes_out;
+  int blocks;
+  int reused_tables;         // blocks written as BLOCK_HUFFMAN_SAME
+  int column_blocks;         // blocks written as BLOCK_COLUMNS_CRC
+
+private:
+
+  bool encode_block();
+  bool encode_lz_block();
+  bool encode_column_block(const string &);
+  bool encode_bwt_blocks();
+  bool encode_split(bool);
+  bool write_output(const string &);
+
+  ostream & outStream;
+  int block_size;
+  bool started, finished;
+  string block;          // raw input waiting to be encoded
+  string encoded;        // header + payload of the block being written
+  Huffman H;             // builds each block's table
+  LZMatcher *lz;         // NULL unless blocks get an LZ stage
+  BlockSplitter *splitter;   // NULL for fixed-size blocks
+  string pending;        // input the splitter hasn't placed in a block yet
+  bool reuse_tables;
+  vector <int> last_table;   // code lengths of the last Huffman block written
+  ColumnModel *columns;      // NULL unless blocks may get per-column tables
+  int column;                // tabs since the last newline before the block
+  int bwt_threads;           // 0 unless blocks get a BWT stage
+  vector <string> bwt_batch; // chars of blocks waiting to be transformed together
+};
+
+//----------------------------------------------------------------------------
+
+// pulls blocks off the input as they are needed.  read() fills a buffer
+// with decoded chars, get() returns one char (or -1), and begin()/end()
+// give a lazy input iterator over the whole decoded stream.
+//
+// with set_threads(), up to that many blocks are read ahead and decoded
+// at once on separate threads.  that's only for input where the rest of
+// the stream is already there, like a file: on a pipe the reader would
+// wait for blocks the writer hasn't sent yet
+
+class StreamDecoder
+{
+public:
+
+  StreamDecoder(istream &);
+  size_t read(char *, size_t);
+  int get();
+  bool copy_to(ostream &);
+  bool failed() { return error; }
+  void set_threads(int);
+
+  class iterator
+  {
+  public:
+    iterator(StreamDecoder *d = NULL) { decoder = d; advance(); }
+    char operator*() const { return c; }
+    iterator & operator++() { advance(); return *this; }
+    bool operator==(const iterator & other) const { return decoder == other.decoder; }
+    bool operator!=(const iterator & other) const { return decoder != other.decoder; }
+  private:
+    void advance() { if (decoder && (c = decoder->get()) < 0) decoder = NULL; }
+    StreamDecoder *decoder;
+    int c;
+  };
+
+  iterator begin() { return iterator(this); }
+  iterator end() { return iterator(); }
+
+  long long bytes_in, bytes_out;
+  int blocks;
+  string message;            // why it failed
+
+private:
+
+  bool next_block();
+  bool read_block(BlockHeader &, string &);
+  bool decode_ahead();
+  bool fail(string);
+
+  istream & inStream;
+  bool started, done, error;
+  string header;         // raw header of current block
+  string payload;        // compressed bytes of current block
+  string block;          // decoded chars of current block
+  size_t block_pos;      // next char of block to hand out
+  vector <int> last_table;   // for BLOCK_HUFFMAN_SAME blocks
+  int threads;
+  deque <string> ahead;  // blocks decoded ahead, in order
+  string ahead_error;    // why the block after them failed
+};
+
+//----------------------------------------------------------------------------
+
+bool is_stream_format(istream &);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,245 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// parallel decoding of old-style .huf files by self-synchronization
+//----------------------------------------------------------------------------
+
+#include "SyncDecode.hh"
+#include "BitIO.hh"
+
+#include <sstream>
+#include <thread>
+#include <atomic>
+
+//----------------------------------------------------------------------------
+
+#define LEGACY_MAX_HEADER_BYTES        (2 + NUM_ASCII * 34)   // table size, (length, 32 code bytes, char) each, bad bits
+
+//----------------------------------------------------------------------------
+
+// one piece of the payload.  chars[skip..] are the decoded chars that
+// belong to this chunk, preceded by prefix if it had to be partly decoded
+// again
+
+class SyncChunk
+{
+public:
+  long long start;           // guessed first bit
+  long long end;             // codes starting before this belong to the chunk
+  long long exit;            // start of the first code at or after end
+  bool failed;               // hit an invalid code at exit
+  string chars;
+  vector <long long> starts;   // where each of the first SYNC_WINDOW_CODES codes started
+  string prefix;
+  size_t skip;
+};
+
+//----------------------------------------------------------------------------
+
+// decode every code that starts in [from, chunk.end), appending to out.
+// positions are bit offsets into the payload
+
+static bool decode_range(DecodeTable & D, const unsigned char *payload, size_t payload_bytes,
+                         long long from, long long end, string & out, vector <long long> *starts, long long & exit)
+{
+  long long base, pos;
+  int c;
+
+  base = from & ~7LL;
+  BitReader in(payload + base / 8, payload_bytes - base / 8);
+  in.refill();
+  in.consume(from - base);
+
+  for (pos = from; pos < end; pos = base + in.bits_consumed()) {
+    if (starts != NULL && starts->size() < SYNC_WINDOW_CODES)
+      starts->push_back(pos);
+    c = D.decode(in);
+    if (c < 0) {
+      exit = pos;
+      return false;
+    }
+    out += (char) c;
+  }
+
+  exit = pos;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// the chunk really starts at from.  decode from there until a code starts
+// where the speculative decode had one, keeping the chars up to that
+// point as the chunk's prefix
+
+static bool resync_chunk(DecodeTable & D, const unsigned char *payload, size_t payload_bytes,
+                         long long from, SyncChunk & chunk, SyncDecodeResult & result)
+{
+  vector <long long>::iterator s;
+  long long base, pos;
+  int c;
+
+  s = lower_bound(chunk.starts.begin(), chunk.starts.end(), from);
+  if (s != chunk.starts.end() && *s == from) {
+    chunk.skip = s - chunk.starts.begin();
+    return !chunk.failed;
+  }
+  result.resynced++;
+
+  base = from & ~7LL;
+  BitReader in(payload + base / 8, payload_bytes - base / 8);
+  in.refill();
+  in.consume(from - base);
+
+  for (pos = from; pos < chunk.end; pos = base + in.bits_consumed()) {
+    while (s != chunk.starts.end() && *s < pos)
+      s++;
+    if (s != chunk.starts.end() && *s == pos) {
+      chunk.skip = s - chunk.starts.begin();
+      result.sync_bits += pos - from;
+      return !chunk.failed;
+    }
+    c = D.decode(in);
+    if (c < 0) {
+      chunk.exit = pos;
+      return false;
+    }
+    chunk.prefix += (char) c;
+  }
+
+  // never caught up, so the prefix is the whole chunk
+
+  result.resynced--;
+  result.redecoded++;
+  result.sync_bits += pos - from;
+  chunk.skip = chunk.chars.size();
+  chunk.exit = pos;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// decode a whole old-style binary file (header and all) in data into out
+
+bool sync_decode_legacy(const string & data, string & out, int num_threads, SyncDecodeResult & result, long long max_chars)
+{
+  istringstream inStream(data.substr(0, LEGACY_MAX_HEADER_BYTES));
+  map <string, char>::iterator cur;
+  map <char, string> codes;
+  vector <SyncChunk> chunks;
+  vector <thread> workers;
+  atomic <int> next_chunk(0);
+  const unsigned char *payload;
+  CodeTable T;
+  DecodeTable D;
+  Huffman H;
+  unsigned char bad_bits;
+  long long total_bits;
+  size_t payload_start, payload_bytes, n;
+  int i, k, shortest;
+
+  out.clear();
+
+  H.read_decompression_map(inStream, true);
+  bad_bits = inStream.get();
+  if (!inStream || bad_bits >= BITS_PER_BYTE) {
+    result.message = "truncated or corrupt header";
+    return false;
+  }
+  payload_start = inStream.tellg();
+  result.header_ok = true;
+
+  for (cur = H.decompression_map.begin(); cur != H.decompression_map.end(); cur++)
+    codes[(*cur).second] = (*cur).first;
+  if (!T.from_compression_map(codes)) {
+    result.message = "codes too long for a lookup table";
+    return false;
+  }
+  result.table_ok = true;
+
+  if (!D.build(T)) {
+    result.message = "code table is not a prefix code";
+    return false;
+  }
+
+  shortest = MAX_CODE_LENGTH;
+  for (i = 0; i < T.num_symbols; i++)
+    if (T.code_length[i] > 0)
+      shortest = min(shortest, T.code_length[i]);
+
+  payload = (const unsigned char *) data.data() + payload_start;
+  payload_bytes = data.length() - payload_start;
+  total_bits = 8LL * payload_bytes - bad_bits;
+  if (total_bits < 0) {
+    result.message = "padding longer than payload";
+    return false;
+  }
+  if (max_chars > 0 && total_bits / shortest > max_chars) {
+    result.message = "could decode to more chars than allowed";
+    return false;
+  }
+
+  // evenly spaced guesses; the first one is right
+
+  k = max(1, num_threads) * SYNC_CHUNKS_PER_THREAD;
+  k = (int) max(1LL, min((long long) k, total_bits / SYNC_MIN_CHUNK_BITS));
+  if (num_threads <= 1)
+    k = 1;
+
+  chunks.resize(k);
+  for (i = 0; i < k; i++) {
+    chunks[i].start = total_bits * i / k;
+    chunks[i].end = total_bits * (i + 1) / k;
+    chunks[i].skip = 0;
+  }
+  result.chunks = k;
+
+  // speculative decode of every chunk at once
+
+  num_threads = max(1, min(num_threads, k));
+  for (i = 0; i < num_threads; i++)
+    workers.push_back(thread([&]() {
+      int c;
+
+      while ((c = next_chunk++) < chunks.size()) {
+        SyncChunk & chunk = chunks[c];
+        chunk.chars.reserve((chunk.end - chunk.start) / shortest + 1);
+        chunk.failed = !decode_range(D, payload, payload_bytes, chunk.start, chunk.end, chunk.chars,
+                                     c > 0 ? &chunk.starts : NULL, chunk.exit);
+      }
+    }));
+  for (i = 0; i < workers.size(); i++)
+    workers[i].join();
+
+  // stitch: each chunk starts where the one before really ended
+
+  if (chunks[0].failed) {
+    result.message = "invalid code";
+    return false;
+  }
+
+  for (i = 1; i < k; i++)
+    if (!resync_chunk(D, payload, payload_bytes, chunks[i - 1].exit, chunks[i], result)) {
+      result.message = "invalid code";
+      return false;
+    }
+
+  if (chunks[k - 1].exit != total_bits) {
+    result.message = "last code runs into padding";
+    return false;
+  }
+
+  n = 0;
+  for (i = 0; i < k; i++)
+    n += chunks[i].prefix.size() + chunks[i].chars.size() - chunks[i].skip;
+  out.reserve(n);
+  for (i = 0; i < k; i++) {
+    out += chunks[i].prefix;
+    out.append(chunks[i].chars, chunks[i].skip, string::npos);
+  }
+
+  result.ok = true;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
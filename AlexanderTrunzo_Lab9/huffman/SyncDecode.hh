@@ -0,0 +1,62 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// parallel decoding of old-style .huf files by self-synchronization
+//----------------------------------------------------------------------------
+
+#ifndef SYNCDECODE_HH
+#define SYNCDECODE_HH
+
+#include "Huffman.hh"
+#include "CodeTable.hh"
+
+//----------------------------------------------------------------------------
+
+#define SYNC_CHUNKS_PER_THREAD         4       // so threads that finish early can take another
+#define SYNC_MIN_CHUNK_BITS            (256 * 1024)
+#define SYNC_WINDOW_CODES              4096    // code boundaries remembered at the start of each chunk
+
+//----------------------------------------------------------------------------
+
+// an old-style binary file is one bitstream with nothing marking where
+// codes start, so there's no way to know where to begin decoding except
+// at the front.  but Huffman codes resynchronize: started at the wrong
+// bit, a decoder emits a few wrong chars and then almost always lands on
+// a real code boundary, after which it's right from there on.
+//
+// so the payload is cut into chunks at evenly spaced bits, and every
+// chunk is decoded at once (on up to num_threads threads) as if its first
+// bit began a code, remembering where its first SYNC_WINDOW_CODES codes
+// started.  then, in order, each chunk's real first code is where the
+// chunk before it really ended.  if that's one of the remembered starts,
+// the chars before it are thrown away and the rest are right; if not, the
+// chunk is decoded again from the real start until it lands on one (or,
+// rarely, to its end).  the result is exactly what one decoder going from
+// the front would produce
+
+class SyncDecodeResult
+{
+public:
+
+  SyncDecodeResult() { ok = header_ok = table_ok = false; chunks = resynced = redecoded = 0; sync_bits = 0; }
+
+  bool ok;
+  bool header_ok;            // false: not an old-style binary file at all
+  bool table_ok;             // false (with header_ok): codes too long for a DecodeTable, use Huffman::decompress_stream()
+  string message;            // why it failed
+  int chunks;
+  int resynced;              // chunks whose guessed start was wrong but caught up
+  int redecoded;             // chunks that never caught up and were decoded again in full
+  long long sync_bits;       // bits decoded a second time
+};
+
+// max_chars, if not 0, refuses any payload that could decode to more
+// chars than that (every code is at least the shortest code's length), so
+// a caller holding untrusted data knows the output's size is bounded
+// before any of it is decoded
+
+bool sync_decode_legacy(const string &, string &, int, SyncDecodeResult &, long long = 0);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
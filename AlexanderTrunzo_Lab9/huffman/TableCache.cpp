@@ -0,0 +1,142 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// cache of already-built code tables, keyed by histogram shape
+//----------------------------------------------------------------------------
+
+#include "TableCache.hh"
+
+#include <stdio.h>
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+TableCache::TableCache(string dir, double penalty)
+{
+  cache_dir = dir;
+  max_penalty = penalty;
+
+  hits = misses = rejects = stores = 0;
+}
+
+//----------------------------------------------------------------------------
+
+// hash of each char's probability, rounded to a power of 2 (FNV-1a)
+
+unsigned long long TableCache::fingerprint(vector <int> & char_counter)
+{
+  unsigned long long hash;
+  double total;
+  int i, level;
+
+  total = 0;
+  for (i = 0; i < char_counter.size(); i++)
+    total += char_counter[i];
+
+  hash = 14695981039346656037ULL;
+
+  for (i = 0; i < char_counter.size(); i++) {
+    level = 0;
+    if (char_counter[i] > 0) {
+      level = 1 + (int) floor(log2(total / char_counter[i]));
+      if (level > FINGERPRINT_LEVELS)
+        level = FINGERPRINT_LEVELS;
+    }
+    hash ^= (unsigned long long) level;
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+//----------------------------------------------------------------------------
+
+string TableCache::table_filename(unsigned long long key)
+{
+  char name[32];
+
+  sprintf(name, "%016llx.tbl", key);
+
+  return cache_dir + "/" + name;
+}
+
+//----------------------------------------------------------------------------
+
+// look for a table that is good enough for this histogram.  returns true
+// and fills in T on a hit
+
+bool TableCache::lookup(vector <int> & char_counter, CodeTable & T)
+{
+  map <unsigned long long, CodeTable>::iterator cur;
+  unsigned long long key;
+  CodeTable loaded;
+  double entropy, ratio;
+
+  key = fingerprint(char_counter);
+
+  lock_guard <mutex> guard(lock);
+  cur = tables.find(key);
+
+  // not in memory -- maybe a previous run left it on disk
+
+  if (cur == tables.end() && !cache_dir.empty() && loaded.load(table_filename(key))) {
+    tables[key] = loaded;
+    cur = tables.find(key);
+  }
+
+  if (cur == tables.end()) {
+    misses++;
+    return false;
+  }
+
+  // same shape isn't enough: every char must have a code, and the table
+  // can't be much worse on this histogram than on the one it was built for
+
+  entropy = histogram_entropy_bits(char_counter);
+  ratio = entropy > 0 ? (*cur).second.cost(char_counter) / entropy : 1.0;
+
+  if (!(*cur).second.covers(char_counter) || ratio - (*cur).second.trained_ratio > max_penalty) {
+    rejects++;
+    misses++;
+    return false;
+  }
+
+  T = (*cur).second;
+  hits++;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// remember a freshly built table under this histogram's fingerprint
+
+void TableCache::store(vector <int> & char_counter, CodeTable & T)
+{
+  unsigned long long key;
+  double entropy;
+
+  key = fingerprint(char_counter);
+  entropy = histogram_entropy_bits(char_counter);
+
+  lock_guard <mutex> guard(lock);
+
+  tables[key] = T;
+  tables[key].trained_ratio = entropy > 0 ? T.cost(char_counter) / entropy : 1.0;
+  stores++;
+
+  if (!cache_dir.empty() && !tables[key].save(table_filename(key)))
+    cout << "table cache: failed to write " << table_filename(key) << endl;
+}
+
+//----------------------------------------------------------------------------
+
+void TableCache::print_stats(ostream & outStream)
+{
+  lock_guard <mutex> guard(lock);
+
+  outStream << "table cache: " << hits << " hits, " << misses << " misses ("
+            << rejects << " rejected), " << stores << " stored\n";
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
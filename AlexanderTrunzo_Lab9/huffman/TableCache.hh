@@ -0,0 +1,66 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// cache of already-built code tables, keyed by histogram shape
+//----------------------------------------------------------------------------
+
+#ifndef TABLECACHE_HH
+#define TABLECACHE_HH
+
+#include "CodeTable.hh"
+
+#include <mutex>
+
+//----------------------------------------------------------------------------
+
+#define DEFAULT_CACHE_PENALTY          0.01    // max fractional cost increase for a hit
+#define FINGERPRINT_LEVELS             15      // log2 buckets for char probabilities
+
+//----------------------------------------------------------------------------
+
+// files from the same family have nearly the same histogram "shape" --
+// the same chars, with roughly the same relative frequencies.  the
+// fingerprint captures that shape coarsely so that a table built for one
+// member of the family can be found and reused for the next one, skipping
+// build_optimal_trie() and compute_all_codes_from_trie().
+//
+// a hit is only taken if the cached table covers every char in the new
+// histogram and costs at most max_penalty more (relative to the entropy
+// bound) than it did on the histogram it was trained on.
+//
+// if cache_dir is non-empty, tables are also read from and written to
+// <cache_dir>/<fingerprint>.tbl so that they survive between runs.
+//
+// one cache may be shared by Huffman objects on different threads
+
+class TableCache
+{
+public:
+
+  TableCache(string = "", double = DEFAULT_CACHE_PENALTY);
+  unsigned long long fingerprint(vector <int> &);
+  bool lookup(vector <int> &, CodeTable &);
+  void store(vector <int> &, CodeTable &);
+  void print_stats(ostream &);
+
+  string cache_dir;
+  double max_penalty;
+
+  // counters
+
+  int hits;               // table found and reused
+  int misses;             // no usable table, caller had to build one
+  int rejects;            // misses where a table was found but cost too much
+  int stores;             // tables added
+
+private:
+
+  string table_filename(unsigned long long);
+
+  map <unsigned long long, CodeTable> tables;
+  mutex lock;
+};
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
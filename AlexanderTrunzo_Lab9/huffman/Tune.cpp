@@ -0,0 +1,323 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// picking kernels, table width, block size and threads for this host
+//----------------------------------------------------------------------------
+
+#include "Tune.hh"
+#include "Bench.hh"
+#include "BitPack.hh"
+#include "CodeTable.hh"
+#include "StreamCodec.hh"
+#include "SyncDecode.hh"
+
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <stdlib.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------
+
+static const char *sample_filenames[] = { "cleaned_bts.txt", "cleaned_doi.txt", "cleaned_greatexp.txt", NULL };
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+TuneProfile::TuneProfile()
+{
+  kernels = bitpack().name;
+  decode_table_bits = DEFAULT_DECODE_TABLE_BITS;
+  block_size = DEFAULT_STREAM_BLOCK_SIZE;
+  threads = max(1, (int) thread::hardware_concurrency());
+
+  l1d_bytes = l2_bytes = 0;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+  l1d_bytes = max(0L, sysconf(_SC_LEVEL1_DCACHE_SIZE));
+  l2_bytes = max(0L, sysconf(_SC_LEVEL2_CACHE_SIZE));
+#endif
+  cores = thread::hardware_concurrency();
+}
+
+//----------------------------------------------------------------------------
+
+string default_profile_filename()
+{
+  const char *s;
+
+  if ((s = getenv("HUFFMAN_PROFILE")) != NULL && *s)
+    return s;
+  if ((s = getenv("HOME")) != NULL && *s)
+    return string(s) + "/" + TUNE_PROFILE_NAME;
+  return TUNE_PROFILE_NAME;
+}
+
+//----------------------------------------------------------------------------
+
+static bool kernels_supported(string name)
+{
+  vector <BitPackKernels *> targets;
+  int i;
+
+  targets = bitpack_targets();
+  for (i = 0; i < targets.size(); i++)
+    if (name == targets[i]->name)
+      return true;
+
+  return false;
+}
+
+//----------------------------------------------------------------------------
+
+bool TuneProfile::save(string filename)
+{
+  ofstream outStream;
+
+  outStream.open(filename.c_str());
+  if (outStream.fail())
+    return false;
+
+  outStream << "# written by huffman -tune\n";
+  outStream << "kernels " << kernels << endl;
+  outStream << "decode_table_bits " << decode_table_bits << endl;
+  outStream << "block_size " << block_size << endl;
+  outStream << "threads " << threads << endl;
+  outStream << "l1d_bytes " << l1d_bytes << endl;
+  outStream << "l2_bytes " << l2_bytes << endl;
+  outStream << "cores " << cores << endl;
+
+  outStream.close();
+  return !outStream.fail();
+}
+
+//----------------------------------------------------------------------------
+
+// unknown names are skipped, so older binaries can read newer profiles;
+// out-of-range values are left at their defaults
+
+bool TuneProfile::load(string filename)
+{
+  ifstream inStream;
+  string line, name, value;
+  long long n;
+
+  inStream.open(filename.c_str());
+  if (inStream.fail())
+    return false;
+
+  while (getline(inStream, line)) {
+    istringstream fields(line);
+    if (!(fields >> name >> value) || name[0] == '#')
+      continue;
+    n = atoll(value.c_str());
+
+    if (name == "kernels" && kernels_supported(value))
+      kernels = value;
+    else if (name == "decode_table_bits" && n >= 1 && n <= MAX_STREAM_CODE_LENGTH)
+      decode_table_bits = n;
+    else if (name == "block_size" && n > 0)
+      block_size = n;
+    else if (name == "threads" && n > 0)
+      threads = n;
+    else if (name == "l1d_bytes")
+      l1d_bytes = n;
+    else if (name == "l2_bytes")
+      l2_bytes = n;
+    else if (name == "cores")
+      cores = n;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+void TuneProfile::describe(ostream & outStream)
+{
+  outStream << kernels << " kernels, " << decode_table_bits << "-bit decode tables, "
+            << block_size << "-byte blocks, " << threads << " threads"
+            << " (tuned on " << cores << " cores, " << l1d_bytes / 1024 << "K L1d, " << l2_bytes / 1024 << "K L2)";
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+// chars through a plain Huffman block stream and back, as the command
+// line would do them; returns MB/s of chars for the round trip, and the
+// compressed size
+
+static double stream_round_trip(const string & chars, int block_size, size_t & compressed_bytes)
+{
+  double rate;
+
+  rate = time_kernel([&]() {
+      istringstream chars_in(chars);
+      ostringstream compressed, decoded;
+      StreamEncoder encoder(compressed, block_size);
+      encoder.copy_from(chars_in);
+      compressed_bytes = compressed.str().length();
+
+      istringstream compressed_in(compressed.str());
+      StreamDecoder decoder(compressed_in);
+      decoder.copy_to(decoded);
+    }, chars.length(), TUNE_MIN_SECONDS);
+
+  return rate;
+}
+
+// decoding only, from an already-compressed stream
+
+static double stream_decode_rate(const string & compressed, size_t n)
+{
+  return time_kernel([&]() {
+      istringstream compressed_in(compressed);
+      ostringstream decoded;
+      StreamDecoder decoder(compressed_in);
+      decoder.copy_to(decoded);
+    }, n, TUNE_MIN_SECONDS);
+}
+
+//----------------------------------------------------------------------------
+
+bool tune_host(vector <string> & filenames, TuneProfile & profile, ostream & outStream)
+{
+  vector <BitPackKernels *> targets;
+  vector <string> samples;
+  string chars, payload, encoded, decoded, compressed, data, out;
+  istringstream chars_in;
+  ostringstream compressed_out, legacy_out;
+  CodeTable T;
+  DecodeTable D;
+  Huffman H;
+  SyncDecodeResult result;
+  double rate, best_rate, encode_rate, decode_rate;
+  size_t bytes, best_bytes;
+  int i, bits, size, t, max_threads;
+
+  // sample text
+
+  samples = filenames;
+  if (samples.empty())
+    for (i = 0; sample_filenames[i] != NULL; i++)
+      if (access(sample_filenames[i], R_OK) == 0)
+        samples.push_back(sample_filenames[i]);
+  chars = bench_input(samples);
+  if (chars.length() > TUNE_SAMPLE_CHARS)
+    chars.resize(TUNE_SAMPLE_CHARS);
+
+  profile = TuneProfile();
+  outStream << "tune: " << chars.length() << " chars of sample, " << profile.cores << " cores, "
+            << profile.l1d_bytes / 1024 << "K L1d, " << profile.l2_bytes / 1024 << "K L2\n";
+
+  H.compute_frequencies(chars.data(), chars.length());
+  H.build_code_table();
+  T.from_compression_map(H.compression_map);
+  T.limit_code_lengths(MAX_STREAM_CODE_LENGTH, H.char_counter);
+  D.build(T, DEFAULT_DECODE_TABLE_BITS);
+
+  // 1. bit packing kernels: encode and decode of the whole sample
+
+  outStream << "kernels:\n";
+  targets = bitpack_targets();
+  targets[0]->encode(chars.data(), chars.length(), &T.code_length[0], &T.code_bits[0], payload);
+  decoded.resize(chars.length());
+  best_rate = 0;
+
+  for (i = 0; i < targets.size(); i++) {
+    BitPackKernels *K = targets[i];
+    encode_rate = time_kernel([&]() { encoded.clear(); K->encode(chars.data(), chars.length(), &T.code_length[0], &T.code_bits[0], encoded); },
+                              chars.length(), TUNE_MIN_SECONDS);
+    decode_rate = time_kernel([&]() { K->decode(&D.entries[0], D.primary_bits, (const unsigned char *) payload.data(),
+                                                payload.length(), &decoded[0], chars.length()); },
+                              chars.length(), TUNE_MIN_SECONDS);
+    if (decoded != chars) {
+      outStream << setw(10) << K->name << "  MISMATCH\n";
+      continue;
+    }
+    rate = 1 / (1 / encode_rate + 1 / decode_rate);
+    outStream << setw(10) << K->name << fixed << setprecision(1) << setw(10) << rate << " MB/s\n";
+    if (rate > best_rate) {
+      best_rate = rate;
+      profile.kernels = K->name;
+    }
+  }
+  bitpack_select(profile.kernels);
+
+  // 2. decode table width, through the whole block decoder so the cost of
+  // building a table for every block counts too
+
+  outStream << "decode table bits:\n";
+  chars_in.str(chars);
+  {
+    StreamEncoder encoder(compressed_out, DEFAULT_STREAM_BLOCK_SIZE);
+    encoder.copy_from(chars_in);
+  }
+  compressed = compressed_out.str();
+  best_rate = 0;
+
+  for (bits = TUNE_MIN_TABLE_BITS; bits <= TUNE_MAX_TABLE_BITS; bits++) {
+    DecodeTable::default_bits = bits;
+    rate = stream_decode_rate(compressed, chars.length());
+    outStream << setw(10) << bits << fixed << setprecision(1) << setw(10) << rate << " MB/s"
+              << setw(8) << (4 << bits) / 1024 << "K primary table\n";
+    if (rate * TUNE_CLOSE_ENOUGH > best_rate) {
+      best_rate = rate;
+      profile.decode_table_bits = bits;
+    }
+  }
+  DecodeTable::default_bits = profile.decode_table_bits;
+
+  // 3. block size: the fastest round trip that doesn't cost much ratio
+
+  outStream << "block size:\n";
+  vector <pair <int, pair <double, size_t> > > block_results;
+  best_bytes = 0;
+  for (size = TUNE_MIN_BLOCK_SIZE; size <= TUNE_MAX_BLOCK_SIZE; size *= 2) {
+    rate = stream_round_trip(chars, size, bytes);
+    block_results.push_back(make_pair(size, make_pair(rate, bytes)));
+    best_bytes = best_bytes == 0 ? bytes : min(best_bytes, bytes);
+    outStream << setw(10) << size << fixed << setprecision(1) << setw(10) << rate << " MB/s" << setw(12) << bytes << " bytes\n";
+  }
+  best_rate = 0;
+  for (i = 0; i < block_results.size(); i++)
+    if (block_results[i].second.second <= TUNE_SIZE_SLACK * best_bytes && block_results[i].second.first > best_rate) {
+      best_rate = block_results[i].second.first;
+      profile.block_size = block_results[i].first;
+    }
+
+  // 4. threads for decoding old-style files: more than the cores only if
+  // it really is faster
+
+  outStream << "threads:\n";
+  chars_in.clear();
+  chars_in.str(chars);
+  {
+    Huffman legacy;
+    legacy.compress_stream(chars_in, legacy_out, true);
+  }
+  data = legacy_out.str();
+  max_threads = 2 * max(1, profile.cores);
+  best_rate = 0;
+
+  for (t = 1; t <= max_threads; t *= 2) {
+    result = SyncDecodeResult();
+    if (!sync_decode_legacy(data, out, t, result) || out != chars) {
+      outStream << setw(10) << t << "  MISMATCH\n";
+      continue;
+    }
+    rate = time_kernel([&]() { SyncDecodeResult r; sync_decode_legacy(data, out, t, r); }, data.length(), TUNE_MIN_SECONDS);
+    outStream << setw(10) << t << fixed << setprecision(1) << setw(10) << rate << " MB/s\n";
+    if (rate * TUNE_CLOSE_ENOUGH > best_rate) {
+      best_rate = rate;
+      profile.threads = t;
+    }
+  }
+
+  outStream << "picked ";
+  profile.describe(outStream);
+  outStream << endl;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,68 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// picking kernels, table width, block size and threads for this host
+//----------------------------------------------------------------------------
+
+#ifndef TUNE_HH
+#define TUNE_HH
+
+#include "Huffman.hh"
+
+//----------------------------------------------------------------------------
+
+#define TUNE_MIN_SECONDS               0.1     // time each candidate at least this long
+#define TUNE_SAMPLE_CHARS              (4 * 1024 * 1024)
+#define TUNE_MIN_TABLE_BITS            8
+#define TUNE_MAX_TABLE_BITS            14
+#define TUNE_MIN_BLOCK_SIZE            (16 * 1024)
+#define TUNE_MAX_BLOCK_SIZE            (1024 * 1024)
+#define TUNE_SIZE_SLACK                1.01    // a block size may cost this much more output and still win on speed
+#define TUNE_CLOSE_ENOUGH              0.98    // within this of the fastest, prefer the smaller setting
+#define TUNE_PROFILE_NAME              ".huffman_profile"
+
+//----------------------------------------------------------------------------
+
+// what the fastest settings are depends on the machine: which bit packing
+// kernels it has, how big a decode table fits in L1 alongside everything
+// else, how big a block the encoder can histogram and code while it's
+// still in L2, and how many cores there are to decode on.  -tune times the
+// candidates on sample text and saves the winners to a profile, which
+// every later run loads at startup (flags on the command line still win).
+//
+// the profile is a text file of "name value" lines.  it's looked for in
+// -profile <file>, else $HUFFMAN_PROFILE, else ~/.huffman_profile.
+// settings the host can't use (kernels from a machine with AVX2 copied to
+// one without) are ignored
+
+class TuneProfile
+{
+public:
+
+  TuneProfile();
+  bool load(string);
+  bool save(string);
+  void describe(ostream &);
+
+  string kernels;            // bitpack_select() name
+  int decode_table_bits;     // DecodeTable primary width
+  int block_size;            // plain Huffman block stream blocks
+  int threads;               // for decoding old-style files, -test and -search
+
+  // the host it was measured on
+
+  long long l1d_bytes, l2_bytes;
+  int cores;
+};
+
+string default_profile_filename();
+
+// time the candidates on the chars of the given files (the bundled
+// cleaned_*.txt in the current directory if none are given), printing
+// each stage, and fill profile with the fastest
+
+bool tune_host(vector <string> &, TuneProfile &, ostream &);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,320 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// integrity test of .huf files: decode everything, write nothing
+//----------------------------------------------------------------------------
+
+#include "Verify.hh"
+#include "Protocol.hh"
+#include "Adaptive.hh"
+
+#include <sstream>
+#include <thread>
+#include <atomic>
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+void VerifyResult::print(ostream & outStream)
+{
+  outStream << filename << ": ";
+
+  if (!ok) {
+    outStream << "FAILED (" << format << ", " << message << ")\n";
+    return;
+  }
+
+  outStream << "OK (" << format << ", ";
+  if (format == "stream")
+    outStream << blocks << " blocks, ";
+  outStream << decoded_chars << " chars";
+  if (uncommitted_bytes > 0)
+    outStream << ", " << uncommitted_bytes << " bytes of an unfinished -append ignored";
+  if (seconds > 0)
+    outStream << ", " << compressed_bytes / seconds / 1e6 << " MB/s";
+  outStream << ")\n";
+}
+
+//----------------------------------------------------------------------------
+
+static bool verify_stream(const string & data, VerifyResult & result, int num_threads)
+{
+  vector <BlockLocation> locations;
+  const unsigned char *p;
+  atomic <int> next_block(0);
+  atomic <bool> failed(false);
+  vector <thread> workers;
+  mutex message_lock;
+  int i;
+
+  result.format = "stream";
+  p = (const unsigned char *) data.data();
+
+  // walk the headers first -- this is cheap, since payloads are skipped
+
+  if (!index_stream_blocks(data, locations, result.message, &result.uncommitted_bytes))
+    return false;
+  for (i = 0; i < locations.size(); i++)
+    result.decoded_chars += locations[i].header.num_chars;
+
+  result.blocks = locations.size();
+
+  // then decode the blocks, each thread taking the next one not yet done.
+  // each thread reuses one scratch buffer as the output "sink"
+
+  if (num_threads > locations.size())
+    num_threads = locations.size();
+  if (num_threads < 1)
+    num_threads = 1;
+
+  for (i = 0; i < num_threads; i++)
+    workers.push_back(thread([&]() {
+      string scratch, why;
+      int b;
+
+      while (!failed && (b = next_block++) < locations.size()) {
+        scratch.resize(locations[b].header.num_chars);
+        if (!decode_block(locations[b].header, p + locations[b].payload_offset, &scratch[0], why)) {
+          lock_guard <mutex> guard(message_lock);
+          if (!failed) {
+            ostringstream where;
+            where << "block " << b << ": " << why;
+            result.message = where.str();
+          }
+          failed = true;
+        }
+      }
+    }));
+
+  for (i = 0; i < workers.size(); i++)
+    workers[i].join();
+
+  return !failed;
+}
+
+//----------------------------------------------------------------------------
+
+// old-style binary file: decode the single bitstream with a lookup table
+
+static bool verify_legacy(const string & data, VerifyResult & result)
+{
+  istringstream inStream(data);
+  map <string, char>::iterator cur;
+  map <char, string> codes;
+  CodeTable T;
+  DecodeTable D;
+  Huffman H;
+  CountingStream discard;
+  unsigned char bad_bits;
+  long long total_bits;
+  size_t payload_start;
+  int c;
+
+  result.format = "legacy";
+
+  H.read_decompression_map(inStream, true);
+  bad_bits = inStream.get();
+  if (!inStream || bad_bits >= BITS_PER_BYTE) {
+    result.message = "truncated or corrupt header";
+    return false;
+  }
+  payload_start = inStream.tellg();
+
+  // codes too long for a CodeTable: fall back to the string decoder
+
+  for (cur = H.decompression_map.begin(); cur != H.decompression_map.end(); cur++)
+    codes[(*cur).second] = (*cur).first;
+
+  if (!T.from_compression_map(codes)) {
+    inStream.seekg(0);
+    if (!H.decompress_stream(inStream, discard, true)) {
+      result.message = "decoding error";
+      return false;
+    }
+    result.decoded_chars = discard.count();
+    return true;
+  }
+
+  if (!D.build(T)) {
+    result.message = "code table is not a prefix code";
+    return false;
+  }
+
+  total_bits = 8LL * (data.length() - payload_start) - bad_bits;
+  if (total_bits < 0) {
+    result.message = "padding longer than payload";
+    return false;
+  }
+
+  BitReader in((const unsigned char *) data.data() + payload_start, data.length() - payload_start);
+
+  while (in.bits_consumed() < total_bits) {
+    c = D.decode(in);
+    if (c < 0) {
+      result.message = "invalid code";
+      return false;
+    }
+    result.decoded_chars++;
+  }
+
+  if (in.bits_consumed() != total_bits) {
+    result.message = "last code runs into padding";
+    return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// old-style -ascii file: there's nothing to check but that it decodes
+
+static bool verify_ascii(const string & data, VerifyResult & result)
+{
+  istringstream inStream(data);
+  CountingStream discard;
+  Huffman H;
+
+  result.format = "ascii";
+
+  if (!H.decompress_stream(inStream, discard, false)) {
+    result.message = "decoding error";
+    return false;
+  }
+  result.decoded_chars = discard.count();
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+// adaptive files have no checksum either: they have to decode cleanly to
+// the end marker, with nothing after it (see AdaptiveDecoder::copy_to())
+
+static bool verify_adaptive(const string & data, VerifyResult & result)
+{
+  istringstream inStream(data);
+  NullStream discard;
+  AdaptiveDecoder decoder(inStream);
+
+  result.format = "adaptive";
+
+  if (!decoder.copy_to(discard)) {
+    result.message = decoder.message;
+    return false;
+  }
+  result.decoded_chars = decoder.bytes_out;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+
+bool verify_buffer(const string & data, VerifyResult & result, bool do_binary, int num_threads)
+{
+  double start;
+
+  start = now_microseconds();
+  result.compressed_bytes = data.length();
+
+  if (do_binary && data.length() >= STREAM_MAGIC_BYTES && !memcmp(data.data(), STREAM_MAGIC, STREAM_MAGIC_BYTES))
+    result.ok = verify_stream(data, result, num_threads);
+  else if (do_binary && !data.empty() && (unsigned char) data[0] == ADAPTIVE_MAGIC)
+    result.ok = verify_adaptive(data, result);
+  else if (do_binary)
+    result.ok = verify_legacy(data, result);
+  else
+    result.ok = verify_ascii(data, result);
+
+  result.seconds = (now_microseconds() - start) / 1e6;
+
+  return result.ok;
+}
+
+//----------------------------------------------------------------------------
+
+// the whole file in one read, sized up front
+
+bool read_whole_file(string filename, string & data)
+{
+  ifstream inStream;
+  streamoff length;
+
+  inStream.open(filename.c_str(), ios::binary);
+  if (inStream.fail())
+    return false;
+
+  inStream.seekg(0, ios::end);
+  length = inStream.tellg();
+  inStream.seekg(0, ios::beg);
+  if (length < 0)
+    return false;
+
+  data.resize(length);
+  if (length > 0)
+    inStream.read(&data[0], length);
+
+  return inStream.gcount() == length || length == 0;
+}
+
+//----------------------------------------------------------------------------
+
+bool verify_file(string filename, VerifyResult & result, bool do_binary, int num_threads)
+{
+  string data;
+
+  result.filename = filename;
+
+  if (!read_whole_file(filename, data)) {
+    result.format = "unreadable";
+    result.message = "can't open file";
+    result.ok = false;
+    return false;
+  }
+
+  return verify_buffer(data, result, do_binary, num_threads);
+}
+
+//----------------------------------------------------------------------------
+
+// test every file, spreading the work over num_threads threads: whole
+// files at a time when there are enough of them, otherwise the spare
+// threads go to decoding blocks within each file.  prints one line per
+// file in command-line order and returns how many failed
+
+int verify_files(vector <string> & filenames, bool do_binary, int num_threads, ostream & outStream)
+{
+  vector <VerifyResult> results(filenames.size());
+  vector <thread> workers;
+  atomic <int> next_file(0);
+  int file_threads, block_threads, failures, i;
+
+  if (num_threads < 1)
+    num_threads = 1;
+
+  file_threads = min(num_threads, (int) filenames.size());
+  if (file_threads < 1)
+    return 0;
+  block_threads = max(1, num_threads / file_threads);
+
+  for (i = 0; i < file_threads; i++)
+    workers.push_back(thread([&]() {
+      int f;
+      while ((f = next_file++) < filenames.size())
+        verify_file(filenames[f], results[f], do_binary, block_threads);
+    }));
+
+  for (i = 0; i < workers.size(); i++)
+    workers[i].join();
+
+  failures = 0;
+  for (i = 0; i < results.size(); i++) {
+    results[i].print(outStream);
+    if (!results[i].ok)
+      failures++;
+  }
+
+  return failures;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,91 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// integrity test of .huf files: decode everything, write nothing
+//----------------------------------------------------------------------------
+
+#ifndef VERIFY_HH
+#define VERIFY_HH
+
+#include "Huffman.hh"
+#include "StreamCodec.hh"
+
+//----------------------------------------------------------------------------
+
+// an ostream that throws away whatever is written to it
+
+class NullBuffer : public streambuf
+{
+protected:
+  int overflow(int c) { return c; }
+  streamsize xsputn(const char *, streamsize n) { return n; }
+};
+
+class NullStream : public ostream
+{
+public:
+  NullStream() : ostream(&buffer) {}
+private:
+  NullBuffer buffer;
+};
+
+// the same, but counting the chars thrown away
+
+class CountingBuffer : public streambuf
+{
+public:
+  CountingBuffer() { count = 0; }
+  long long count;
+protected:
+  int overflow(int c) { if (c != EOF) count++; return c; }
+  streamsize xsputn(const char *, streamsize n) { count += n; return n; }
+};
+
+class CountingStream : public ostream
+{
+public:
+  CountingStream() : ostream(&buffer) {}
+  long long count() { flush(); return buffer.count; }
+private:
+  CountingBuffer buffer;
+};
+
+//----------------------------------------------------------------------------
+
+// outcome of testing one file
+
+class VerifyResult
+{
+public:
+
+  VerifyResult() { ok = false; blocks = 0; compressed_bytes = decoded_chars = 0; uncommitted_bytes = 0; seconds = 0; }
+  void print(ostream &);
+
+  string filename;
+  bool ok;
+  string format;              // "stream", "adaptive", "legacy" or "ascii"
+  string message;             // why it failed
+  int blocks;
+  long long compressed_bytes;
+  long long decoded_chars;
+  size_t uncommitted_bytes;   // after a stream's end marker (see index_stream_blocks())
+  double seconds;
+};
+
+//----------------------------------------------------------------------------
+
+// block stream files have their block sizes, payload lengths and CRCs
+// checked, with blocks decoded on up to num_threads threads (anything
+// after the end marker is an append that never committed, and is
+// ignored, as decompressing does).  old-style
+// binary files have no checksum; they are checked for decoding cleanly and
+// ending exactly on a code boundary
+
+bool read_whole_file(string, string &);
+bool verify_buffer(const string &, VerifyResult &, bool = true, int = 1);
+bool verify_file(string, VerifyResult &, bool = true, int = 1);
+int verify_files(vector <string> &, bool, int, ostream &);
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+#endif
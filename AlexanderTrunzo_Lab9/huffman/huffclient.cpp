@@ -0,0 +1,102 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// command-line client for the compression daemon
+//----------------------------------------------------------------------------
+
+#include "Protocol.hh"
+
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <string.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+  unsigned char op, flags, status, reply_flags;
+  string socket_path, in_filename, out_filename, request, response;
+  ifstream inStream;
+  ofstream outStream;
+  ostringstream contents;
+  double start, elapsed;
+  int fd;
+
+  if (argc < 3) {
+    cout << "huffclient <socket> [-ascii] (-c <infile> <outfile> | -d <infile> <outfile> | -stats)\n";
+    exit(1);
+  }
+
+  socket_path = argv[1];
+  op = 0;
+  flags = 0;
+
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp("-ascii", argv[i]))
+      flags |= FLAG_ASCII;
+    else if (!strcmp("-stats", argv[i]))
+      op = OP_STATS;
+    else if ((!strcmp("-c", argv[i]) || !strcmp("-d", argv[i])) && i + 2 < argc) {
+      op = argv[i][1] == 'c' ? OP_COMPRESS : OP_DECOMPRESS;
+      in_filename = argv[++i];
+      out_filename = argv[++i];
+    }
+  }
+
+  if (op == 0) {
+    cout << "huffclient: nothing to do\n";
+    exit(1);
+  }
+
+  // read whole input file as the request payload
+
+  if (op != OP_STATS) {
+    inStream.open(in_filename.c_str(), ios::binary);
+    if (inStream.fail()) {
+      cout << "Failed to open input file " << in_filename << endl;
+      exit(1);
+    }
+    contents << inStream.rdbuf();
+    request = contents.str();
+    inStream.close();
+  }
+
+  fd = connect_unix_socket(socket_path);
+  if (fd < 0) {
+    cout << "huffclient: can't connect to " << socket_path << endl;
+    exit(1);
+  }
+
+  start = now_microseconds();
+
+  if (!send_frame(fd, op, flags, request) || !recv_frame(fd, status, reply_flags, response)) {
+    cout << "huffclient: connection to daemon failed\n";
+    exit(1);
+  }
+
+  elapsed = now_microseconds() - start;
+  close(fd);
+
+  if (status != STATUS_OK) {
+    cout << "huffclient: daemon reported an error\n" << response;
+    exit(1);
+  }
+
+  if (op == OP_STATS) {
+    cout << response;
+    return 0;
+  }
+
+  outStream.open(out_filename.c_str(), ios::binary);
+  outStream.write(response.data(), response.length());
+  outStream.close();
+
+  cout << request.length() << " -> " << response.length() << " bytes in " << elapsed << " us\n";
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
@@ -0,0 +1,142 @@
+//----------------------------------------------------------------------------
+// huffman coding for file compression with tries
+// load generator for the compression daemon: measures request latency
+//----------------------------------------------------------------------------
+
+#include "Protocol.hh"
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <cstdlib>
+#include <string.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------
+
+#define DEFAULT_LOAD_REQUESTS          1000
+#define DEFAULT_LOAD_CONNECTIONS       4
+
+//----------------------------------------------------------------------------
+
+LatencyStats latency;
+int failures = 0;
+mutex failures_lock;
+
+//----------------------------------------------------------------------------
+
+// one client connection sending n identical requests back to back
+
+void client_loop(string socket_path, unsigned char op, unsigned char flags, string * request, int n)
+{
+  unsigned char status, reply_flags;
+  string response;
+  double start;
+  int fd, i, failed;
+
+  failed = 0;
+
+  fd = connect_unix_socket(socket_path);
+  if (fd < 0)
+    failed = n;
+
+  for (i = 0; i < n && fd >= 0; i++) {
+    start = now_microseconds();
+    if (!send_frame(fd, op, flags, *request) || !recv_frame(fd, status, reply_flags, response)) {
+      failed += n - i;
+      break;
+    }
+    latency.add(now_microseconds() - start);
+    if (status != STATUS_OK)
+      failed++;
+  }
+
+  if (fd >= 0)
+    close(fd);
+
+  lock_guard <mutex> guard(failures_lock);
+  failures += failed;
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+  unsigned char op, flags, status, reply_flags;
+  string socket_path, filename, request, response;
+  ifstream inStream;
+  ostringstream contents;
+  vector <thread> clients;
+  int num_requests, num_connections, fd, i, n;
+  double start, elapsed;
+
+  if (argc < 3) {
+    cout << "huffload <socket> <file> [-d] [-ascii] [-n <requests>] [-c <connections>]\n";
+    exit(1);
+  }
+
+  socket_path = argv[1];
+  filename = argv[2];
+  op = OP_COMPRESS;
+  flags = 0;
+  num_requests = DEFAULT_LOAD_REQUESTS;
+  num_connections = DEFAULT_LOAD_CONNECTIONS;
+
+  for (i = 3; i < argc; i++) {
+    if (!strcmp("-d", argv[i]))
+      op = OP_DECOMPRESS;
+    else if (!strcmp("-ascii", argv[i]))
+      flags |= FLAG_ASCII;
+    else if (!strcmp("-n", argv[i]) && i + 1 < argc)
+      num_requests = atoi(argv[++i]);
+    else if (!strcmp("-c", argv[i]) && i + 1 < argc)
+      num_connections = atoi(argv[++i]);
+  }
+
+  if (num_connections < 1)
+    num_connections = 1;
+
+  inStream.open(filename.c_str(), ios::binary);
+  if (inStream.fail()) {
+    cout << "Failed to open input file " << filename << endl;
+    exit(1);
+  }
+  contents << inStream.rdbuf();
+  request = contents.str();
+  inStream.close();
+
+  // for a decompression load, have the daemon make the compressed payload
+
+  if (op == OP_DECOMPRESS) {
+    fd = connect_unix_socket(socket_path);
+    if (fd < 0 || !send_frame(fd, OP_COMPRESS, flags, request) ||
+        !recv_frame(fd, status, reply_flags, response) || status != STATUS_OK) {
+      cout << "huffload: couldn't get compressed payload from daemon\n";
+      exit(1);
+    }
+    close(fd);
+    request = response;
+  }
+
+  // split requests as evenly as possible over the connections
+
+  start = now_microseconds();
+
+  for (i = 0; i < num_connections; i++) {
+    n = num_requests / num_connections + (i < num_requests % num_connections ? 1 : 0);
+    clients.push_back(thread(client_loop, socket_path, op, flags, &request, n));
+  }
+  for (i = 0; i < clients.size(); i++)
+    clients[i].join();
+
+  elapsed = now_microseconds() - start;
+
+  latency.print(cout, op == OP_COMPRESS ? "compress" : "decompress");
+  cout << num_connections << " connections, " << request.length() << " byte payload, "
+       << latency.count() / (elapsed / 1e6) << " requests/s, " << failures << " failures\n";
+
+  return failures > 0;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
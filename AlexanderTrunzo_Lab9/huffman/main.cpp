@@ -5,15 +5,57 @@
 //----------------------------------------------------------------------------
 
 #include "Huffman.hh"
+#include "TableCache.hh"
+#include "Daemon.hh"
+#include "StreamCodec.hh"
+#include "Verify.hh"
+#include "Deflate.hh"
+#include "BitPack.hh"
+#include "Bench.hh"
+#include "Search.hh"
+#include "RecordCodec.hh"
+#include "SyncDecode.hh"
+#include "Append.hh"
+#include "Convert.hh"
+#include "AsyncIO.hh"
+#include "Tune.hh"
+#include "Adaptive.hh"
+#include <thread>
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <sys/stat.h>
+#include <sstream>
 //----------------------------------------------------------------------------
 
 bool debug_flag = false;
 bool ascii_flag = false;
-
-vector<char> v;
+bool stream_flag = false;
+bool decompress_flag = false;
+int stream_block_size = 0;           // 0: default for the kind of blocks
+int lz_level = 0;                    // 0: no LZ stage
+int lz_window_bits = DEFAULT_LZ_WINDOW_BITS;
+int split_level = 0;                 // 0: fixed-size blocks
+bool columns_flag = false;           // -columns: a code table per tab-separated column
+bool bwt_flag = false;               // -bwt: Burrows-Wheeler stage ahead of the Huffman coder
+bool adaptive_flag = false;          // -adaptive: one-pass adaptive Huffman, no code table
+int rescale_bits = DEFAULT_ADAPTIVE_RESCALE_BITS;
+bool test_flag = false;
+int num_threads = thread::hardware_concurrency();
+string output_format = "huf";        // huf, stream, deflate or gzip
+string bench_mode;                   // -bench: which benchmark to run
+bool search_flag = false;
+bool records_flag = false;
+long long record_index = -1;         // -record: print just this record
+bool perf_flag = false;              // -perf: hardware counters in -bench phases
+int decode_table_bits = DEFAULT_DECODE_TABLE_BITS;
+string search_pattern;
+string append_filename;              // -append: the .huf file to add to
+string convert_to;                   // -convert: binary or ascii
+int io_mode = IO_URING;              // -io threads: pread/pwrite instead of io_uring
+bool direct_flag = false;            // -direct: O_DIRECT for big files
+int tuned_block_size = 0;            // from the -tune profile; 0: none
+string profile_filename = default_profile_filename();
 //----------------------------------------------------------------------------
 
 // ** FILL THIS FUNCTION IN ** 
@@ -82,132 +124,28 @@ void Huffman::merge_two_least_frequent_subtries()
 // if T is a leaf, make sure to execute the 
 // compression_map and decompression_map assignments
 
-//have to figure out the huffcode, so going down the tree if i go left its 0, right its 1, 
+// each left branch adds a 0 to the code, each right branch a 1.  a trie
+// that is a single leaf (file with one distinct char) still gets a 1-bit code
+
 void Huffman::compute_all_codes_from_trie(TrieNode *T)
 {
+  if (T->left == NULL && T->right == NULL) {
+    if (T->huffcode.empty())
+      T->huffcode = "0";
+    compression_map[T->character] = T->huffcode;
+    decompression_map[T->huffcode] = T->character;
+    return;
+  }
 
-TrieNode *root;
-root = T;
-if(T->left != NULL){
-  T = T->left;
-  v.push_back(T->character);
-  T->huffcode = '0';
-  compression_map.insert(make_pair(T->character, T->huffcode));
-  decompression_map.insert(make_pair(T->huffcode, T->character));
-  compression_map[T->character] = T->huffcode;
-  decompression_map[T->huffcode] = T->character;
-}
-else if(T->right != NULL){
-  T=T->right;
-  v.push_back(T->character);
-  T->huffcode = '1';
-  compression_map.insert(make_pair(T->character, T->huffcode));
-  decompression_map.insert(make_pair(T->huffcode, T->character));
-  compression_map[T->character] = T->huffcode;
-  decompression_map[T->huffcode] = T->character;
-}
-while (T->parent != NULL){
-	while (T->left != NULL && find(v.begin(), v.end(), T->left->character) == v.end()){
-		T=T->left; 
-  		v.push_back(T->character);
-  		T->huffcode = T->huffcode + '0';
-  		compression_map.insert(make_pair(T->character, T->huffcode));
-  		decompression_map.insert(make_pair(T->huffcode, T->character));
-  		compression_map[T->character] = T->huffcode;
-  		decompression_map[T->huffcode] = T->character;
-	}
-	while (T->right == NULL && T->parent != NULL){
-		T=T->parent;
-  		v.push_back(T->character);
-  		//T->huffcode = T->huffcode.pop_back();
-		if(T->huffcode.size()>0){
-  			//v.push_back(T->character);
-			T->huffcode.resize(T->huffcode.size() - 1);
-  			//compression_map.insert(make_pair(T->character, T->huffcode));
-  			//decompression_map.insert(make_pair(T->huffcode, T->character));
-  			compression_map[T->character] = T->huffcode;
-  			decompression_map[T->huffcode] = T->character;
-  		}else{ 
-		}	
-		
-		
-	}
-	if (T->parent!=NULL && find(v.begin(), v.end(), T->right->character) == v.end()){
- 	
-		T=T->right;	
-  		v.push_back(T->character);
-  		T->huffcode = T->huffcode + '1';
-  		compression_map.insert(make_pair(T->character, T->huffcode));
-  		decompression_map.insert(make_pair(T->huffcode, T->character));
-  		compression_map[T->character] = T->huffcode;
-  		decompression_map[T->huffcode] = T->character;
-}else if (T->parent!=NULL){
-	T=T->parent;
-  	v.push_back(T->character);
-	if(T->huffcode.size()>0){
-		T->huffcode.resize(T->huffcode.size()-1);
-	}
-}}
-T=root;
-if(T->right != NULL){
-	T=T->right;
-	v.push_back(T->character);
-	T->huffcode = '1';
-  	compression_map.insert(make_pair(T->character, T->huffcode));
-  	decompression_map.insert(make_pair(T->huffcode, T->character));
-	compression_map[T->character] = T->huffcode;
-	decompression_map[T->huffcode] = T->character;		 
-}	
-while (T->parent != NULL){	 
-	while (T->left != NULL && find(v.begin(), v.end(), T->left->character) == v.end()){
-		T=T->left; 
-  		v.push_back(T->character);
-  		T->huffcode = T->huffcode + '0';
-  		compression_map.insert(make_pair(T->character, T->huffcode));
-  		decompression_map.insert(make_pair(T->huffcode, T->character));
-  		compression_map[T->character] = T->huffcode;
-  		decompression_map[T->huffcode] = T->character;
-	}
-	while (T->right == NULL && T->parent != NULL){
-		T=T->parent;
-  		v.push_back(T->character);
-  		//T->huffcode = T->huffcode.pop_back();
-  		T->huffcode.resize(T->huffcode.size() - 1);
-  		compression_map.insert(make_pair(T->character, T->huffcode));
-  		decompression_map.insert(make_pair(T->huffcode, T->character));
-  		compression_map[T->character] = T->huffcode;
-  		decompression_map[T->huffcode] = T->character;
-	}
-	if (T->parent!=NULL && find(v.begin(), v.end(), T->right->character) == v.end()){
-		T=T->right;
- 		v.push_back(T->character);
-  		T->huffcode = T->huffcode + '1';
-  		compression_map.insert(make_pair(T->character, T->huffcode));
-  		decompression_map.insert(make_pair(T->huffcode, T->character));
-  		compression_map[T->character] = T->huffcode;
-  		decompression_map[T->huffcode] = T->character;
-}else if (T->parent != NULL){
-	T=T->parent;
- 	v.push_back(T->character);
-	if(T->huffcode.size()>0){
-		T->huffcode.resize(T->huffcode.size()-1);
-	}
-}
-}
+  if (T->left != NULL) {
+    T->left->huffcode = T->huffcode + '0';
+    compute_all_codes_from_trie(T->left);
+  }
+  if (T->right != NULL) {
+    T->right->huffcode = T->huffcode + '1';
+    compute_all_codes_from_trie(T->right);
+  }
 }
-  // comment this line out when you start to code, obviously
-  //cout << "compute_all_codes_from_trie(): NOT YET WRITTEN\n"; exit(1);
- // int x= 0;
-//while(x < T.size()){
-//	T->huffcode = ???
-//	compression_map[T->character] = T->huffcode;
-//	decompression_map[T->huffcode] = T->character;
-//}else{}
-//	x = x + 1;
-//}
-//while trienode doesn't equal the letter,
-//TrieNodePtrCompare if true then 0
-//if false then 1
 
 //----------------------------------------------------------------------------
 
@@ -220,24 +158,12 @@ while (T->parent != NULL){
 
 int Huffman::calculate_huffman_file_size()
 {
-  // comment this line out when you start to code, obviously
-  //cout << "calculate_huffman_file_size(): NOT YET WRITTEN\n"; exit(1);
+  map <char, string>::iterator cur;
   int sum = 0;
-  int mult;
-  char letter; 
-  int let;
-  for(int i = 0; i < 128; i++){
-	
-	letter = (char) i;
-	//cout<<letter;
-	//cout<<char_counter[i];
-
-	//cout<< compression_map.find(letter)<<'\n';
-	mult = char_counter[i]; //* //compression_map[i].size() //huffcode length;
-  	sum = sum + mult;
-  
-  // ???
-}
+
+  for (cur = compression_map.begin(); cur != compression_map.end(); cur++)
+    sum += char_counter[(unsigned char) (*cur).first] * (*cur).second.length();
+
   return sum;
 }
 //----------------------------------------------------------------------------
@@ -273,10 +199,449 @@ void example_function()
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
 
+// block size for the block stream encoder
+
+int block_size()
+{
+  if (stream_block_size > 0)
+    return stream_block_size;
+
+  if (lz_level > 0)
+    return DEFAULT_LZ_BLOCK_SIZE;
+  if (bwt_flag)
+    return DEFAULT_BWT_BLOCK_SIZE;
+  if (split_level > 0)
+    return DEFAULT_SPLIT_BLOCK_SIZE;
+  return tuned_block_size > 0 ? tuned_block_size : DEFAULT_STREAM_BLOCK_SIZE;
+}
+
+//----------------------------------------------------------------------------
+
+// AsyncIO flags for reading in_filename and writing what it turns into.
+// O_DIRECT only for files too big to be worth caching
+
+int io_flags(string in_filename)
+{
+  struct stat st;
+
+  if (direct_flag && stat(in_filename.c_str(), &st) == 0 && st.st_size >= IO_DIRECT_MIN_BYTES)
+    return io_mode | IO_DIRECT;
+  return io_mode;
+}
+
+//----------------------------------------------------------------------------
+
+// like Huffman::compress(), but writes the block stream format.  reading,
+// encoding and writing overlap (see AsyncIO.hh)
+
+void stream_compress_file(string in_filename, string out_filename, TableCache *cache)
+{
+  AsyncInput inStream;
+  AsyncOutput outStream;
+  int flags = io_flags(in_filename);
+
+  cout << "COMPRESSING to " << out_filename << endl;
+
+  if (!inStream.open(in_filename, flags)) {
+    cout << "Failed to open input file " << in_filename << endl;
+    exit(1);
+  }
+  outStream.open(out_filename, flags);
+
+  {
+    StreamEncoder encoder(outStream, block_size(), cache);
+    if (lz_level > 0)
+      encoder.set_lz(lz_level, lz_window_bits);
+    else if (bwt_flag)
+      encoder.set_bwt(max(1, num_threads));
+    else if (split_level > 0)
+      encoder.set_split(split_level);
+    encoder.set_columns(columns_flag);
+    if (!encoder.copy_from(inStream) || !inStream.close() || !outStream.close()) {
+      cout << "Failed to write " << out_filename << endl;
+      exit(1);
+    }
+
+    if (debug_flag)
+      cout << encoder.bytes_in << " -> " << encoder.bytes_out << " bytes in " << encoder.blocks << " blocks"
+           << (columns_flag ? ", " + to_string(encoder.column_blocks) + " with column tables" : "")
+           << (outStream.used_uring() ? ", io_uring" : "") << endl;
+  }
+}
+
+//----------------------------------------------------------------------------
+
+// one pass, no code table (see Adaptive.hh)
+
+void adaptive_compress_file(string in_filename, string out_filename)
+{
+  AsyncInput inStream;
+  AsyncOutput outStream;
+  int flags = io_flags(in_filename);
+
+  cout << "COMPRESSING to " << out_filename << endl;
+
+  if (!inStream.open(in_filename, flags)) {
+    cout << "Failed to open input file " << in_filename << endl;
+    exit(1);
+  }
+  outStream.open(out_filename, flags);
+
+  AdaptiveEncoder encoder(outStream, rescale_bits);
+  if (!encoder.copy_from(inStream) || !inStream.close() || !outStream.close()) {
+    cout << "Failed to write " << out_filename << endl;
+    exit(1);
+  }
+
+  if (debug_flag)
+    cout << encoder.bytes_in << " -> " << encoder.bytes_out << " bytes, " << encoder.tree.rebuilds << " rescales" << endl;
+}
+
+//----------------------------------------------------------------------------
+
+// Huffman::compress(), with the output written behind the encoder.  the
+// input is read twice, so it stays an ifstream
+
+void legacy_compress_file(Huffman & H, string in_filename, string out_filename)
+{
+  ifstream inStream;
+  AsyncOutput outStream;
+
+  cout << "COMPRESSING to " << out_filename << endl;
+
+  inStream.open(in_filename.c_str());
+  if (inStream.fail()) {
+    cout << "Failed to open input file " << in_filename << endl;
+    exit(1);
+  }
+  outStream.open(out_filename, io_flags(in_filename));
+
+  H.compress_stream(inStream, outStream, !ascii_flag);
+  if (!outStream.close()) {
+    cout << "Failed to write " << out_filename << endl;
+    exit(1);
+  }
+}
+
+//----------------------------------------------------------------------------
+
+// old-style binary files are decoded on num_threads threads (see
+// SyncDecode.hh).  block stream files, tables whose codes are too long
+// for a lookup table and files that don't decode cleanly all go through
+// Huffman::decompress(), so its output and messages for them don't change
+
+void binary_decompress_file(Huffman & H, string in_filename, string out_filename)
+{
+  SyncDecodeResult result;
+  string data, text;
+  AsyncInput inStream;
+  AsyncOutput outStream;
+  int flags = io_flags(in_filename);
+
+  if (!inStream.open(in_filename, flags)) {
+    H.decompress(in_filename, out_filename, true);
+    return;
+  }
+
+  // block stream: read, decode and write overlap, and blocks are decoded
+  // num_threads at a time
+
+  if (is_stream_format(inStream)) {
+    cout << "DECOMPRESSING to " << out_filename << endl;
+    outStream.open(out_filename, flags);
+    StreamDecoder decoder(inStream);
+    decoder.set_threads(num_threads);
+    if (!decoder.copy_to(outStream) || !inStream.close() || !outStream.close()) {
+      cout << "Failed to decompress " << in_filename << endl;
+      exit(1);
+    }
+    return;
+  }
+
+  if (is_adaptive_format(inStream)) {
+    cout << "DECOMPRESSING to " << out_filename << endl;
+    outStream.open(out_filename, flags);
+    AdaptiveDecoder decoder(inStream);
+    if (!decoder.copy_to(outStream) || !inStream.close() || !outStream.close()) {
+      cout << "Failed to decompress " << in_filename << endl;
+      exit(1);
+    }
+    return;
+  }
+
+  data.resize(inStream.size());
+  inStream.read(&data[0], data.length());
+  if (inStream.gcount() != data.length() || !inStream.close() || !sync_decode_legacy(data, text, num_threads, result)) {
+    H.decompress(in_filename, out_filename, true);
+    return;
+  }
+
+  cout << "DECOMPRESSING to " << out_filename << endl;
+
+  outStream.open(out_filename, flags);
+  outStream.write(text.data(), text.length());
+  if (!outStream.close()) {
+    cout << "Failed to write " << out_filename << endl;
+    exit(1);
+  }
+
+  if (debug_flag)
+    cout << result.chunks << " chunks, " << result.resynced << " resynced, " << result.redecoded
+         << " decoded again, " << result.sync_bits << " bits decoded twice\n";
+}
+
+//----------------------------------------------------------------------------
+
+// -format deflate / gzip: output that zlib and gzip -d can read
+
+bool deflate_format()
+{
+  return output_format == "deflate" || output_format == "gzip";
+}
+
+void deflate_compress_file(string in_filename, string out_filename)
+{
+  ifstream inStream;
+  ofstream outStream;
+
+  cout << "COMPRESSING to " << out_filename << endl;
+
+  inStream.open(in_filename.c_str(), ios::binary);
+  if (inStream.fail()) {
+    cout << "Failed to open input file " << in_filename << endl;
+    exit(1);
+  }
+  outStream.open(out_filename.c_str(), ios::binary);
+
+  DeflateEncoder encoder(outStream, output_format == "gzip", stream_block_size, lz_level);
+  if (!encoder.copy_from(inStream)) {
+    cout << "Failed to write " << out_filename << endl;
+    exit(1);
+  }
+
+  if (debug_flag)
+    cout << encoder.bytes_in << " -> " << encoder.bytes_out << " bytes\n";
+}
+
+//----------------------------------------------------------------------------
+
+// -records: each line of the input is one record, and the whole file is
+// one batch (see RecordCodec.hh).  decompressing writes the records back
+// one per line, with no '\n' after the last one if the input had none
+
+void records_compress_file(string in_filename, string out_filename)
+{
+  vector <string> records;
+  ifstream inStream;
+  ofstream outStream;
+  string line, batch;
+  unsigned char flags;
+
+  cout << "COMPRESSING to " << out_filename << endl;
+
+  inStream.open(in_filename.c_str(), ios::binary);
+  if (inStream.fail()) {
+    cout << "Failed to open input file " << in_filename << endl;
+    exit(1);
+  }
+  // a line read without hitting the end of the file ended in '\n'
+
+  flags = 0;
+  while (getline(inStream, line)) {
+    records.push_back(line);
+    flags = inStream.eof() ? 0 : RECORD_FINAL_NEWLINE;
+  }
+
+  if (!encode_records(records, batch, CodeBookPtr(), flags)) {
+    cout << "Failed to encode records of " << in_filename << endl;
+    exit(1);
+  }
+
+  outStream.open(out_filename.c_str(), ios::binary);
+  outStream.write(batch.data(), batch.length());
+
+  if (debug_flag)
+    cout << records.size() << " records -> " << batch.length() << " bytes\n";
+}
+
+void records_decompress_file(string in_filename, string out_filename)
+{
+  RecordReader reader;
+  ofstream outStream;
+  string batch, record, message;
+  size_t i;
+
+  if (!read_whole_file(in_filename, batch)) {
+    cout << "Failed to open input file " << in_filename << endl;
+    exit(1);
+  }
+  if (!reader.open(batch, message)) {
+    cout << in_filename << ": " << message << endl;
+    exit(1);
+  }
+
+  // RANDOM ACCESS!!! just the one record, to the screen
+
+  if (record_index >= 0) {
+    if (!reader.get(record_index, record)) {
+      cout << in_filename << ": no record " << record_index << " (" << reader.size() << " records)\n";
+      exit(1);
+    }
+    cout << record << endl;
+    return;
+  }
+
+  cout << "DECOMPRESSING to " << out_filename << endl;
+
+  outStream.open(out_filename.c_str(), ios::binary);
+  for (i = 0; i < reader.size(); i++) {
+    if (!reader.get(i, record)) {
+      cout << in_filename << ": record " << i << " is corrupt\n";
+      exit(1);
+    }
+    outStream << record;
+    if (i + 1 < reader.size() || (reader.flags() & RECORD_FINAL_NEWLINE))
+      outStream << '\n';
+  }
+}
+
+//----------------------------------------------------------------------------
+
+// compress or decompress a single file, depending on its suffix
+
+void process_file(string input_filename, TableCache *cache)
+{
+  string output_filename(input_filename);
+  Huffman H;
+
+  H.table_cache = cache;
+
+  // PIPE!!! "-" means stdin to stdout, always in block stream format
+
+  if (input_filename == "-") {
+    ios::sync_with_stdio(false);
+    if (decompress_flag && is_adaptive_format(cin)) {
+      AdaptiveDecoder decoder(cin);
+      if (!decoder.copy_to(cout))
+        exit(1);
+    }
+    else if (decompress_flag) {
+      StreamDecoder decoder(cin);
+      if (!decoder.copy_to(cout))
+        exit(1);
+    }
+    else if (adaptive_flag) {
+      AdaptiveEncoder encoder(cout, rescale_bits);
+      if (!encoder.copy_from(cin))
+        exit(1);
+    }
+    else if (deflate_format()) {
+      DeflateEncoder encoder(cout, output_format == "gzip", stream_block_size, lz_level);
+      if (!encoder.copy_from(cin))
+        exit(1);
+    }
+    else {
+      StreamEncoder encoder(cout, block_size(), cache);
+      if (lz_level > 0)
+        encoder.set_lz(lz_level, lz_window_bits);
+      else if (bwt_flag)
+        encoder.set_bwt(max(1, num_threads));
+      else if (split_level > 0)
+        encoder.set_split(split_level);
+      encoder.set_columns(columns_flag);
+      if (!encoder.copy_from(cin))
+        exit(1);
+    }
+    return;
+  }
+
+  // RECORDS!!! .rec <-> .REC, like .huf <-> .HUF
+
+  if (records_flag) {
+    if (input_filename.length() >= 4 && input_filename.substr(input_filename.length() - 4, 4) == ".rec") {
+      output_filename.replace(output_filename.length() - 4, 4, ".REC");
+      records_decompress_file(input_filename, output_filename);
+    }
+    else {
+      if (input_filename.length() >= 4 && input_filename.substr(input_filename.length() - 4, 4) == ".REC")
+        output_filename.replace(output_filename.length() - 4, 4, ".rec");
+      else
+        output_filename += ".rec";
+      records_compress_file(input_filename, output_filename);
+    }
+    return;
+  }
+
+  // DEFLATE!!! output will end in .gz or .deflate; there's no decoder here
+
+  if (deflate_format() && !decompress_flag) {
+    output_filename += output_format == "gzip" ? ".gz" : ".deflate";
+    deflate_compress_file(input_filename, output_filename);
+    return;
+  }
+
+  // DECOMPRESS!!! output will end in .HUF
+
+  if (input_filename.length() >= 4 && input_filename.substr(input_filename.length() - 4, 4) == ".huf") {
+    output_filename.replace(output_filename.length() - 4, 4, ".HUF");
+    if (ascii_flag)
+      H.decompress(input_filename, output_filename, false);
+    else
+      binary_decompress_file(H, input_filename, output_filename);
+  }
+
+  // COMPRESS!!! output will end in .huf
+
+  else {
+    if (input_filename.length() >= 4 && input_filename.substr(input_filename.length() - 4, 4) == ".HUF")
+      output_filename.replace(output_filename.length() - 4, 4, ".huf");
+    else
+      output_filename += ".huf";
+    if (adaptive_flag)
+      adaptive_compress_file(input_filename, output_filename);
+    else if (stream_flag || lz_level > 0 || split_level > 0 || columns_flag || bwt_flag)
+      stream_compress_file(input_filename, output_filename, cache);
+    else
+      legacy_compress_file(H, input_filename, output_filename);
+  }
+}
+
+//----------------------------------------------------------------------------
+
 int main(int argc, char **argv)
 {
+  vector <string> filenames;
+  TableCache *cache = NULL;
+  string cache_dir;
+  double cache_penalty = DEFAULT_CACHE_PENALTY;
+  bool cache_flag = false;
+  string daemon_socket;
+  int num_engines = DEFAULT_NUM_ENGINES;
+  bool tune_flag = false, threads_flag = false, tablebits_flag = false, kernels_flag = false;
+  TuneProfile profile;
+  string tuning;
+
   if (argc < 2) {
-    cout << "huffman [-debug | -ascii | -example] <filename>\n";
+    cout << "huffman [-debug | -ascii | -example | -cache <dir> | -penalty <fraction>] <filename> [<filename> ...]\n";
+    cout << "huffman -stream [-block <bytes>] <filename> ...   (block stream format)\n";
+    cout << "huffman [-d] [-block <bytes>] -    (stdin to stdout, block stream format)\n";
+    cout << "huffman -split <level 1-9> [-block <max bytes>] ...   (blocks end where the text changes, block stream format)\n";
+    cout << "huffman -columns [-split <level>] ...   (a code table per column of tab-delimited text, block stream format)\n";
+    cout << "huffman -bwt [-block <bytes>] [-threads <n>] ...   (Burrows-Wheeler + move-to-front ahead of Huffman, block stream format)\n";
+    cout << "huffman -adaptive [-rescale <bits 8-24>] <filename> ... | -   (one pass, no code table; - flushes as input arrives)\n";
+    cout << "huffman -append <file.huf> [-block <bytes>] [-lz <level> | -bwt | -split <level>] [-columns] [<filename> ...]   (add files, or stdin, to the end)\n";
+    cout << "huffman -convert <binary | ascii> <filename.huf> ...   (-ascii <-> binary without decoding, to .bin.huf / .ascii.huf)\n";
+    cout << "huffman [-io <uring | threads>] [-direct] <filename> ...   (how files are read and written; -direct: O_DIRECT for big files)\n";
+    cout << "huffman -lz <level 1-9> [-window <bits 8-20>] ...   (LZ77 + Huffman, block stream format)\n";
+    cout << "huffman -format <huf | stream | deflate | gzip> [-lz <level>] ...   (deflate, gzip: readable by zlib, gzip -d)\n";
+    cout << "huffman -test [-threads <n>] <filename.huf> ...   (check integrity, write nothing)\n";
+    cout << "huffman -search <text> [-threads <n>] <filename.huf> ...   (print line:offset:line text of each match)\n";
+    cout << "huffman -records [-record <i>] <filename> ...   (one record per line, one shared table, random access)\n";
+    cout << "huffman -bench <kernels | stress | records | phases | sync | adaptive> [-kernels <scalar | bmi2 | avx2>] [-threads <n>]\n"
+         << "              [-perf] [-tablebits <n>] [-rescale <bits>] [<filename> ...]   (time the inner loops)\n";
+    cout << "huffman -tune [-profile <file>] [<filename> ...]   (time kernels, table bits, block size, threads on this host;\n"
+         << "              saved to $HUFFMAN_PROFILE or ~/" << TUNE_PROFILE_NAME << " and used by every run)\n";
+    cout << "huffman -daemon <socket> [-engines <n>] [-cache <dir>] [<training file> ...]\n";
     exit(1);
   }
 
@@ -291,27 +656,259 @@ int main(int argc, char **argv)
       example_function();
       exit(1);
     }
+    else if (!strcmp("-cache", argv[i]) && i + 1 < argc) {
+      cache_flag = true;
+      cache_dir = argv[++i];
+    }
+    else if (!strcmp("-penalty", argv[i]) && i + 1 < argc)
+      cache_penalty = atof(argv[++i]);
+    else if (!strcmp("-stream", argv[i]))
+      stream_flag = true;
+    else if (!strcmp("-d", argv[i]))
+      decompress_flag = true;
+    else if (!strcmp("-block", argv[i]) && i + 1 < argc)
+      stream_block_size = atoi(argv[++i]);
+    else if (!strcmp("-lz", argv[i]) && i + 1 < argc)
+      lz_level = atoi(argv[++i]);
+    else if (!strcmp("-convert", argv[i]) && i + 1 < argc) {
+      convert_to = argv[++i];
+      if (convert_to != "binary" && convert_to != "ascii") {
+        cout << "Can only convert to binary or ascii, not " << convert_to << endl;
+        exit(1);
+      }
+    }
+    else if (!strcmp("-append", argv[i]) && i + 1 < argc)
+      append_filename = argv[++i];
+    else if (!strcmp("-io", argv[i]) && i + 1 < argc) {
+      if (!strcmp("uring", argv[++i]))
+        io_mode = IO_URING;
+      else if (!strcmp("threads", argv[i]))
+        io_mode = 0;
+      else {
+        cout << "Unknown -io " << argv[i] << endl;
+        exit(1);
+      }
+    }
+    else if (!strcmp("-columns", argv[i]))
+      columns_flag = true;
+    else if (!strcmp("-bwt", argv[i]))
+      bwt_flag = true;
+    else if (!strcmp("-adaptive", argv[i]))
+      adaptive_flag = true;
+    else if (!strcmp("-rescale", argv[i]) && i + 1 < argc) {
+      rescale_bits = atoi(argv[++i]);
+      if (rescale_bits < ADAPTIVE_MIN_RESCALE_BITS || rescale_bits > ADAPTIVE_MAX_RESCALE_BITS) {
+        cout << "-rescale must be " << ADAPTIVE_MIN_RESCALE_BITS << " to " << ADAPTIVE_MAX_RESCALE_BITS << " bits\n";
+        exit(1);
+      }
+    }
+    else if (!strcmp("-direct", argv[i]))
+      direct_flag = true;
+    else if (!strcmp("-split", argv[i]) && i + 1 < argc)
+      split_level = atoi(argv[++i]);
+    else if (!strcmp("-window", argv[i]) && i + 1 < argc)
+      lz_window_bits = atoi(argv[++i]);
+    else if (!strcmp("-format", argv[i]) && i + 1 < argc) {
+      output_format = argv[++i];
+      if (output_format != "huf" && output_format != "stream" && !deflate_format()) {
+        cout << "Unknown format " << output_format << endl;
+        exit(1);
+      }
+      if (output_format == "stream")
+        stream_flag = true;
+    }
+    else if (!strcmp("-test", argv[i]))
+      test_flag = true;
+    else if (!strcmp("-threads", argv[i]) && i + 1 < argc) {
+      threads_flag = true;
+      num_threads = atoi(argv[++i]);
+    }
+    else if (!strcmp("-search", argv[i]) && i + 1 < argc) {
+      search_flag = true;
+      search_pattern = argv[++i];
+    }
+    else if (!strcmp("-records", argv[i]))
+      records_flag = true;
+    else if (!strcmp("-record", argv[i]) && i + 1 < argc) {
+      records_flag = true;
+      record_index = atoll(argv[++i]);
+    }
+    else if (!strcmp("-bench", argv[i]) && i + 1 < argc)
+      bench_mode = argv[++i];
+    else if (!strcmp("-perf", argv[i]))
+      perf_flag = true;
+    else if (!strcmp("-tablebits", argv[i]) && i + 1 < argc) {
+      tablebits_flag = true;
+      decode_table_bits = max(1, min(MAX_STREAM_CODE_LENGTH, atoi(argv[++i])));
+    }
+    else if (!strcmp("-kernels", argv[i]) && i + 1 < argc) {
+      kernels_flag = true;
+      if (!bitpack_select(argv[++i])) {
+        cout << "Kernels " << argv[i] << " not supported on this machine\n";
+        exit(1);
+      }
+    }
+    else if (!strcmp("-daemon", argv[i]) && i + 1 < argc)
+      daemon_socket = argv[++i];
+    else if (!strcmp("-engines", argv[i]) && i + 1 < argc)
+      num_engines = atoi(argv[++i]);
+    else if (!strcmp("-tune", argv[i]))
+      tune_flag = true;
+    else if (!strcmp("-profile", argv[i]) && i + 1 < argc)
+      profile_filename = argv[++i];
+    else
+      filenames.push_back(argv[i]);
   }
 
-  string input_filename(argv[argc - 1]);
-  string output_filename(argv[argc - 1]);
-  Huffman H;
+  // TUNE!!! time the candidates on this host and save the fastest
 
-  // DECOMPRESS!!! output will end in .HUF
+  if (tune_flag) {
+    tune_host(filenames, profile, cout);
+    if (!profile.save(profile_filename)) {
+      cout << "Failed to write " << profile_filename << endl;
+      exit(1);
+    }
+    cout << "saved to " << profile_filename << endl;
+    return 0;
+  }
 
-  if (input_filename.substr(input_filename.length() - 4, 4) == ".huf") {
-    output_filename.replace(output_filename.length() - 4, 4, ".HUF");
-    H.decompress(input_filename, output_filename, !ascii_flag);
+  // PROFILE!!! what -tune picked for this host, where the command line
+  // doesn't say otherwise
+
+  if (profile.load(profile_filename)) {
+    if (!kernels_flag)
+      bitpack_select(profile.kernels);
+    if (!tablebits_flag)
+      decode_table_bits = profile.decode_table_bits;
+    if (!threads_flag)
+      num_threads = profile.threads;
+    tuned_block_size = profile.block_size;
+
+    // what's really in effect, flags and all
+
+    profile.kernels = bitpack().name;
+    profile.decode_table_bits = decode_table_bits;
+    profile.threads = num_threads;
+    ostringstream description;
+    profile.describe(description);
+    tuning = description.str() + " from " + profile_filename;
+    if (debug_flag)
+      cout << "tuning: " << tuning << endl;
   }
+  DecodeTable::default_bits = decode_table_bits;
 
-  // COMPRESS!!! output will end in .huf
+  // one table cache is shared by every file on the command line
 
-  else {
-    if (input_filename.substr(input_filename.length() - 4, 4) == ".HUF")
-      output_filename.replace(output_filename.length() - 4, 4, ".huf");
-    else
-      output_filename += ".huf";
-    H.compress(input_filename, output_filename, !ascii_flag);
+  if (cache_flag)
+    cache = new TableCache(cache_dir, cache_penalty);
+
+  // TEST!!! decode every file without writing anything
+
+  if (test_flag)
+    return verify_files(filenames, !ascii_flag, num_threads, cout) > 0 ? 1 : 0;
+
+  // SEARCH!!! like grep on the decompressed text, which is never written out;
+  // exit status 0 if anything matched
+
+  if (search_flag)
+    return search_files(filenames, search_pattern, !ascii_flag, num_threads, cout) > 0 ? 0 : 1;
+
+  // BENCHMARK!!! files on the command line are the test data
+
+  if (bench_mode == "kernels")
+    return bench_kernels(filenames, cout) ? 0 : 1;
+  else if (bench_mode == "stress")
+    return bench_stress(filenames, num_threads, cout) ? 0 : 1;
+  else if (bench_mode == "records")
+    return bench_records(filenames, cout) ? 0 : 1;
+  else if (bench_mode == "phases")
+    return bench_phases(filenames, perf_flag, decode_table_bits, cout) ? 0 : 1;
+  else if (bench_mode == "sync")
+    return bench_sync(filenames, num_threads, cout) ? 0 : 1;
+  else if (bench_mode == "adaptive")
+    return bench_adaptive(filenames, rescale_bits, cout) ? 0 : 1;
+  else if (!bench_mode.empty()) {
+    cout << "Unknown benchmark " << bench_mode << endl;
+    exit(1);
+  }
+
+  // CONVERT!!! foo.huf (or foo.ascii.huf / foo.bin.huf) -> foo.bin.huf or foo.ascii.huf
+
+  if (!convert_to.empty()) {
+    for (int i = 0; i < filenames.size(); i++) {
+      string base = filenames[i], message;
+      const char *suffixes[] = { ".huf", ".bin", ".ascii" };
+      for (int j = 0; j < 3; j++)
+        if (base.length() > strlen(suffixes[j]) && base.substr(base.length() - strlen(suffixes[j])) == suffixes[j])
+          base.erase(base.length() - strlen(suffixes[j]));
+      base += convert_to == "binary" ? ".bin.huf" : ".ascii.huf";
+
+      cout << "CONVERTING to " << base << endl;
+      if (!convert_file(filenames[i], base, convert_to == "binary", message)) {
+        cout << "Failed to convert " << filenames[i] << ": " << message << endl;
+        exit(1);
+      }
+    }
+    return 0;
+  }
+
+  // APPEND!!! files on the command line (or stdin) go on the end of the
+  // -append file, in order
+
+  if (!append_filename.empty()) {
+    FileAppender appender;
+    appender.block_size = block_size();
+    appender.lz_level = lz_level;
+    appender.lz_window_bits = lz_window_bits;
+    appender.split_level = split_level;
+    appender.columns = columns_flag;
+    appender.bwt = bwt_flag;
+    appender.num_threads = num_threads;
+
+    if (filenames.empty())
+      filenames.push_back("-");
+
+    for (int i = 0; i < filenames.size(); i++) {
+      ifstream inStream;
+      if (filenames[i] != "-") {
+        inStream.open(filenames[i].c_str(), ios::binary);
+        if (inStream.fail()) {
+          cout << "Failed to open input file " << filenames[i] << endl;
+          exit(1);
+        }
+      }
+      cout << "APPENDING " << filenames[i] << " to " << append_filename << endl;
+      if (!appender.append(append_filename, filenames[i] == "-" ? (istream &) cin : inStream)) {
+        cout << "Failed to append to " << append_filename << ": " << appender.message << endl;
+        exit(1);
+      }
+      if (appender.converted)
+        cout << append_filename << " was an old-style file and has been rewritten as a block stream\n";
+      if (debug_flag)
+        cout << appender.bytes_in << " -> " << appender.bytes_out << " bytes in " << appender.blocks << " blocks, "
+             << appender.reused_tables << " reusing the table before\n";
+    }
+    return 0;
+  }
+
+  // DAEMON!!! files on the command line are only used to warm up the cache
+
+  if (!daemon_socket.empty()) {
+    Daemon D(daemon_socket, num_engines, cache);
+    D.tuning = tuning;
+    D.pretrain(filenames);
+    if (!D.run())
+      exit(1);
+    delete cache;
+    return 0;
+  }
+
+  for (int i = 0; i < filenames.size(); i++)
+    process_file(filenames[i], cache);
+
+  if (cache != NULL) {
+    cache->print_stats(cout);
+    delete cache;
   }
 
   return 1;
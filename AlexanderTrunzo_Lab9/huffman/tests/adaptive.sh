@@ -0,0 +1,47 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -adaptive: one-pass round trips at every rescale, pipes that flush, damage
+#----------------------------------------------------------------------------
+
+for bits in 8 16 24; do
+  roundtrip adaptive$bits medium.txt "-adaptive -rescale $bits"
+  succeeds "-test -adaptive -rescale $bits" "$HUF" -test "$WORK/adaptive$bits.huf"
+done
+for f in small empty one line runs; do
+  roundtrip adaptive_$f $f.txt "-adaptive"
+done
+fails "-rescale out of range" "$HUF" -adaptive -rescale 30 "$WORK/small.txt"
+
+run "$HUF" -adaptive - < "$WORK/medium.txt" > "$WORK/adaptive_pipe.huf" 2> /dev/null
+run "$HUF" -d - < "$WORK/adaptive_pipe.huf" > "$WORK/adaptive_pipe.out" 2> /dev/null
+same "$WORK/medium.txt" "$WORK/adaptive_pipe.out" "-adaptive pipe round trip"
+same "$WORK/adaptive16.huf" "$WORK/adaptive_pipe.huf" "-adaptive pipe and file output"
+
+# a line is readable at the other end of the pipe while the writer is
+# still going
+
+(printf 'hello\n'; sleep 3) | "$HUF" -adaptive - 2> /dev/null | "$HUF" -d - > "$WORK/adaptive_flushed.out" 2> /dev/null &
+sleep 1
+printf 'hello\n' > "$WORK/adaptive_flushed.want"
+same "$WORK/adaptive_flushed.want" "$WORK/adaptive_flushed.out" "-adaptive pipe flushing"
+wait
+
+succeeds "-bench adaptive" "$HUF" -bench adaptive "$WORK/medium.txt"
+
+# damage anywhere, a missing end marker and trailing data are all errors
+
+for offset in 0 5 100 50000; do
+  cp "$WORK/adaptive16.huf" "$WORK/adaptive_bad.huf"
+  flip "$WORK/adaptive_bad.huf" $offset
+  fails "-test -adaptive file with byte $offset changed" "$HUF" -test "$WORK/adaptive_bad.huf"
+  run "$HUF" -d - < "$WORK/adaptive_bad.huf" > /dev/null 2> "$WORK/out.log"
+  said "error" "-adaptive pipe with byte $offset changed"
+done
+
+for n in 4 1000 $(($(size "$WORK/adaptive16.huf") - 1)); do
+  cp "$WORK/adaptive16.huf" "$WORK/adaptive_bad.huf"
+  truncate_to "$WORK/adaptive_bad.huf" $n
+  fails "-test -adaptive file cut to $n bytes" "$HUF" -test "$WORK/adaptive_bad.huf"
+done
+
+fails "-convert ascii of an adaptive file" "$HUF" -convert ascii "$WORK/adaptive16.huf"
@@ -0,0 +1,87 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -append: the file decodes to everything added, in order; bad files left alone
+#----------------------------------------------------------------------------
+
+# append_decodes <name> <expected>: name.huf decompresses to expected
+
+append_decodes()
+{
+  rm -f "$WORK/$1.HUF"
+  (cd "$WORK" && run "$HUF" "$1.huf" > decompress.log 2>&1)
+  same "$WORK/$2" "$WORK/$1.HUF" "$1 after -append"
+  succeeds "-test $1 after -append" "$HUF" -test "$WORK/$1.huf"
+}
+
+cat "$WORK/doi.txt" "$WORK/bts.txt" > "$WORK/append_2.txt"
+cat "$WORK/doi.txt" "$WORK/bts.txt" "$WORK/medium.txt" > "$WORK/append_3.txt"
+
+# a file that isn't there yet is created, then added to twice
+
+rm -f "$WORK/append_new.huf"
+succeeds "-append to a new file" "$HUF" -append "$WORK/append_new.huf" "$WORK/doi.txt"
+succeeds "-append to a block stream" "$HUF" -append "$WORK/append_new.huf" "$WORK/bts.txt"
+succeeds "-append from stdin" sh -c "\"$HUF\" -append \"$WORK/append_new.huf\" < \"$WORK/medium.txt\""
+append_decodes append_new append_3.txt
+
+# an old-style file is rewritten as a block stream once
+
+roundtrip append_legacy doi.txt ""
+succeeds "-append to an old-style file" "$HUF" -append "$WORK/append_legacy.huf" "$WORK/bts.txt"
+said "rewritten as a block stream" "-append to an old-style file"
+append_decodes append_legacy append_2.txt
+
+# every stage can go on the end of a file made with another
+
+for flags in "-lz 5" "-bwt -block 20000" "-split 5" "-columns"; do
+  roundtrip append_stages doi.txt "-stream"
+  succeeds "-append $flags" "$HUF" -append "$WORK/append_stages.huf" $flags "$WORK/bts.txt"
+  append_decodes append_stages append_2.txt
+done
+
+# an empty append changes nothing that decodes
+
+roundtrip append_empty doi.txt "-stream"
+succeeds "-append an empty file" "$HUF" -append "$WORK/append_empty.huf" "$WORK/empty.txt"
+append_decodes append_empty doi.txt
+
+# leftovers of an append that never committed (blocks after the end
+# marker) are written over by the next one
+
+roundtrip append_left doi.txt "-stream"
+head -c 5000 "$WORK/medium.txt" >> "$WORK/append_left.huf"
+append_decodes append_left doi.txt
+said "5000 bytes of an unfinished -append" "-test with leftovers"
+succeeds "-search with leftovers" "$HUF" -search "liberty" "$WORK/append_left.huf"
+succeeds "-append over leftovers" "$HUF" -append "$WORK/append_left.huf" "$WORK/bts.txt"
+append_decodes append_left append_2.txt
+
+# the same with real blocks: an append that was stopped just before its
+# commit byte (the old end marker) was written
+
+roundtrip append_uncommitted doi.txt "-stream"
+end=$(($(size "$WORK/append_uncommitted.huf") - 1))
+succeeds "-append to uncommit" "$HUF" -append "$WORK/append_uncommitted.huf" "$WORK/bts.txt"
+printf '\0' | dd of="$WORK/append_uncommitted.huf" bs=1 seek=$end conv=notrunc 2> /dev/null
+append_decodes append_uncommitted doi.txt
+said "bytes of an unfinished -append" "-test with an uncommitted append"
+succeeds "-search with an uncommitted append" "$HUF" -search "liberty" "$WORK/append_uncommitted.huf"
+succeeds "-append after an uncommitted one" "$HUF" -append "$WORK/append_uncommitted.huf" "$WORK/bts.txt"
+append_decodes append_uncommitted append_2.txt
+
+# files it can't add to are refused and left as they were
+
+roundtrip append_adaptive doi.txt "-adaptive"
+roundtrip append_ascii doi.txt "-ascii" "-ascii"
+head -c 20000 /dev/urandom > "$WORK/append_garbage.huf"
+for f in append_adaptive append_ascii append_garbage; do
+  cp "$WORK/$f.huf" "$WORK/$f.before"
+  fails "-append to $f" "$HUF" -append "$WORK/$f.huf" "$WORK/bts.txt"
+  same "$WORK/$f.before" "$WORK/$f.huf" "$f after a refused -append"
+done
+
+cp "$WORK/append_new.huf" "$WORK/append_bad.huf"
+flip "$WORK/append_bad.huf" 9
+cp "$WORK/append_bad.huf" "$WORK/append_bad.before"
+fails "-append to a damaged block stream" "$HUF" -append "$WORK/append_bad.huf" "$WORK/bts.txt"
+same "$WORK/append_bad.before" "$WORK/append_bad.huf" "damaged block stream after a refused -append"
@@ -0,0 +1,42 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -bwt: round trips of small, repetitive and odd blocks, on any thread count
+#----------------------------------------------------------------------------
+
+printf 'aaaaaaaaaa' > "$WORK/bwt_repeat.txt"
+printf 'abababababab' > "$WORK/bwt_period.txt"
+
+for f in bwt_repeat bwt_period one empty line runs small; do
+  roundtrip bwt_$f $f.txt "-bwt"
+  roundtrip bwt_tiny_$f $f.txt "-bwt -block 7"
+done
+roundtrip bwt_blocks medium.txt "-bwt -block 5000 -threads 1"
+roundtrip bwt_blocks_3 medium.txt "-bwt -block 5000 -threads 3" "-threads 3"
+same "$WORK/bwt_blocks.huf" "$WORK/bwt_blocks_3.huf" "-bwt output with 1 and 3 threads"
+roundtrip bwt_medium medium.txt "-bwt"
+succeeds "-test -bwt" "$HUF" -test -threads 4 "$WORK/bwt_blocks.huf"
+
+run "$HUF" -bwt -block 20000 - < "$WORK/medium.txt" > "$WORK/bwt_pipe.huf" 2> /dev/null
+run "$HUF" -d - < "$WORK/bwt_pipe.huf" > "$WORK/bwt_pipe.out" 2> /dev/null
+same "$WORK/medium.txt" "$WORK/bwt_pipe.out" "-bwt pipe round trip"
+
+# whole-file context has to beat plain blocks on english
+
+roundtrip bwt_plain medium.txt "-stream"
+if [ $(size "$WORK/bwt_medium.huf") -lt $(size "$WORK/bwt_plain.huf") ]; then ok; else bad "-bwt no smaller than -stream"; fi
+
+# a bad primary index, run, or code anywhere is caught, on one thread
+# or several
+
+for offset in 6 12 20 40 2000 60000; do
+  cp "$WORK/bwt_medium.huf" "$WORK/bwt_bad.huf"
+  flip "$WORK/bwt_bad.huf" $offset
+  fails "-test -bwt file with byte $offset changed" "$HUF" -test "$WORK/bwt_bad.huf"
+  cp "$WORK/bwt_blocks.huf" "$WORK/bwt_bad.huf"
+  flip "$WORK/bwt_bad.huf" $offset
+  fails "-test -bwt small blocks with byte $offset changed" "$HUF" -test -threads 3 "$WORK/bwt_bad.huf"
+done
+
+cp "$WORK/bwt_medium.huf" "$WORK/bwt_bad.huf"
+truncate_to "$WORK/bwt_bad.huf" 30000
+fails "-test -bwt file cut short" "$HUF" -test "$WORK/bwt_bad.huf"
@@ -0,0 +1,25 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -cache: tables reused across files and runs, and damaged cache entries
+#----------------------------------------------------------------------------
+
+mkdir "$WORK/tables"
+
+roundtrip cache_first small.txt "-cache $WORK/tables"
+said "1 stored" "first file fills the cache"
+roundtrip cache_again small.txt "-cache $WORK/tables"
+said "1 hits" "second run finds the table on disk"
+roundtrip cache_long greatexp.txt "-cache $WORK/tables"
+
+# a table the fingerprint lands on but that is not a prefix code, and one
+# that isn't a table at all, must not end up in a .huf file
+
+for tbl in "$WORK"/tables/*.tbl; do
+  awk 'NR == 1 { print; next } { print $1, 1 }' "$tbl" > "$tbl.bad" && mv "$tbl.bad" "$tbl"
+done
+roundtrip cache_overfull small.txt "-cache $WORK/tables"
+
+for tbl in "$WORK"/tables/*.tbl; do
+  printf 'not a table\n' > "$tbl"
+done
+roundtrip cache_junk small.txt "-cache $WORK/tables"
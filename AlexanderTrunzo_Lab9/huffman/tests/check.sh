@@ -0,0 +1,141 @@
+#!/bin/sh
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# make check: round trips and damaged inputs for every mode
+#----------------------------------------------------------------------------
+
+# run from the directory holding the binaries, as "make check" does.
+# each tests/<name>.sh is sourced in turn and uses the helpers below;
+# everything is done in a scratch directory that is removed at the end
+# (kept if KEEP is set).
+# prints each failure and a count, and exits 1 if anything failed
+
+TOP=$(pwd)
+HUF=$TOP/huffman
+CLIENT=$TOP/huffclient
+LOAD=$TOP/huffload
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/huffcheck.XXXXXX") || exit 1
+
+# a -tune profile left on this host mustn't change what's tested
+
+HUFFMAN_PROFILE=$WORK/no_such_profile
+export HUFFMAN_PROFILE
+
+TESTS="cache daemon stream verify lz deflate kernels search codebook records perf split sync append convert io tune columns bwt adaptive"
+
+passed=0
+failed=0
+
+#----------------------------------------------------------------------------
+
+ok()
+{
+  passed=$((passed + 1))
+}
+
+bad()
+{
+  echo "FAIL [$test]: $*"
+  failed=$((failed + 1))
+}
+
+# every command gets a time limit, so a decoder that spins on bad input
+# is a failure rather than a hung "make check"
+
+run()
+{
+  timeout 120 "$@"
+}
+
+# expect a command to succeed, or to fail (for the modes whose exit
+# status means something)
+
+succeeds()
+{
+  desc=$1
+  shift
+  if run "$@" > "$WORK/out.log" 2>&1; then ok; else bad "$desc"; fi
+}
+
+fails()
+{
+  desc=$1
+  shift
+  if run "$@" > "$WORK/out.log" 2>&1; then bad "$desc (should have failed)"; else ok; fi
+}
+
+same()
+{
+  if cmp -s "$1" "$2"; then ok; else bad "$3: $(basename "$1") and $(basename "$2") differ"; fi
+}
+
+# the last command's output has to mention a string
+
+said()
+{
+  if grep -q -e "$1" "$WORK/out.log"; then ok; else bad "$2: no \"$1\" in output"; fi
+}
+
+# roundtrip <name> <input> "<compress flags>" ["<decompress flags>"]
+# compresses a copy of input (in $WORK) as name, decompresses name.huf to
+# name.HUF and compares.  leaves name.huf behind for more checks, and the
+# compressor's output in out.log
+
+roundtrip()
+{
+  rt_name=$1
+  rt_in=$WORK/$2
+  cp "$rt_in" "$WORK/$rt_name"
+  rm -f "$WORK/$rt_name.huf" "$WORK/$rt_name.HUF"
+  (cd "$WORK" && run "$HUF" $3 "$rt_name" > out.log 2>&1)
+  (cd "$WORK" && run "$HUF" $4 "$rt_name.huf" > decompress.log 2>&1)
+  if [ ! -f "$WORK/$rt_name.huf" ]; then
+    bad "$rt_name: $3 wrote nothing"
+  else
+    same "$rt_in" "$WORK/$rt_name.HUF" "$rt_name round trip ($3)"
+  fi
+}
+
+# damage a file in place: flip the bits of the byte at an offset, or cut
+# it short
+
+flip()
+{
+  v=$(od -An -tu1 -j "$2" -N1 "$1" | tr -d ' ')
+  printf "\\$(printf %o $((v ^ 0x5a)))" | dd of="$1" bs=1 seek="$2" conv=notrunc 2> /dev/null
+}
+
+truncate_to()
+{
+  head -c "$2" "$1" > "$1.cut" && mv "$1.cut" "$1"
+}
+
+size()
+{
+  wc -c < "$1" | tr -d ' '
+}
+
+#----------------------------------------------------------------------------
+
+# inputs.  the coder drops chars other than tab, newline and printing
+# ascii, so text that round-trips is kept to those
+
+for f in cleaned_doi.txt cleaned_bts.txt cleaned_greatexp.txt; do
+  LC_ALL=C tr -cd '\11\12\40-\176' < "$TOP/$f" > "$WORK/${f#cleaned_}"
+done
+
+cat "$WORK/doi.txt" "$WORK/bts.txt" > "$WORK/small.txt"
+head -c 300000 "$WORK/greatexp.txt" > "$WORK/medium.txt"
+: > "$WORK/empty.txt"
+printf 'a' > "$WORK/one.txt"
+printf 'abc\n' > "$WORK/line.txt"
+awk 'BEGIN { for (i = 0; i < 20000; i++) printf "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\n" }' > "$WORK/runs.txt"
+
+for test in $TESTS; do
+  . "$TOP/tests/$test.sh"
+done
+
+[ -n "$KEEP" ] || rm -rf "$WORK"
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]
@@ -0,0 +1,19 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# shared CodeBooks: many threads decoding with one table get the same chars
+#----------------------------------------------------------------------------
+
+succeeds "-bench stress" "$HUF" -bench stress -threads 4 "$WORK/small.txt"
+said "speedup" "-bench stress"
+
+# blocks decoded on several threads at once, by -test, -search and a
+# plain decompress, agree with one thread
+
+roundtrip codebook_1 medium.txt "-stream -block 4096 -threads 1" "-threads 1"
+roundtrip codebook_4 medium.txt "-stream -block 4096 -threads 4" "-threads 4"
+same "$WORK/codebook_1.huf" "$WORK/codebook_4.huf" "-stream output with 1 and 4 threads"
+succeeds "-test on 8 threads" "$HUF" -test -threads 8 "$WORK/codebook_4.huf"
+
+cp "$WORK/codebook_4.huf" "$WORK/codebook_bad.huf"
+flip "$WORK/codebook_bad.huf" 40000
+fails "-test on 8 threads, damaged block" "$HUF" -test -threads 8 "$WORK/codebook_bad.huf"
@@ -0,0 +1,60 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -columns: tab-delimited text, ragged or not, round-trips and pays off
+#----------------------------------------------------------------------------
+
+awk 'BEGIN { srand(3); for (i = 0; i < 30000; i++) printf "%d\t%s\t%.3f\t/index/%d\n", i, i % 3 ? "GET" : "POST", rand() * 100, int(rand() * 50) }' > "$WORK/columns.tsv"
+printf 'a\tb\tc\nd\ne\tf\tg\th\ti\n\t\t\n\n' > "$WORK/columns_ragged.tsv"
+printf 'a\tb' > "$WORK/columns_no_newline.tsv"
+
+for f in columns.tsv columns_ragged.tsv columns_no_newline.tsv small.txt empty.txt one.txt; do
+  roundtrip columns_${f%.*} $f "-columns"
+  roundtrip columns_split_${f%.*} $f "-columns -split 5"
+done
+roundtrip columns_blocks columns.tsv "-columns -block 3000"
+roundtrip columns_lz columns.tsv "-columns -lz 5"
+succeeds "-test -columns" "$HUF" -test -threads 4 "$WORK/columns_blocks.huf"
+
+run "$HUF" -columns - < "$WORK/columns.tsv" > "$WORK/columns_pipe.huf" 2> /dev/null
+run "$HUF" -d - < "$WORK/columns_pipe.huf" > "$WORK/columns_pipe.out" 2> /dev/null
+same "$WORK/columns.tsv" "$WORK/columns_pipe.out" "-columns pipe round trip"
+
+# a table per column has to beat one table for the whole row
+
+roundtrip columns_plain columns.tsv "-stream"
+if [ $(size "$WORK/columns_columns.huf") -lt $(size "$WORK/columns_plain.huf") ]; then ok; else bad "-columns no smaller than -stream"; fi
+
+for offset in 12 200 100000; do
+  cp "$WORK/columns_columns.huf" "$WORK/columns_bad.huf"
+  flip "$WORK/columns_bad.huf" $offset
+  fails "-test -columns file with byte $offset changed" "$HUF" -test "$WORK/columns_bad.huf"
+done
+
+cp "$WORK/columns_columns.huf" "$WORK/columns_bad.huf"
+truncate_to "$WORK/columns_bad.huf" 50000
+fails "-test -columns file cut short" "$HUF" -test "$WORK/columns_bad.huf"
+
+# crafted headers straight into the decoder: a table count too big for
+# its block type has to be refused before the table is read, whatever
+# the tables after it hold.  the first is 8 column tables, the first
+# claiming 144 entries, then 7 full ones
+
+columns_crafted()
+{
+  { printf '\360HUF'; printf "$2"; head -c $3 /dev/zero; } > "$WORK/columns_crafted.huf"
+  i=0
+  while [ $i -lt $4 ]; do
+    { printf '\200'; head -c 256 /dev/zero; } >> "$WORK/columns_crafted.huf"
+    i=$((i + 1))
+  done
+  run "$HUF" -d - < "$WORK/columns_crafted.huf" > /dev/null 2> "$WORK/out.log"
+  said "error" "-d - on $1"
+  fails "-test on $1" "$HUF" -test "$WORK/columns_crafted.huf"
+}
+
+columns_crafted "8 column tables, the first too big" '\6\0\0\0\0\0\0\0\0\0\0\0\0\10\0\220' 288 7
+columns_crafted "9 column tables" '\6\0\0\0\0\0\0\0\0\0\0\0\0\11\0\200' 256 8
+columns_crafted "no column tables" '\6\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0' 0 0
+columns_crafted "a plain block with 129 symbols" '\2\0\0\0\0\0\0\0\0\0\0\0\0\201' 258 0
+columns_crafted "a bwt block with 130 symbols" '\7\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\202' 260 0
+columns_crafted "an lz block with 145 symbols" '\3\0\0\0\0\0\0\0\0\0\0\0\0\221' 290 0
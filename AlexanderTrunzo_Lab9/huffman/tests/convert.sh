@@ -0,0 +1,42 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -convert: binary <-> -ascii gives what compressing that way would have
+#----------------------------------------------------------------------------
+
+for f in small one empty runs; do
+  roundtrip convert_$f $f.txt ""
+  roundtrip convert_ascii_$f $f.txt "-ascii" "-ascii"
+  succeeds "-convert ascii $f" "$HUF" -convert ascii "$WORK/convert_$f.huf"
+  same "$WORK/convert_ascii_$f.huf" "$WORK/convert_$f.ascii.huf" "-convert ascii of $f"
+  succeeds "-convert binary $f" "$HUF" -convert binary "$WORK/convert_ascii_$f.huf"
+  same "$WORK/convert_$f.huf" "$WORK/convert_ascii_$f.bin.huf" "-convert binary of $f"
+done
+
+# and back again, through both suffixes
+
+succeeds "-convert binary of a converted file" "$HUF" -convert binary "$WORK/convert_small.ascii.huf"
+same "$WORK/convert_small.huf" "$WORK/convert_small.bin.huf" "-convert there and back"
+succeeds "-test a converted file" "$HUF" -test "$WORK/convert_small.bin.huf"
+
+# anything but '0' and '1' after an -ascii header, and files with no
+# -ascii form, are refused
+
+cp "$WORK/convert_ascii_small.huf" "$WORK/convert_bad.huf"
+printf '2' >> "$WORK/convert_bad.huf"
+fails "-convert binary with a bad bit" "$HUF" -convert binary "$WORK/convert_bad.huf"
+said "isn't '0' or '1'" "-convert binary with a bad bit"
+
+cp "$WORK/convert_ascii_small.huf" "$WORK/convert_bad.huf"
+truncate_to "$WORK/convert_bad.huf" 10
+fails "-convert binary cut short" "$HUF" -convert binary "$WORK/convert_bad.huf"
+
+cp "$WORK/convert_small.huf" "$WORK/convert_bad.huf"
+truncate_to "$WORK/convert_bad.huf" 10
+fails "-convert ascii cut short" "$HUF" -convert ascii "$WORK/convert_bad.huf"
+
+roundtrip convert_stream small.txt "-stream"
+roundtrip convert_adaptive small.txt "-adaptive"
+fails "-convert ascii of a block stream" "$HUF" -convert ascii "$WORK/convert_stream.huf"
+fails "-convert ascii of an adaptive file" "$HUF" -convert ascii "$WORK/convert_adaptive.huf"
+fails "-convert binary of an adaptive file" "$HUF" -convert binary "$WORK/convert_adaptive.huf"
+fails "-convert to something else" "$HUF" -convert hex "$WORK/convert_small.huf"
@@ -0,0 +1,105 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -daemon: requests through huffclient and huffload, bad payloads, shutdown
+#----------------------------------------------------------------------------
+
+sock=$WORK/daemon.sock
+"$HUF" -daemon "$sock" -engines 2 > "$WORK/daemon.log" 2>&1 &
+daemon_pid=$!
+
+i=0
+while [ ! -S "$sock" ] && [ $i -lt 100 ]; do
+  sleep 0.1
+  i=$((i + 1))
+done
+
+# round trips, both formats, and files compressed by huffman itself
+
+succeeds "client compress" "$CLIENT" "$sock" -c "$WORK/small.txt" "$WORK/daemon.huf"
+succeeds "client decompress" "$CLIENT" "$sock" -d "$WORK/daemon.huf" "$WORK/daemon.out"
+same "$WORK/small.txt" "$WORK/daemon.out" "daemon round trip"
+
+succeeds "client -ascii compress" "$CLIENT" "$sock" -ascii -c "$WORK/small.txt" "$WORK/daemon_ascii.huf"
+succeeds "client -ascii decompress" "$CLIENT" "$sock" -ascii -d "$WORK/daemon_ascii.huf" "$WORK/daemon_ascii.out"
+same "$WORK/small.txt" "$WORK/daemon_ascii.out" "daemon -ascii round trip"
+
+cp "$WORK/daemon.huf" "$WORK/daemon_local.huf"
+(cd "$WORK" && run "$HUF" daemon_local.huf > /dev/null 2>&1)
+same "$WORK/small.txt" "$WORK/daemon_local.HUF" "daemon output decoded by huffman"
+
+for flags in "-stream" "-lz 5" "-adaptive"; do
+  cp "$WORK/medium.txt" "$WORK/daemon_file"
+  (cd "$WORK" && run "$HUF" $flags daemon_file > /dev/null 2>&1)
+  succeeds "client decompress of $flags file" "$CLIENT" "$sock" -d "$WORK/daemon_file.huf" "$WORK/daemon_file.out"
+  same "$WORK/medium.txt" "$WORK/daemon_file.out" "daemon decode of $flags file"
+done
+
+# bad payloads get an error reply, quickly, and the daemon keeps serving
+
+head -c 5000 /dev/urandom > "$WORK/daemon_junk"
+fails "random bytes" "$CLIENT" "$sock" -d "$WORK/daemon_junk" "$WORK/daemon_bad.out"
+said "bad payload" "random bytes"
+fails "-ascii file sent as binary" "$CLIENT" "$sock" -d "$WORK/daemon_ascii.huf" "$WORK/daemon_bad.out"
+fails "binary file sent as -ascii" "$CLIENT" "$sock" -ascii -d "$WORK/daemon.huf" "$WORK/daemon_bad.out"
+head -c 3000 "$WORK/daemon_file.huf" > "$WORK/daemon_cut.huf"
+fails "truncated file" "$CLIENT" "$sock" -d "$WORK/daemon_cut.huf" "$WORK/daemon_bad.out"
+cp "$WORK/medium.txt" "$WORK/daemon_flipped"
+(cd "$WORK" && run "$HUF" -stream daemon_flipped > /dev/null 2>&1)
+flip "$WORK/daemon_flipped.huf" 2000
+fails "damaged payload" "$CLIENT" "$sock" -d "$WORK/daemon_flipped.huf" "$WORK/daemon_bad.out"
+
+succeeds "decompress after bad requests" "$CLIENT" "$sock" -d "$WORK/daemon.huf" "$WORK/daemon.out"
+same "$WORK/small.txt" "$WORK/daemon.out" "daemon round trip after bad requests"
+
+# more connections than engines all get served
+
+succeeds "huffload" "$LOAD" "$sock" "$WORK/doi.txt" -n 60 -c 6
+said " 0 failures" "huffload with more connections than engines"
+
+# clients that send -ascii compress requests (replies several times
+# their size) and never read the replies are dropped after
+# DAEMON_IO_TIMEOUT_SECONDS, so they can't keep both engines.  needs
+# python3 for a client that doesn't read
+
+if command -v python3 > /dev/null 2>&1; then
+  stalled=""
+  for c in 1 2; do
+    python3 -c '
+import socket, struct, sys, time
+s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+s.connect(sys.argv[1])
+text = open(sys.argv[2], "rb").read()
+for i in range(8):
+    s.sendall(struct.pack("<BBI", ord("C"), 1, len(text)) + text)
+time.sleep(120)
+' "$sock" "$WORK/small.txt" > /dev/null 2>&1 &
+    stalled="$stalled $!"
+  done
+  sleep 1
+  if timeout 30 "$CLIENT" "$sock" -c "$WORK/doi.txt" "$WORK/daemon_stalled.huf" > "$WORK/out.log" 2>&1; then
+    ok
+  else
+    bad "request while clients don't read their replies"
+  fi
+  kill $stalled 2> /dev/null
+  wait $stalled 2> /dev/null
+fi
+
+succeeds "stats" "$CLIENT" "$sock" -stats
+said "decompress: " "stats reply"
+
+# SIGTERM stops it promptly
+
+kill -TERM $daemon_pid
+i=0
+while kill -0 $daemon_pid 2> /dev/null && [ $i -lt 100 ]; do
+  sleep 0.1
+  i=$((i + 1))
+done
+if kill -0 $daemon_pid 2> /dev/null; then
+  bad "daemon still running 10s after SIGTERM"
+  kill -9 $daemon_pid
+else
+  ok
+fi
+wait $daemon_pid 2> /dev/null
@@ -0,0 +1,37 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -format gzip / deflate: output checked with gzip itself
+#----------------------------------------------------------------------------
+
+# there's no decoder here for these formats, so gzip is the judge
+
+if command -v gzip > /dev/null; then
+
+  for f in small medium empty one runs; do
+    for flags in "-format gzip" "-format gzip -lz 1" "-format gzip -lz 9"; do
+      cp "$WORK/$f.txt" "$WORK/gz_$f"
+      (cd "$WORK" && run "$HUF" $flags gz_$f > /dev/null 2>&1)
+      run gzip -dc "$WORK/gz_$f.gz" > "$WORK/gz_$f.out" 2> /dev/null
+      same "$WORK/$f.txt" "$WORK/gz_$f.out" "gzip -d of $flags output"
+    done
+  done
+
+  # raw deflate is the gzip member without its 10-byte header and 8-byte
+  # trailer
+
+  cp "$WORK/medium.txt" "$WORK/raw"
+  (cd "$WORK" && run "$HUF" -format deflate -lz 9 raw > /dev/null 2>&1)
+  cp "$WORK/medium.txt" "$WORK/raw_gz"
+  (cd "$WORK" && run "$HUF" -format gzip -lz 9 raw_gz > /dev/null 2>&1)
+  tail -c +11 "$WORK/raw_gz.gz" | head -c $(($(size "$WORK/raw_gz.gz") - 18)) > "$WORK/raw_gz.body"
+  same "$WORK/raw.deflate" "$WORK/raw_gz.body" "-format deflate"
+
+  # gzip has to notice damage: our CRC-32 and length must be real
+
+  for offset in 5000 $(($(size "$WORK/raw_gz.gz") - 6)); do
+    cp "$WORK/raw_gz.gz" "$WORK/gz_bad.gz"
+    flip "$WORK/gz_bad.gz" $offset
+    fails "gzip -t of a changed byte at $offset" gzip -t "$WORK/gz_bad.gz"
+  done
+
+fi
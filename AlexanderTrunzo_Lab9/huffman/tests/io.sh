@@ -0,0 +1,46 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -io and -direct: every way of reading and writing gives the same files
+#----------------------------------------------------------------------------
+
+for io in uring threads; do
+  roundtrip io_$io medium.txt "-io $io" "-io $io"
+  roundtrip io_stream_$io medium.txt "-io $io -stream -block 4096" "-io $io"
+  roundtrip io_lz_$io medium.txt "-io $io -lz 5" "-io $io"
+  roundtrip io_adaptive_$io medium.txt "-io $io -adaptive" "-io $io"
+  roundtrip io_empty_$io empty.txt "-io $io -stream" "-io $io"
+  same "$WORK/io_uring.huf" "$WORK/io_$io.huf" "-io $io output"
+  same "$WORK/io_stream_uring.huf" "$WORK/io_stream_$io.huf" "-io $io -stream output"
+done
+
+# O_DIRECT is only used from IO_DIRECT_MIN_BYTES (256 MB) up, so this
+# one is big, and an odd length so the last write isn't whole sectors
+
+cp "$WORK/greatexp.txt" "$WORK/io_big.txt"
+while [ $(size "$WORK/io_big.txt") -lt 270000001 ]; do
+  cat "$WORK/io_big.txt" "$WORK/io_big.txt" > "$WORK/io_big.2" && mv "$WORK/io_big.2" "$WORK/io_big.txt" || break
+done
+head -c 270000001 "$WORK/io_big.txt" > "$WORK/io_big.2" && mv "$WORK/io_big.2" "$WORK/io_big.txt"
+if [ $(size "$WORK/io_big.txt") -eq 270000001 ]; then
+  for io in uring threads; do
+    roundtrip io_direct_$io io_big.txt "-io $io -direct -stream" "-io $io -direct"
+    rm -f "$WORK/io_direct_$io" "$WORK/io_direct_$io.HUF"
+  done
+  same "$WORK/io_direct_uring.huf" "$WORK/io_direct_threads.huf" "-direct output"
+  rm -f "$WORK/io_big.txt" "$WORK"/io_direct_*
+else
+  bad "couldn't write a 270 MB file for -direct"
+fi
+
+roundtrip io_direct_small small.txt "-direct" "-direct"
+
+fails "unknown -io" "$HUF" -io mmap "$WORK/small.txt"
+
+# a damaged file is as much an error read one way as the other
+
+cp "$WORK/io_stream_uring.huf" "$WORK/io_bad.huf"
+flip "$WORK/io_bad.huf" 5000
+for io in uring threads; do
+  run "$HUF" -io $io "$WORK/io_bad.huf" > "$WORK/out.log" 2>&1
+  said "Failed to decompress" "-io $io, damaged file"
+done
@@ -0,0 +1,19 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -kernels: every bit packing kernel this host runs gives the same files
+#----------------------------------------------------------------------------
+
+for k in scalar bmi2 avx2; do
+  if "$HUF" -kernels $k 2>&1 | grep -q "not supported"; then
+    continue
+  fi
+  roundtrip kernels_$k medium.txt "-kernels $k" "-kernels $k"
+  roundtrip kernels_ascii_$k small.txt "-kernels $k -ascii" "-kernels $k -ascii"
+  roundtrip kernels_stream_$k medium.txt "-kernels $k -stream" "-kernels $k"
+  roundtrip kernels_odd_$k one.txt "-kernels $k" "-kernels $k"
+  same "$WORK/kernels_scalar.huf" "$WORK/kernels_$k.huf" "$k kernel output"
+  same "$WORK/kernels_ascii_scalar.huf" "$WORK/kernels_ascii_$k.huf" "$k kernel -ascii output"
+done
+
+succeeds "-bench kernels" "$HUF" -bench kernels "$WORK/small.txt"
+fails "unknown kernel" "$HUF" -kernels no_such_kernel "$WORK/small.txt"
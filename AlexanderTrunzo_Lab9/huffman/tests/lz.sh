@@ -0,0 +1,28 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -lz: round trips at every level and window, and damaged LZ blocks
+#----------------------------------------------------------------------------
+
+for level in 1 5 9; do
+  roundtrip lz$level medium.txt "-lz $level"
+done
+for f in empty one line runs; do
+  roundtrip lz_$f $f.txt "-lz 5"
+done
+roundtrip lz_small_window medium.txt "-lz 9 -window 8"
+roundtrip lz_big_window medium.txt "-lz 9 -window 20 -block 65536"
+
+run "$HUF" -lz 5 - < "$WORK/medium.txt" > "$WORK/lz_pipe.huf" 2> /dev/null
+run "$HUF" -d - < "$WORK/lz_pipe.huf" > "$WORK/lz_pipe.out" 2> /dev/null
+same "$WORK/medium.txt" "$WORK/lz_pipe.out" "-lz pipe round trip"
+
+# matches have to pay for themselves on repetitive text
+
+roundtrip lz_plain runs.txt "-stream"
+if [ $(size "$WORK/lz_runs.huf") -lt $(($(size "$WORK/lz_plain.huf") / 10)) ]; then ok; else bad "-lz doesn't shrink runs"; fi
+
+for offset in 30 500 20000; do
+  cp "$WORK/lz9.huf" "$WORK/lz_bad.huf"
+  flip "$WORK/lz_bad.huf" $offset
+  fails "-test -lz file with byte $offset changed" "$HUF" -test "$WORK/lz_bad.huf"
+done
@@ -0,0 +1,16 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -bench phases: runs with or without hardware counters, and decodes right
+#----------------------------------------------------------------------------
+
+# each run checks its own decode against the input and fails on a
+# mismatch.  -perf has to work (by leaving the counters out) on hosts
+# without them, e.g. a VM with no virtual PMU
+
+succeeds "-bench phases" "$HUF" -bench phases "$WORK/doi.txt"
+said "decode" "-bench phases"
+succeeds "-bench phases -perf" "$HUF" -bench phases -perf "$WORK/doi.txt"
+said "decode" "-bench phases -perf"
+succeeds "-bench phases, 4-bit table" "$HUF" -bench phases -tablebits 4 "$WORK/doi.txt"
+succeeds "-bench phases, 16-bit table" "$HUF" -bench phases -tablebits 16 "$WORK/doi.txt"
+fails "-bench phases, no input" "$HUF" -bench phases "$WORK/no_such_file"
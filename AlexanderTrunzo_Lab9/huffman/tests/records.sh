@@ -0,0 +1,55 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -records: lines back exactly, random access, damaged batches
+#----------------------------------------------------------------------------
+
+# records_roundtrip <name>: name is already in $WORK
+
+records_roundtrip()
+{
+  rm -f "$WORK/$1.rec" "$WORK/$1.REC"
+  (cd "$WORK" && run "$HUF" -records "$1" > /dev/null 2>&1)
+  (cd "$WORK" && run "$HUF" -records "$1.rec" > /dev/null 2>&1)
+  same "$WORK/$1" "$WORK/$1.REC" "-records round trip of $1"
+}
+
+for f in small empty one line runs; do
+  cp "$WORK/$f.txt" "$WORK/records_$f"
+  records_roundtrip records_$f
+done
+
+# no newline at the end, blank lines, and bytes the .huf coders drop
+
+printf 'a\nb' > "$WORK/records_no_newline"
+printf '\n\n\nx\n\n' > "$WORK/records_blank"
+head -c 100000 /dev/urandom > "$WORK/records_binary"
+for f in records_no_newline records_blank records_binary; do
+  records_roundtrip $f
+done
+
+# random access: record i is line i + 1
+
+for i in 0 7 500 1499; do
+  run "$HUF" -record $i "$WORK/records_small.rec" > "$WORK/records.got" 2> /dev/null
+  sed -n "$((i + 1))p" "$WORK/small.txt" > "$WORK/records.want"
+  same "$WORK/records.want" "$WORK/records.got" "-record $i"
+done
+run "$HUF" -record 99999999 "$WORK/records_small.rec" > "$WORK/out.log" 2>&1
+said "no record" "-record past the end"
+
+succeeds "-bench records" "$HUF" -bench records "$WORK/small.txt"
+
+# a batch whose header, offsets or payload are damaged is refused, not
+# decoded into something else
+
+for n in 0 9 12 100; do
+  cp "$WORK/records_small.rec" "$WORK/records_bad.rec"
+  truncate_to "$WORK/records_bad.rec" $n
+  run "$HUF" -records "$WORK/records_bad.rec" > "$WORK/out.log" 2>&1
+  said "records_bad.rec: " "batch cut to $n bytes"
+done
+
+cp "$WORK/records_small.rec" "$WORK/records_bad.rec"
+flip "$WORK/records_bad.rec" 0
+run "$HUF" -records "$WORK/records_bad.rec" > "$WORK/out.log" 2>&1
+said "not a record batch" "batch with a bad magic"
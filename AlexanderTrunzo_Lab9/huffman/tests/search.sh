@@ -0,0 +1,38 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -search: matches in every format agree with grep on the plain text
+#----------------------------------------------------------------------------
+
+# offsets of every match, as grep -b -o sees them and as -search does
+
+search_agrees()
+{
+  LC_ALL=C grep -b -o -F -e "$2" "$WORK/medium.txt" | cut -d: -f1 > "$WORK/search.want"
+  [ -s "$WORK/search.want" ] || bad "\"$2\" isn't in the test text"
+  run "$HUF" -search "$2" $3 "$WORK/$1" 2> /dev/null | cut -d: -f2 > "$WORK/search.got"
+  same "$WORK/search.want" "$WORK/search.got" "-search \"$2\" in $1"
+}
+
+roundtrip search_legacy medium.txt ""
+roundtrip search_ascii medium.txt "-ascii" "-ascii"
+roundtrip search_stream medium.txt "-stream -block 5000"
+roundtrip search_lz medium.txt "-lz 5 -block 20000"
+roundtrip search_bwt medium.txt "-bwt -block 30000"
+roundtrip search_adaptive medium.txt "-adaptive"
+
+for pattern in "pip" "miss havisham" "the" "said joe" "e"; do
+  search_agrees search_legacy.huf "$pattern"
+  search_agrees search_ascii.huf "$pattern" -ascii
+  search_agrees search_stream.huf "$pattern" "-threads 3"
+  search_agrees search_lz.huf "$pattern"
+  search_agrees search_bwt.huf "$pattern"
+  search_agrees search_adaptive.huf "$pattern"
+done
+
+succeeds "-search with matches" "$HUF" -search "havisham" "$WORK/search_stream.huf"
+fails "-search with no matches" "$HUF" -search "no such text anywhere" "$WORK/search_stream.huf"
+
+cp "$WORK/search_stream.huf" "$WORK/search_bad.huf"
+flip "$WORK/search_bad.huf" 30000
+run "$HUF" -search "pip" "$WORK/search_bad.huf" > "$WORK/out.log" 2>&1
+said "search_bad.huf: block" "-search in a damaged file"
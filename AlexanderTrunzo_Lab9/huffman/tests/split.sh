@@ -0,0 +1,35 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -split: blocks that end where the text changes round-trip and pay off
+#----------------------------------------------------------------------------
+
+# texts with different statistics back to back, so there are changes
+# to find
+
+awk 'BEGIN { for (i = 0; i < 20000; i++) printf "%d\t%d\t0.%d\n", i, i * 7 % 100, i % 13 }' > "$WORK/split_nums.txt"
+cat "$WORK/doi.txt" "$WORK/split_nums.txt" "$WORK/bts.txt" "$WORK/split_nums.txt" > "$WORK/split_mixed.txt"
+
+for level in 1 5 9; do
+  roundtrip split$level split_mixed.txt "-split $level"
+  succeeds "-test -split $level" "$HUF" -test -threads 3 "$WORK/split$level.huf"
+done
+for f in empty one line runs; do
+  roundtrip split_$f $f.txt "-split 5"
+done
+roundtrip split_small_blocks medium.txt "-split 5 -block 2000"
+roundtrip split_lz split_mixed.txt "-split 5 -lz 5"
+
+run "$HUF" -split 5 - < "$WORK/split_mixed.txt" > "$WORK/split_pipe.huf" 2> /dev/null
+run "$HUF" -d - < "$WORK/split_pipe.huf" > "$WORK/split_pipe.out" 2> /dev/null
+same "$WORK/split_mixed.txt" "$WORK/split_pipe.out" "-split pipe round trip"
+
+# a table per region has to beat fixed-size blocks on this text
+
+roundtrip split_fixed split_mixed.txt "-stream"
+if [ $(size "$WORK/split5.huf") -lt $(size "$WORK/split_fixed.huf") ]; then ok; else bad "-split 5 no smaller than -stream"; fi
+
+for offset in 20 4000 100000; do
+  cp "$WORK/split5.huf" "$WORK/split_bad.huf"
+  flip "$WORK/split_bad.huf" $offset
+  fails "-test -split file with byte $offset changed" "$HUF" -test "$WORK/split_bad.huf"
+done
@@ -0,0 +1,36 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -stream and pipes: block stream round trips, damaged and cut-short streams
+#----------------------------------------------------------------------------
+
+for f in small medium empty one line runs; do
+  roundtrip stream_$f $f.txt "-stream"
+done
+roundtrip stream_blocks medium.txt "-stream -block 4096"
+roundtrip stream_tiny_blocks small.txt "-stream -block 1"
+
+# stdin to stdout, whole and in blocks smaller than a pipe buffer
+
+run "$HUF" - < "$WORK/medium.txt" > "$WORK/pipe.huf" 2> /dev/null
+run "$HUF" -d - < "$WORK/pipe.huf" > "$WORK/pipe.out" 2> /dev/null
+same "$WORK/medium.txt" "$WORK/pipe.out" "pipe round trip"
+
+run "$HUF" -block 1000 - < "$WORK/medium.txt" > "$WORK/pipe_blocks.huf" 2> /dev/null
+cat "$WORK/pipe_blocks.huf" | run "$HUF" -d - > "$WORK/pipe.out" 2> /dev/null
+same "$WORK/medium.txt" "$WORK/pipe.out" "pipe round trip, small blocks"
+
+# a stream cut off anywhere, or with a byte changed, is an error, never
+# a short or wrong output passed off as good
+
+for n in 0 3 4 5 20 1000 $(($(size "$WORK/pipe_blocks.huf") - 1)); do
+  head -c $n "$WORK/pipe_blocks.huf" > "$WORK/stream_cut.huf"
+  run "$HUF" -d - < "$WORK/stream_cut.huf" > "$WORK/pipe.out" 2> "$WORK/out.log"
+  said "error" "stream cut to $n bytes"
+done
+
+for offset in 2 4 5 9 300 5000; do
+  cp "$WORK/pipe_blocks.huf" "$WORK/stream_bad.huf"
+  flip "$WORK/stream_bad.huf" $offset
+  run "$HUF" -d - < "$WORK/stream_bad.huf" > "$WORK/pipe.out" 2> "$WORK/out.log"
+  said "error" "stream with byte $offset changed"
+done
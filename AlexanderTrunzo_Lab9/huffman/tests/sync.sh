@@ -0,0 +1,48 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# old-style files decoded on many threads: same text as one thread
+#----------------------------------------------------------------------------
+
+# sync_threads <name>: decompresses name.huf on 1 and on several
+# threads, and the two have to agree byte for byte (whether the file is
+# good or not)
+
+sync_threads()
+{
+  for t in 1 2 7; do
+    cp "$WORK/$1.huf" "$WORK/$1_$t.huf"
+    rm -f "$WORK/$1_$t.HUF"
+    (cd "$WORK" && run "$HUF" -threads $t "$1_$t.huf" > /dev/null 2>&1)
+  done
+  same "$WORK/$1_1.HUF" "$WORK/$1_2.HUF" "$1 on 2 threads"
+  same "$WORK/$1_1.HUF" "$WORK/$1_7.HUF" "$1 on 7 threads"
+}
+
+roundtrip sync_medium medium.txt "" "-threads 4"
+roundtrip sync_small small.txt "" "-threads 16"
+roundtrip sync_one one.txt "" "-threads 4"
+roundtrip sync_empty empty.txt "" "-threads 4"
+roundtrip sync_runs runs.txt "" "-threads 4"
+sync_threads sync_medium
+
+# more than one chunk, and the chunks have to find their way back in
+# step with each other
+
+cp "$WORK/sync_medium.huf" "$WORK/sync_debug.huf"
+run "$HUF" -debug -threads 4 "$WORK/sync_debug.huf" > "$WORK/out.log" 2>&1
+said "^[2-9][0-9]* chunks" "-threads 4 splits the bits"
+
+succeeds "-bench sync" "$HUF" -bench sync -threads 4 "$WORK/medium.txt"
+
+# damaged files fall back to the one-thread decoder, so every thread
+# count gives the same output
+
+for offset in 0 300 60000; do
+  cp "$WORK/sync_medium.huf" "$WORK/sync_bad.huf"
+  flip "$WORK/sync_bad.huf" $offset
+  sync_threads sync_bad
+done
+
+cp "$WORK/sync_medium.huf" "$WORK/sync_bad.huf"
+truncate_to "$WORK/sync_bad.huf" 100000
+sync_threads sync_bad
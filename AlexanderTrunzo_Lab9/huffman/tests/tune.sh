@@ -0,0 +1,62 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -tune: profiles change speed, never output; bad profiles are ignored
+#----------------------------------------------------------------------------
+
+succeeds "-tune" "$HUF" -tune -profile "$WORK/tune.profile" "$WORK/medium.txt"
+said "saved to" "-tune"
+for name in kernels decode_table_bits block_size threads; do
+  if grep -q "^$name " "$WORK/tune.profile"; then ok; else bad "-tune wrote no $name"; fi
+done
+fails "-tune to a profile it can't write" "$HUF" -tune -profile "$WORK/no_such_dir/tune.profile" "$WORK/small.txt"
+
+# tune_roundtrips <profile>: files made and read with a profile in
+# effect are the same as without one (the block size can change a
+# block stream, so that's compared by decoding)
+
+tune_roundtrips()
+{
+  HUFFMAN_PROFILE=$1
+  roundtrip tune_legacy medium.txt ""
+  roundtrip tune_ascii small.txt "-ascii" "-ascii"
+  roundtrip tune_stream medium.txt "-stream"
+  roundtrip tune_lz medium.txt "-lz 5"
+  HUFFMAN_PROFILE=$WORK/no_such_profile
+  same "$WORK/tune_plain.huf" "$WORK/tune_legacy.huf" "old-style output with $(basename "$1")"
+  same "$WORK/tune_plain_ascii.huf" "$WORK/tune_ascii.huf" "-ascii output with $(basename "$1")"
+}
+
+roundtrip tune_plain medium.txt ""
+roundtrip tune_plain_ascii small.txt "-ascii" "-ascii"
+
+tune_roundtrips "$WORK/tune.profile"
+HUFFMAN_PROFILE=$WORK/tune.profile
+run "$HUF" -debug -test "$WORK/tune_plain.huf" > "$WORK/out.log" 2>&1
+HUFFMAN_PROFILE=$WORK/no_such_profile
+said "tuning: .* from .*tune.profile" "-debug shows the profile in effect"
+
+# -profile on the command line wins over $HUFFMAN_PROFILE
+
+run "$HUF" -debug -profile "$WORK/tune.profile" -test "$WORK/tune_plain.huf" > "$WORK/out.log" 2>&1
+said "tuning: .* from .*tune.profile" "-profile"
+
+# hand-edited profiles: extreme values, nonsense and garbage all still
+# give files that decode
+
+printf 'kernels bmi2\ndecode_table_bits 1\nblock_size 1000\nthreads 64\n' > "$WORK/tune_extreme.profile"
+printf 'kernels no_such_kernel\ndecode_table_bits 99\nblock_size -5\nthreads 0\nno_such_setting 3\n# kernels avx2\n' > "$WORK/tune_nonsense.profile"
+head -c 2000 /dev/urandom > "$WORK/tune_garbage.profile"
+cp "$WORK/tune.profile" "$WORK/tune_cut.profile"
+truncate_to "$WORK/tune_cut.profile" 40
+
+for p in tune_extreme tune_nonsense tune_garbage tune_cut; do
+  tune_roundtrips "$WORK/$p.profile"
+done
+
+# and a profile doesn't stop a damaged file being caught
+
+cp "$WORK/tune_stream.huf" "$WORK/tune_bad.huf"
+flip "$WORK/tune_bad.huf" 5000
+HUFFMAN_PROFILE=$WORK/tune_extreme.profile
+fails "-test with a profile, damaged file" "$HUF" -test "$WORK/tune_bad.huf"
+HUFFMAN_PROFILE=$WORK/no_such_profile
@@ -0,0 +1,71 @@
+#----------------------------------------------------------------------------
+# huffman coding for file compression with tries
+# -test: every format passes with the right char count, damage is caught
+#----------------------------------------------------------------------------
+
+chars=$(size "$WORK/small.txt")
+
+roundtrip test_legacy small.txt ""
+roundtrip test_ascii small.txt "-ascii" "-ascii"
+roundtrip test_stream small.txt "-stream -block 8192"
+roundtrip test_adaptive small.txt "-adaptive"
+
+succeeds "-test legacy" "$HUF" -test "$WORK/test_legacy.huf"
+said "OK (legacy, $chars chars" "-test legacy"
+succeeds "-test -ascii" "$HUF" -test -ascii "$WORK/test_ascii.huf"
+said "OK (ascii, $chars chars" "-test -ascii"
+succeeds "-test stream" "$HUF" -test -threads 4 "$WORK/test_stream.huf"
+said "blocks, $chars chars" "-test stream"
+succeeds "-test adaptive" "$HUF" -test "$WORK/test_adaptive.huf"
+said "OK (adaptive, $chars chars" "-test adaptive"
+
+roundtrip test_empty empty.txt ""
+succeeds "-test empty legacy" "$HUF" -test "$WORK/test_empty.huf"
+
+# damage in each format
+
+cp "$WORK/test_stream.huf" "$WORK/test_bad.huf"
+flip "$WORK/test_bad.huf" 3000
+fails "-test stream with a changed byte" "$HUF" -test "$WORK/test_bad.huf"
+said "FAILED (stream" "-test stream with a changed byte"
+
+cp "$WORK/test_stream.huf" "$WORK/test_bad.huf"
+truncate_to "$WORK/test_bad.huf" $(($(size "$WORK/test_bad.huf") - 1))
+fails "-test stream without its end marker" "$HUF" -test "$WORK/test_bad.huf"
+
+cp "$WORK/test_legacy.huf" "$WORK/test_bad.huf"
+flip "$WORK/test_bad.huf" 0
+fails "-test legacy with a bad table size" "$HUF" -test "$WORK/test_bad.huf"
+
+cp "$WORK/test_legacy.huf" "$WORK/test_bad.huf"
+truncate_to "$WORK/test_bad.huf" 40
+fails "-test legacy cut short" "$HUF" -test "$WORK/test_bad.huf"
+
+cp "$WORK/test_ascii.huf" "$WORK/test_bad.huf"
+printf '0' >> "$WORK/test_bad.huf"
+fails "-test -ascii with a dangling bit" "$HUF" -test -ascii "$WORK/test_bad.huf"
+
+cp "$WORK/test_adaptive.huf" "$WORK/test_bad.huf"
+truncate_to "$WORK/test_bad.huf" 2000
+fails "-test adaptive cut short" "$HUF" -test "$WORK/test_bad.huf"
+
+cp "$WORK/test_adaptive.huf" "$WORK/test_bad.huf"
+printf 'x' >> "$WORK/test_bad.huf"
+fails "-test adaptive with data after the end" "$HUF" -test "$WORK/test_bad.huf"
+said "data after end marker" "-test adaptive with data after the end"
+
+# one bad file among good ones fails the run, and all are reported
+
+fails "-test with one bad file" "$HUF" -test "$WORK/test_legacy.huf" "$WORK/test_bad.huf" "$WORK/test_stream.huf"
+said "test_stream.huf: OK" "-test goes on past a bad file"
+
+# a table that parses but codes that never match: the string decoder
+# fallback has to give up, not search forever
+
+for f in test_adaptive test_stream; do
+  cp "$WORK/$f.huf" "$WORK/test_bad.huf"
+  flip "$WORK/test_bad.huf" 0
+  fails "-test $f with its first byte changed" "$HUF" -test "$WORK/test_bad.huf"
+done
+head -c 100000 /dev/urandom > "$WORK/test_bad.huf"
+fails "-test on random bytes" "$HUF" -test "$WORK/test_bad.huf"